@@ -87,9 +87,13 @@ if (APPLE)
   option (OPTION_APPLE_SDL "use SDL" OFF)
 endif (APPLE)
 
+if (UNIX AND NOT APPLE)
+  option (OPTION_USE_HEADLESS "draw into memory instead of using X11" OFF)
+endif (UNIX AND NOT APPLE)
+
 # find X11 libraries and headers
 set (PATH_TO_XLIBS)
-if ((NOT APPLE OR OPTION_APPLE_X11) AND NOT WIN32)
+if ((NOT APPLE OR OPTION_APPLE_X11) AND NOT WIN32 AND NOT OPTION_USE_HEADLESS)
   include (FindX11)
   if (X11_FOUND)
     set (USE_X11 1)
@@ -99,7 +103,7 @@ if ((NOT APPLE OR OPTION_APPLE_X11) AND NOT WIN32)
     endif (X11_Xext_FOUND)
     get_filename_component (PATH_TO_XLIBS ${X11_X11_LIB} PATH)
   endif (X11_FOUND)
-endif ((NOT APPLE OR OPTION_APPLE_X11) AND NOT WIN32)
+endif ((NOT APPLE OR OPTION_APPLE_X11) AND NOT WIN32 AND NOT OPTION_USE_HEADLESS)
 
 if (OPTION_APPLE_X11)
   include_directories (AFTER SYSTEM /opt/X11/include/freetype2)
@@ -119,6 +123,10 @@ if (OPTION_APPLE_SDL)
   endif (SDL2_FOUND)
 endif (OPTION_APPLE_SDL)
 
+if (OPTION_USE_HEADLESS)
+  set (USE_HEADLESS 1)
+endif (OPTION_USE_HEADLESS)
+
 #######################################################################
 option(OPTION_USE_POLL "use poll if available" OFF)
 mark_as_advanced(OPTION_USE_POLL)
@@ -197,7 +205,7 @@ if(OPTION_USE_GL)
    if(OPTION_APPLE_X11)
       set(OPENGL_FOUND TRUE)
       set(OPENGL_LIBRARIES -L${PATH_TO_XLIBS} -lGLU -lGL)
-   elseif(OPTION_APPLE_SDL)
+   elseif(OPTION_APPLE_SDL OR OPTION_USE_HEADLESS)
       set(OPENGL_FOUND FALSE)
    else()
       include(FindOpenGL)
@@ -534,6 +542,18 @@ else()
    set(FLTK_XDBE_FOUND FALSE)
 endif(OPTION_USE_XDBE AND HAVE_XDBE_H)
 
+#######################################################################
+if(X11_FOUND)
+   option(OPTION_USE_XSHM "use the MIT-SHM extension for images" ON)
+endif(X11_FOUND)
+
+if(OPTION_USE_XSHM AND HAVE_XSHM_H AND HAVE_SYS_SHM_H AND X11_Xext_FOUND)
+   set(HAVE_XSHM 1)
+   set(FLTK_XSHM_FOUND TRUE)
+else()
+   set(FLTK_XSHM_FOUND FALSE)
+endif(OPTION_USE_XSHM AND HAVE_XSHM_H AND HAVE_SYS_SHM_H AND X11_Xext_FOUND)
+
 #######################################################################
 set(FL_NO_PRINT_SUPPORT FALSE)
 if(X11_FOUND AND NOT OPTION_PRINT_SUPPORT)
@@ -75,10 +75,13 @@ fl_find_header (HAVE_SYS_STDTYPES_H sys/stdtypes.h)
 if (USE_FIND_FILE)
   fl_find_header (HAVE_X11_XREGION_H "X11/Xregion.h")
   fl_find_header (HAVE_XDBE_H "X11/extensions/Xdbe.h")
+  fl_find_header (HAVE_XSHM_H "X11/extensions/XShm.h")
 else ()
   fl_find_header (HAVE_X11_XREGION_H "X11/Xlib.h;X11/Xregion.h")
   fl_find_header (HAVE_XDBE_H "X11/Xlib.h;X11/extensions/Xdbe.h")
+  fl_find_header (HAVE_XSHM_H "X11/Xlib.h;X11/extensions/XShm.h")
 endif()
+fl_find_header (HAVE_SYS_SHM_H sys/shm.h)
 
 if (WIN32 AND NOT CYGWIN)
   # we don't use pthreads on Windows (except for Cygwin, see options.cmake)
@@ -157,7 +160,7 @@ mark_as_advanced(HAVE_LIBPNG_PNG_H HAVE_LOCALE_H HAVE_NDIR_H)
 mark_as_advanced(HAVE_OPENGL_GLU_H HAVE_PNG_H HAVE_PTHREAD_H)
 mark_as_advanced(HAVE_STDIO_H HAVE_STRINGS_H HAVE_SYS_DIR_H)
 mark_as_advanced(HAVE_SYS_NDIR_H HAVE_SYS_SELECT_H)
-mark_as_advanced(HAVE_SYS_STDTYPES_H HAVE_XDBE_H)
+mark_as_advanced(HAVE_SYS_STDTYPES_H HAVE_XDBE_H HAVE_XSHM_H HAVE_SYS_SHM_H)
 mark_as_advanced(HAVE_X11_XREGION_H)
 
 #----------------------------------------------------------------------
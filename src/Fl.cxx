@@ -25,7 +25,12 @@
 #include "Fl_System_Driver.H"
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Tooltip.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Trace.H>
+#include <FL/Fl_Draw_Profiler.H>
+#include <FL/names.h>
 #include <FL/fl_draw.H>
+#include "Fl_Pointer_Set.H"
 
 #include <ctype.h>
 #include <stdlib.h>
@@ -436,7 +441,9 @@ void Fl::run_checks()
     while (next_check) {
       Check* checkp = next_check;
       next_check = checkp->next;
+      double t0 = Fl_Stats::start();
       (checkp->cb)(checkp->arg);
+      Fl_Stats::stop(FL_STATS_CHECK, t0);
     }
     next_check = first_check;
   }
@@ -520,10 +527,20 @@ void (*Fl::idle)(); // see Fl::add_idle.cxx for the add/remove functions
  It is zero if nothing happens.  It is negative if an error
  occurs (this will happen on X11 if a signal happens).
 */
+// Fl_Stats: time spent in Fl::wait() by the events being dispatched, that is,
+// in nested event loops such as the one of fl_choice(). It is subtracted
+// from the FL_STATS_EVENT sample of the event.
+static int handle_depth = 0;
+static double nested_wait_time = 0.0;
+
 double Fl::wait(double time_to_wait) {
   // delete all widgets that were listed during callbacks
   do_widget_deletion();
-  return screen_driver()->wait(time_to_wait);
+  if (!handle_depth) return screen_driver()->wait(time_to_wait);
+  double t0 = Fl_Stats::start();
+  double ret = screen_driver()->wait(time_to_wait);
+  if (t0 > 0.0) nested_wait_time += Fl_Stats::now() - t0;
+  return ret;
 }
 
 #define FOREVER 1e20
@@ -691,6 +708,7 @@ void Fl::redraw() {
   event queue.
 */
 void Fl::flush() {
+  double t0 = Fl_Stats::start();
   if (damage()) {
     damage_ = 0;
     for (Fl_X* i = Fl_X::first; i; i = i->next) {
@@ -698,8 +716,14 @@ void Fl::flush() {
       if (Fl_Window_Driver::driver(wi)->wait_for_expose_value) {damage_ = 1; continue;}
       if (!wi->visible_r()) continue;
       if (wi->damage()) {
+        double t1 = Fl_Stats::start();
+        Fl_Trace::begin(wi, "draw");
+        Fl_Draw_Profiler::begin(wi);
         Fl_Window_Driver::driver(wi)->flush();
         wi->clear_damage();
+        Fl_Draw_Profiler::end();
+        Fl_Trace::end();
+        Fl_Stats::stop(FL_STATS_DRAW, t1);
       }
       // destroy damage regions for windows that don't use them:
       if (i->region) {
@@ -709,6 +733,7 @@ void Fl::flush() {
     }
   }
   screen_driver()->flush();
+  Fl_Stats::stop(FL_STATS_FLUSH, t0);
 }
 
 
@@ -1114,7 +1139,9 @@ static int send_event(int event, Fl_Widget* to, Fl_Window* window) {
   }
   int save_x = Fl::e_x; Fl::e_x += dx;
   int save_y = Fl::e_y; Fl::e_y += dy;
+  Fl_Trace::begin(to, "handle");
   int ret = to->handle(Fl::e_number = event);
+  Fl_Trace::end();
   Fl::e_number = old_event;
   Fl::e_y = save_y;
   Fl::e_x = save_x;
@@ -1191,11 +1218,26 @@ Fl_Event_Dispatch Fl::event_dispatch()
  */
 int Fl::handle(int e, Fl_Window* window)
 {
+  double t0 = Fl_Stats::start();
+  double outer_wait_time = nested_wait_time;
+  nested_wait_time = 0.0;
+  handle_depth++;
+  if (Fl_Trace::enabled()) {
+    const int n = sizeof(fl_eventnames) / sizeof(fl_eventnames[0]);
+    Fl_Trace::begin(e >= 0 && e < n ? fl_eventnames[e] : "FL_EVENT", "event");
+  }
+  int ret;
   if (e_dispatch) {
-    return e_dispatch(e, window);
+    ret = e_dispatch(e, window);
   } else {
-    return handle_(e, window);
+    ret = handle_(e, window);
   }
+  Fl_Trace::end();
+  handle_depth--;
+  // nested event loops are not part of this event
+  if (t0 > 0.0) Fl_Stats::stop(FL_STATS_EVENT, t0 + nested_wait_time);
+  nested_wait_time = outer_wait_time;
+  return ret;
 }
 
 
@@ -1597,6 +1639,30 @@ void Fl_Widget::damage(uchar fl, int X, int Y, int W, int H) {
 
 static int        num_dwidgets = 0, alloc_dwidgets = 0;
 static Fl_Widget  **dwidgets = 0;
+static Fl_Pointer_Set dwidget_set; // the widgets of dwidgets, to detect duplicates
+
+static int compare_parents(const void *a, const void *b) {
+  const Fl_Group *pa = (*(Fl_Widget* const*)a)->parent();
+  const Fl_Group *pb = (*(Fl_Widget* const*)b)->parent();
+  return pa < pb ? -1 : pa > pb ? 1 : 0;
+}
+
+// Removes the scheduled widgets from their parents, with one
+// Fl_Group::remove_many() call per parent that loses several children.
+static void detach_scheduled_widgets(Fl_Widget* const* list, int n) {
+  Fl_Widget **sorted = new Fl_Widget *[n];
+  memcpy(sorted, list, n * sizeof(Fl_Widget *));
+  qsort(sorted, n, sizeof(Fl_Widget *), compare_parents);
+  for (int i = 0; i < n; ) {
+    Fl_Group *p = sorted[i]->parent();
+    int j = i + 1;
+    while (j < n && sorted[j]->parent() == p) j++;
+    if (p && j - i > 1) p->remove_many(sorted + i, j - i);
+    i = j;
+  }
+  delete[] sorted;
+}
+
 
 
 /**
@@ -1634,21 +1700,19 @@ void Fl::delete_widget(Fl_Widget *wi) {
   if (win && win->shown()) win->hide(); // case of iconified window
 
   // don't add the same widget twice to the widget delete list
-  for (int i = 0; i < num_dwidgets; i++) {
-    if (dwidgets[i]==wi) return;
-  }
+  if (!dwidget_set.insert(wi)) return;
 
   if (num_dwidgets >= alloc_dwidgets) {
     Fl_Widget **temp;
 
-    temp = new Fl_Widget *[alloc_dwidgets + 10];
+    temp = new Fl_Widget *[alloc_dwidgets ? 2 * alloc_dwidgets : 16];
     if (alloc_dwidgets) {
       memcpy(temp, dwidgets, alloc_dwidgets * sizeof(Fl_Widget *));
       delete[] dwidgets;
     }
 
     dwidgets = temp;
-    alloc_dwidgets += 10;
+    alloc_dwidgets = alloc_dwidgets ? 2 * alloc_dwidgets : 16;
   }
 
   dwidgets[num_dwidgets] = wi;
@@ -1665,22 +1729,120 @@ void Fl::delete_widget(Fl_Widget *wi) {
     you call Fl::wait(). The previously scheduled widgets are deleted in the
     same order they were scheduled by calling Fl::delete_widget().
 
+    Scheduled widgets that share the same parent group are removed from it
+    in a single pass before they are deleted, so that deleting many children
+    of a large group doesn't cost a search in the group for each child.
+
     \see Fl::delete_widget(Fl_Widget *wi)
 */
 void Fl::do_widget_deletion() {
   if (!num_dwidgets) return;
 
-  for (int i = 0; i < num_dwidgets; i ++)
-    delete dwidgets[i];
+  // Widgets scheduled by the destructors are appended to dwidgets and
+  // deleted by the same loop.
+  int done = 0;
+  while (done < num_dwidgets) {
+    int n = num_dwidgets;
+    if (n - done > 1) detach_scheduled_widgets(dwidgets + done, n - done);
+    for (int i = done; i < n; i ++)
+      delete dwidgets[i];
+    done = n;
+  }
 
   num_dwidgets = 0;
+  dwidget_set.clear();
 }
 
 
-static Fl_Widget ***widget_watch = 0;
-static int num_widget_watch = 0;
-static int max_widget_watch = 0;
+// The widget watch list is a hash table of the pointers watched by
+// Fl_Widget_Tracker objects, indexed by the widget they point to, so that
+// clear_widget_pointer() - called by every widget destructor - only looks
+// at the pointers to that widget. Each entry is stored under the value of
+// its pointer, which only clear_widget_pointer() changes: it removes the
+// entries of the pointers it clears, and NULL pointers are not stored, so
+// that the trackers of deleted widgets are released without a search.
+// Pointers watched with Fl::watch_widget_pointer() may be assigned another
+// widget by the application, so they are kept in a separate list that
+// clear_widget_pointer() searches entirely.
 
+struct Fl_Widget_Watch {
+  Fl_Widget **wp;               // the watched pointer
+  Fl_Widget_Watch *next;        // next entry in the same bucket or list
+};
+
+static Fl_Widget_Watch **widget_watch = 0;      // buckets
+static Fl_Widget_Watch *free_widget_watch = 0;  // unused entries
+static Fl_Widget_Watch *widget_watch_list = 0;  // pointers watched by Fl::watch_widget_pointer()
+static unsigned num_widget_watch = 0;           // entries in the buckets
+static unsigned max_widget_watch = 0;           // number of buckets, a power of 2
+
+static unsigned widget_watch_bucket(Fl_Widget const *w) {
+  fl_uintptr_t h = (fl_uintptr_t)w;
+  h ^= h >> 4; h *= 0x9E3779B1U; h ^= h >> 16;
+  return (unsigned)h & (max_widget_watch - 1);
+}
+
+static void grow_widget_watch() {
+  Fl_Widget_Watch **old = widget_watch;
+  unsigned old_max = max_widget_watch;
+  max_widget_watch = old_max ? 2 * old_max : 64;
+  widget_watch = (Fl_Widget_Watch**)calloc(max_widget_watch, sizeof(Fl_Widget_Watch*));
+  for (unsigned i = 0; i < old_max; i++) {
+    Fl_Widget_Watch *e = old[i];
+    while (e) {
+      Fl_Widget_Watch *next = e->next;
+      unsigned b = widget_watch_bucket(*e->wp);
+      e->next = widget_watch[b];
+      widget_watch[b] = e;
+      e = next;
+    }
+  }
+  free(old);
+}
+
+static Fl_Widget_Watch *new_widget_watch(Fl_Widget **wp) {
+  Fl_Widget_Watch *e = free_widget_watch;
+  if (e) free_widget_watch = e->next;
+  else e = (Fl_Widget_Watch*)malloc(sizeof(Fl_Widget_Watch));
+  e->wp = wp;
+  return e;
+}
+
+// Unlinks the entry *l and keeps it for later use.
+static void free_widget_watch_entry(Fl_Widget_Watch **l) {
+  Fl_Widget_Watch *e = *l;
+  *l = e->next;
+  e->next = free_widget_watch;
+  free_widget_watch = e;
+}
+
+// Finds the entry of wp in the list starting at *l.
+// Returns the link pointing to the entry, or NULL.
+static Fl_Widget_Watch **find_widget_watch(Fl_Widget_Watch **l, Fl_Widget **wp) {
+  for (; *l; l = &(*l)->next) if ((*l)->wp == wp) return l;
+  return 0;
+}
+
+// Adds the pointer of an Fl_Widget_Tracker to the hash table.
+static void watch_tracker_pointer(Fl_Widget **wp) {
+  if (!*wp) return;
+  if (num_widget_watch >= max_widget_watch) grow_widget_watch();
+  Fl_Widget_Watch *e = new_widget_watch(wp);
+  unsigned b = widget_watch_bucket(*wp);
+  e->next = widget_watch[b];
+  widget_watch[b] = e;
+  num_widget_watch++;
+}
+
+// Removes the pointer of an Fl_Widget_Tracker from the hash table, unless
+// clear_widget_pointer() already did.
+static void release_tracker_pointer(Fl_Widget **wp) {
+  if (!*wp || !num_widget_watch) return;
+  Fl_Widget_Watch **l = find_widget_watch(widget_watch + widget_watch_bucket(*wp), wp);
+  if (!l) return;
+  free_widget_watch_entry(l);
+  num_widget_watch--;
+}
 
 /**
   Adds a widget pointer to the widget watch list.
@@ -1718,6 +1880,12 @@ static int max_widget_watch = 0;
    This works, because all widgets call Fl::clear_widget_pointer() in their
    destructors.
 
+   \note The pointers watched by Fl_Widget_Tracker objects are indexed by
+   the widget they point to, so that deleting a widget only looks at the
+   pointers to it. Pointers added with this function may be assigned
+   another widget while they are watched, so each widget deletion checks
+   all of them: use Fl_Widget_Tracker when many pointers are watched.
+
    \see Fl::release_widget_pointer()
    \see Fl::clear_widget_pointer()
 
@@ -1730,18 +1898,13 @@ static int max_widget_watch = 0;
 void Fl::watch_widget_pointer(Fl_Widget *&w)
 {
   Fl_Widget **wp = &w;
-  int i;
-  for (i=0; i<num_widget_watch; ++i) {
-    if (widget_watch[i]==wp) return;
-  }
-  if (num_widget_watch==max_widget_watch) {
-    max_widget_watch += 8;
-    widget_watch = (Fl_Widget***)realloc(widget_watch, sizeof(Fl_Widget**)*max_widget_watch);
-  }
-  widget_watch[num_widget_watch++] = wp;
+  if (find_widget_watch(&widget_watch_list, wp)) return;
+  Fl_Widget_Watch *e = new_widget_watch(wp);
+  e->next = widget_watch_list;
+  widget_watch_list = e;
 #ifdef DEBUG_WATCH
-  printf ("\nwatch_widget_pointer:   (%d/%d) %8p => %8p\n",
-    num_widget_watch,num_widget_watch,wp,*wp);
+  printf ("\nwatch_widget_pointer:   (%u) %8p => %8p\n",
+    num_widget_watch,wp,*wp);
   fflush(stdout);
 #endif // DEBUG_WATCH
 }
@@ -1760,22 +1923,17 @@ void Fl::watch_widget_pointer(Fl_Widget *&w)
 void Fl::release_widget_pointer(Fl_Widget *&w)
 {
   Fl_Widget **wp = &w;
-  int i,j=0;
-  for (i=0; i<num_widget_watch; ++i) {
-    if (widget_watch[i]!=wp) {
-      if (j<i) widget_watch[j] = widget_watch[i]; // fill gap
-      j++;
-    }
+  Fl_Widget_Watch **l = find_widget_watch(&widget_watch_list, wp);
+  if (!l) {
+    release_tracker_pointer(wp);
+    return;
+  }
+  free_widget_watch_entry(l);
 #ifdef DEBUG_WATCH
-    else { // found widget pointer
-      printf("release_widget_pointer: (%d/%d) %8p => %8p\n",
-	     i+1, num_widget_watch, wp, *wp);
-    }
+  printf("release_widget_pointer: %8p => %8p\n", wp, *wp);
 #endif //DEBUG_WATCH
-  }
-  num_widget_watch = j;
 #ifdef DEBUG_WATCH
-  printf ("                        num_widget_watch = %d\n\n",num_widget_watch);
+  printf ("                        num_widget_watch = %u\n\n",num_widget_watch);
   fflush(stdout);
 #endif // DEBUG_WATCH
   return;
@@ -1801,10 +1959,17 @@ void Fl::release_widget_pointer(Fl_Widget *&w)
 void Fl::clear_widget_pointer(Fl_Widget const *w)
 {
   if (w==0L) return;
-  int i;
-  for (i=0; i<num_widget_watch; ++i) {
-    if (widget_watch[i] && *widget_watch[i]==w) {
-      *widget_watch[i] = 0L;
+  for (Fl_Widget_Watch *e = widget_watch_list; e; e = e->next)
+    if (*e->wp == w) *e->wp = 0L;
+  if (!num_widget_watch) return;
+  Fl_Widget_Watch **l = widget_watch + widget_watch_bucket(w);
+  while (*l) {
+    if (*(*l)->wp == w) {
+      *(*l)->wp = 0L;
+      free_widget_watch_entry(l);
+      num_widget_watch--;
+    } else {
+      l = &(*l)->next;
     }
   }
 }
@@ -1927,7 +2092,7 @@ void Fl::option(Fl_Option opt, bool val)
 Fl_Widget_Tracker::Fl_Widget_Tracker(Fl_Widget *wi)
 {
   wp_ = wi;
-  Fl::watch_widget_pointer(wp_); // add pointer to watch list
+  watch_tracker_pointer(&wp_); // add pointer to watch list
 }
 
 /**
@@ -1935,7 +2100,7 @@ Fl_Widget_Tracker::Fl_Widget_Tracker(Fl_Widget *wi)
 */
 Fl_Widget_Tracker::~Fl_Widget_Tracker()
 {
-  Fl::release_widget_pointer(wp_); // remove pointer from watch list
+  release_tracker_pointer(&wp_); // remove pointer from watch list
 }
 
 int Fl::use_high_res_GL_ = 0;
@@ -0,0 +1,441 @@
+//
+// "$Id$"
+//
+// Banded rectangle regions for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Banded_Region.H"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+// operations of combine()
+enum { UNITE, INTERSECT, SUBTRACT };
+
+
+void Fl_Banded_Region::init() {
+  bands_ = local_bands_;
+  xs_ = local_xs_;
+  n_bands_ = n_xs_ = 0;
+  bands_alloc_ = 1;
+  xs_alloc_ = 2;
+  left_ = right_ = 0;
+}
+
+
+/** Creates an empty region. */
+Fl_Banded_Region::Fl_Banded_Region() {
+  init();
+}
+
+
+/** Creates a rectangular region. */
+Fl_Banded_Region::Fl_Banded_Region(int x, int y, int w, int h) {
+  init();
+  set(x, y, w, h);
+}
+
+
+Fl_Banded_Region::Fl_Banded_Region(const Fl_Banded_Region &r) {
+  init();
+  *this = r;
+}
+
+
+Fl_Banded_Region &Fl_Banded_Region::operator=(const Fl_Banded_Region &r) {
+  if (this == &r) return *this;
+  n_bands_ = n_xs_ = 0;
+  for (int i = 0; i < r.n_bands_; i++)
+    add_band(r.band_top(i), r.band_bottom(i), r.band_edges(i), r.bands_[4 * i + 3]);
+  return *this;
+}
+
+
+Fl_Banded_Region::~Fl_Banded_Region() {
+  if (bands_ != local_bands_) free(bands_);
+  if (xs_ != local_xs_) free(xs_);
+}
+
+
+/** Removes all rectangles. */
+void Fl_Banded_Region::set_empty() {
+  if (bands_ != local_bands_) free(bands_);
+  if (xs_ != local_xs_) free(xs_);
+  init();
+}
+
+
+/** Makes the region a single rectangle, or empty if \p w or \p h is not positive. */
+void Fl_Banded_Region::set(int x, int y, int w, int h) {
+  n_bands_ = n_xs_ = 0;
+  if (w <= 0 || h <= 0) return;
+  int xs[2] = { x, x + w };
+  add_band(y, y + h, xs, 2);
+}
+
+
+// Appends a band below the others, or extends the last band if it has
+// the same rectangles and touches the new one.
+void Fl_Banded_Region::add_band(int top, int bottom, const int *xs, int n) {
+  if (n_bands_) {
+    int *last = bands_ + 4 * (n_bands_ - 1);
+    if (last[1] == top && last[3] == n && !memcmp(xs_ + last[2], xs, n * sizeof(int))) {
+      last[1] = bottom;
+      return;
+    }
+  }
+  if (n_bands_ >= bands_alloc_) {
+    bands_alloc_ *= 2;
+    if (bands_ == local_bands_) {
+      bands_ = (int*)malloc(bands_alloc_ * 4 * sizeof(int));
+      memcpy(bands_, local_bands_, sizeof(local_bands_));
+    } else {
+      bands_ = (int*)realloc(bands_, bands_alloc_ * 4 * sizeof(int));
+    }
+  }
+  if (n_xs_ + n > xs_alloc_) {
+    while (n_xs_ + n > xs_alloc_) xs_alloc_ *= 2;
+    if (xs_ == local_xs_) {
+      xs_ = (int*)malloc(xs_alloc_ * sizeof(int));
+      memcpy(xs_, local_xs_, n_xs_ * sizeof(int));
+    } else {
+      xs_ = (int*)realloc(xs_, xs_alloc_ * sizeof(int));
+    }
+  }
+  int *band = bands_ + 4 * n_bands_++;
+  band[0] = top;
+  band[1] = bottom;
+  band[2] = n_xs_;
+  band[3] = n;
+  memcpy(xs_ + n_xs_, xs, n * sizeof(int));
+  n_xs_ += n;
+  if (n_bands_ == 1 || xs[0] < left_) left_ = xs[0];
+  if (n_bands_ == 1 || xs[n - 1] > right_) right_ = xs[n - 1];
+}
+
+
+// Moves the rectangles of r to this region, and leaves r empty.
+void Fl_Banded_Region::take(Fl_Banded_Region &r) {
+  set_empty();
+  if (r.bands_ == r.local_bands_) {
+    memcpy(local_bands_, r.local_bands_, sizeof(local_bands_));
+  } else {
+    bands_ = r.bands_;
+    bands_alloc_ = r.bands_alloc_;
+  }
+  if (r.xs_ == r.local_xs_) {
+    memcpy(local_xs_, r.local_xs_, sizeof(local_xs_));
+  } else {
+    xs_ = r.xs_;
+    xs_alloc_ = r.xs_alloc_;
+  }
+  n_bands_ = r.n_bands_;
+  n_xs_ = r.n_xs_;
+  left_ = r.left_;
+  right_ = r.right_;
+  r.init();
+}
+
+
+// Merges the sorted edges a and b of two lines into out, with an operation
+// of combine(). Edges toggle the inside of their line, so the result is the
+// list of positions where the inside of the operation toggles.
+static int merge_edges(const int *a, int na, const int *b, int nb, int op, int *out) {
+  int i = 0, j = 0, n = 0, in_a = 0, in_b = 0, in = 0;
+  while (i < na || j < nb) {
+    int x = (j >= nb || (i < na && a[i] <= b[j])) ? a[i] : b[j];
+    while (i < na && a[i] == x) { in_a = !in_a; i++; }
+    while (j < nb && b[j] == x) { in_b = !in_b; j++; }
+    int now = op == UNITE ? (in_a || in_b) : op == INTERSECT ? (in_a && in_b) : (in_a && !in_b);
+    if (now != in) {
+      out[n++] = x;
+      in = now;
+    }
+  }
+  return n;
+}
+
+
+// Builds this empty region from a and b, which must not be this region.
+// The bands of both regions are cut at the tops and bottoms of all bands,
+// and each piece gets the merge of both lines.
+void Fl_Banded_Region::combine(const Fl_Banded_Region &a, const Fl_Banded_Region &b, int op) {
+  int size_a = 0, size_b = 0;
+  int ia, ib;
+  for (ia = 0; ia < a.n_bands_; ia++) if (a.bands_[4 * ia + 3] > size_a) size_a = a.bands_[4 * ia + 3];
+  for (ib = 0; ib < b.n_bands_; ib++) if (b.bands_[4 * ib + 3] > size_b) size_b = b.bands_[4 * ib + 3];
+  int local[64];
+  int *edges = (size_a + size_b <= 64) ? local : (int*)malloc((size_a + size_b) * sizeof(int));
+  ia = ib = 0;
+  int y = INT_MAX;
+  if (a.n_bands_) y = a.band_top(0);
+  if (b.n_bands_ && b.band_top(0) < y) y = b.band_top(0);
+  for (;;) {
+    int more_a = ia < a.n_bands_, more_b = ib < b.n_bands_;
+    if (!more_a && (op != UNITE || !more_b)) break;
+    if (!more_b && op == INTERSECT) break;
+    // the lines of a and b at y, and the first y where one of them changes
+    int next = INT_MAX, na = 0, nb = 0;
+    const int *ea = 0, *eb = 0;
+    if (more_a) {
+      if (a.band_top(ia) <= y) {
+        ea = a.band_edges(ia);
+        na = a.bands_[4 * ia + 3];
+        next = a.band_bottom(ia);
+      } else {
+        next = a.band_top(ia);
+      }
+    }
+    if (more_b) {
+      if (b.band_top(ib) <= y) {
+        eb = b.band_edges(ib);
+        nb = b.bands_[4 * ib + 3];
+        if (b.band_bottom(ib) < next) next = b.band_bottom(ib);
+      } else if (b.band_top(ib) < next) {
+        next = b.band_top(ib);
+      }
+    }
+    if (na || nb) {
+      int n = merge_edges(ea, na, eb, nb, op, edges);
+      if (n) add_band(y, next, edges, n);
+    }
+    y = next;
+    if (more_a && a.band_bottom(ia) <= y) ia++;
+    if (more_b && b.band_bottom(ib) <= y) ib++;
+  }
+  if (edges != local) free(edges);
+}
+
+
+/**
+ Returns the index of the first band whose bottom is below \p y, or
+ bands() if there is none. That band contains line \p y if its top is
+ not below \p y.
+ */
+int Fl_Banded_Region::find_band(int y) const {
+  int lo = 0, hi = n_bands_;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (bands_[4 * mid + 1] <= y) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+
+/**
+ Gets the rectangles of the region on line \p y, as left and right edges
+ in \p edges, the right ones excluded.
+ \return the number of rectangles, 0 if the line is outside of the region
+ */
+int Fl_Banded_Region::spans(int y, const int *&edges) const {
+  int i = find_band(y);
+  if (i >= n_bands_ || band_top(i) > y) return 0;
+  edges = band_edges(i);
+  return band_size(i);
+}
+
+
+/** Gets the bounding box of the region, 0, 0, 0, 0 if it is empty. */
+void Fl_Banded_Region::extents(int &x, int &y, int &w, int &h) const {
+  if (!n_bands_) {
+    x = y = w = h = 0;
+    return;
+  }
+  x = left_;
+  y = bands_[0];
+  w = right_ - left_;
+  h = bands_[4 * n_bands_ - 3] - y;
+}
+
+
+// Returns the index of the first edge of the rectangle of edges that ends
+// after x, or n if there is none.
+static int first_span(const int *edges, int n, int x) {
+  int lo = 0, hi = n / 2;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (edges[2 * mid + 1] <= x) lo = mid + 1;
+    else hi = mid;
+  }
+  return 2 * lo;
+}
+
+
+/** Returns non-zero if pixel \p x, \p y is in the region. */
+int Fl_Banded_Region::contains(int x, int y) const {
+  const int *edges;
+  int n = 2 * spans(y, edges);
+  int i = first_span(edges, n, x);
+  return i < n && edges[i] <= x;
+}
+
+
+/**
+ Tells how much of a rectangle is in the region.
+ \return 0 if no pixel of the rectangle is in the region, 1 if all of
+ them are, and 2 otherwise, like XRectInRegion()
+ */
+int Fl_Banded_Region::rect_in(int x, int y, int w, int h) const {
+  if (w <= 0 || h <= 0 || !n_bands_) return 0;
+  if (x >= right_ || x + w <= left_) return 0;
+  int all = 1, any = 0, covered = y;
+  for (int i = find_band(y); i < n_bands_ && band_top(i) < y + h; i++) {
+    if (band_top(i) > covered) all = 0;
+    covered = band_bottom(i);
+    const int *edges = band_edges(i);
+    int n = bands_[4 * i + 3];
+    int k = first_span(edges, n, x);
+    if (k < n && edges[k] < x + w) {
+      any = 1;
+      if (edges[k] > x || edges[k + 1] < x + w) all = 0;
+    } else {
+      all = 0;
+    }
+    if (any && !all) return 2;
+  }
+  if (!any) return 0;
+  return (all && covered >= y + h) ? 1 : 2;
+}
+
+
+/** Moves the region. */
+void Fl_Banded_Region::translate(int dx, int dy) {
+  for (int i = 0; i < n_bands_; i++) {
+    bands_[4 * i] += dy;
+    bands_[4 * i + 1] += dy;
+  }
+  for (int i = 0; i < n_xs_; i++) xs_[i] += dx;
+  left_ += dx;
+  right_ += dx;
+}
+
+
+/** Adds the pixels of \p r to the region. */
+void Fl_Banded_Region::unite(const Fl_Banded_Region &r) {
+  if (!r.n_bands_ || this == &r) return;
+  if (!n_bands_) {
+    *this = r;
+    return;
+  }
+  Fl_Banded_Region out;
+  out.combine(*this, r, UNITE);
+  take(out);
+}
+
+
+/** Adds a rectangle to the region. */
+void Fl_Banded_Region::unite(int x, int y, int w, int h) {
+  if (w <= 0 || h <= 0) return;
+  if (is_rect() && x >= left_ && y >= bands_[0] && x + w <= right_ && y + h <= bands_[1])
+    return; // already inside
+  unite(Fl_Banded_Region(x, y, w, h));
+}
+
+
+/** Keeps the pixels of the region that are in \p r. */
+void Fl_Banded_Region::intersect(const Fl_Banded_Region &r) {
+  if (this == &r) return;
+  if (r.is_rect()) {
+    intersect(r.left_, r.bands_[0], r.right_ - r.left_, r.bands_[1] - r.bands_[0]);
+    return;
+  }
+  Fl_Banded_Region out;
+  out.combine(*this, r, INTERSECT);
+  take(out);
+}
+
+
+/** Keeps the pixels of the region that are in a rectangle. */
+void Fl_Banded_Region::intersect(int x, int y, int w, int h) {
+  if (w <= 0 || h <= 0) {
+    set_empty();
+    return;
+  }
+  if (is_rect()) { // the common case of clipping, without allocations
+    int l = x > left_ ? x : left_, t = y > bands_[0] ? y : bands_[0];
+    int r = x + w < right_ ? x + w : right_, b = y + h < bands_[1] ? y + h : bands_[1];
+    set(l, t, r - l, b - t);
+    return;
+  }
+  Fl_Banded_Region rect(x, y, w, h), out;
+  out.combine(*this, rect, INTERSECT);
+  take(out);
+}
+
+
+/** Removes the pixels of \p r from the region. */
+void Fl_Banded_Region::subtract(const Fl_Banded_Region &r) {
+  if (this == &r) {
+    set_empty();
+    return;
+  }
+  if (!n_bands_ || !r.n_bands_) return;
+  Fl_Banded_Region out;
+  out.combine(*this, r, SUBTRACT);
+  take(out);
+}
+
+
+/** Removes a rectangle from the region. */
+void Fl_Banded_Region::subtract(int x, int y, int w, int h) {
+  if (w <= 0 || h <= 0) return;
+  subtract(Fl_Banded_Region(x, y, w, h));
+}
+
+
+/**
+ Prepares to walk the rectangles of \p region that overlap the box
+ \p x, \p y, \p w, \p h.
+ */
+Fl_Banded_Region::Iterator::Iterator(const Fl_Banded_Region &region, int x, int y, int w, int h) {
+  region_ = &region;
+  x_ = x;
+  y_ = y;
+  r_ = x + w;
+  b_ = y + h;
+  band_ = (w > 0 && h > 0) ? region.find_band(y) : region.bands();
+  edge_ = -1;
+}
+
+
+/**
+ Gets the next rectangle of the region that overlaps the box, clipped to it.
+ \return 0 when there is no more rectangle
+ */
+int Fl_Banded_Region::Iterator::next(int &X, int &Y, int &W, int &H) {
+  const Fl_Banded_Region &r = *region_;
+  while (band_ < r.bands() && r.band_top(band_) < b_) {
+    const int *edges = r.band_edges(band_);
+    int n = 2 * r.band_size(band_);
+    if (edge_ < 0) edge_ = first_span(edges, n, x_);
+    if (edge_ < n && edges[edge_] < r_) {
+      X = edges[edge_] > x_ ? edges[edge_] : x_;
+      W = (edges[edge_ + 1] < r_ ? edges[edge_ + 1] : r_) - X;
+      Y = r.band_top(band_) > y_ ? r.band_top(band_) : y_;
+      H = (r.band_bottom(band_) < b_ ? r.band_bottom(band_) : b_) - Y;
+      edge_ += 2;
+      return 1;
+    }
+    band_++;
+    edge_ = -1;
+  }
+  return 0;
+}
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,265 @@
+//
+// "$Id$"
+//
+// Coverage rasterizer of polygons for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <config.h>
+#include "Fl_Coverage_Rasterizer.H"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) && !WORDS_BIGENDIAN
+#  define BLEND_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+// antialiased lines are cut into this many slices
+#define SUBSAMPLES 4
+
+
+Fl_Coverage_Rasterizer::Fl_Coverage_Rasterizer() {
+  edges_ = 0;
+  n_edges_ = edges_alloc_ = 0;
+  active_ = 0;
+  xs_ = 0;
+  dirs_ = 0;
+  cover_ = 0;
+  alpha_ = 0;
+  scratch_edges_ = scratch_w_ = 0;
+}
+
+
+Fl_Coverage_Rasterizer::~Fl_Coverage_Rasterizer() {
+  free(edges_);
+  free(active_);
+  free(xs_);
+  free(dirs_);
+  free(cover_);
+  free(alpha_);
+}
+
+
+/** Adds an edge to the path. Horizontal edges don't matter and are ignored. */
+void Fl_Coverage_Rasterizer::add_edge(double x0, double y0, double x1, double y1) {
+  if (y0 == y1) return;
+  if (n_edges_ >= edges_alloc_) {
+    edges_alloc_ = edges_alloc_ ? 2 * edges_alloc_ : 32;
+    edges_ = (Edge*)realloc(edges_, edges_alloc_ * sizeof(Edge));
+  }
+  Edge &e = edges_[n_edges_++];
+  if (y0 < y1) {
+    e.x0 = x0; e.y0 = y0; e.x1 = x1; e.y1 = y1; e.dir = 1;
+  } else {
+    e.x0 = x1; e.y0 = y1; e.x1 = x0; e.y1 = y0; e.dir = -1;
+  }
+}
+
+
+/**
+ Gets the box of the pixels that the path may touch.
+ \return 0 if the path has no edge
+ */
+int Fl_Coverage_Rasterizer::bounds(int &x, int &y, int &w, int &h) const {
+  if (!n_edges_) return 0;
+  double xmin = edges_[0].x0, xmax = xmin, ymin = edges_[0].y0, ymax = edges_[0].y1;
+  for (int i = 0; i < n_edges_; i++) {
+    const Edge &e = edges_[i];
+    if (e.x0 < xmin) xmin = e.x0;
+    if (e.x1 < xmin) xmin = e.x1;
+    if (e.x0 > xmax) xmax = e.x0;
+    if (e.x1 > xmax) xmax = e.x1;
+    if (e.y0 < ymin) ymin = e.y0;
+    if (e.y1 > ymax) ymax = e.y1;
+  }
+  x = (int)floor(xmin);
+  y = (int)floor(ymin);
+  w = (int)ceil(xmax) - x + 1;
+  h = (int)ceil(ymax) - y + 1;
+  return 1;
+}
+
+
+// Sorts the edges by their top, for qsort().
+int Fl_Coverage_Rasterizer::compare_edges(const void *a, const void *b) {
+  double ya = ((const Edge*)a)->y0, yb = ((const Edge*)b)->y0;
+  return ya < yb ? -1 : ya > yb;
+}
+
+
+// Updates the active edges for the horizontal line at yc, and gets where
+// they cross it, sorted, with their directions.
+void Fl_Coverage_Rasterizer::crossings(double yc, int &n_active, int &nx) {
+  nx = 0;
+  for (int i = 0; i < n_active; ) {
+    const Edge &e = edges_[active_[i]];
+    if (e.y1 <= yc) {
+      active_[i] = active_[--n_active];
+      continue;
+    }
+    double x = e.x0 + (yc - e.y0) * (e.x1 - e.x0) / (e.y1 - e.y0);
+    int j = nx++;
+    for (; j > 0 && xs_[j - 1] > x; j--) {
+      xs_[j] = xs_[j - 1];
+      dirs_[j] = dirs_[j - 1];
+    }
+    xs_[j] = x;
+    dirs_[j] = e.dir;
+    i++;
+  }
+}
+
+
+// Adds the part of [xa, xb) that is inside pixels x to x+w-1 to their coverage.
+static void add_coverage(float *cover, int x, int w, double xa, double xb, float weight) {
+  if (xa < x) xa = x;
+  if (xb > x + w) xb = x + w;
+  if (xa >= xb) return;
+  int ia = (int)floor(xa), ib = (int)floor(xb);
+  if (ia == ib) {
+    cover[ia - x] += float(xb - xa) * weight;
+    return;
+  }
+  cover[ia - x] += float(ia + 1 - xa) * weight;
+  for (int i = ia + 1; i < ib; i++) cover[i - x] += weight;
+  if (ib < x + w) cover[ib - x] += float(xb - ib) * weight;
+}
+
+
+/**
+ Sends the spans of the path that are inside the box \p x, \p y, \p w, \p h
+ to \p cb, line after line from the top, and forgets the edges.
+ */
+void Fl_Coverage_Rasterizer::rasterize(int x, int y, int w, int h, int antialias,
+                                       Fill_Rule rule, Span_Cb cb, void *data) {
+  int n = n_edges_;
+  n_edges_ = 0;
+  if (n < 2 || w <= 0 || h <= 0) return;
+  if (n > scratch_edges_) {
+    scratch_edges_ = n;
+    active_ = (int*)realloc(active_, n * sizeof(int));
+    xs_ = (double*)realloc(xs_, n * sizeof(double));
+    dirs_ = (int*)realloc(dirs_, n * sizeof(int));
+  }
+  if (antialias && w > scratch_w_) {
+    scratch_w_ = w;
+    cover_ = (float*)realloc(cover_, w * sizeof(float));
+    alpha_ = (uchar*)realloc(alpha_, w);
+  }
+  qsort(edges_, n, sizeof(Edge), compare_edges);
+  int sub = antialias ? SUBSAMPLES : 1;
+  int n_active = 0, next = 0;
+  for (int line = y; line < y + h; line++) {
+    if (antialias) memset(cover_, 0, w * sizeof(float));
+    for (int s = 0; s < sub; s++) {
+      double yc = line + (s + 0.5) / sub;
+      while (next < n && edges_[next].y0 <= yc) active_[n_active++] = next++;
+      int nx;
+      crossings(yc, n_active, nx);
+      // the parts of the line where the winding number is inside
+      int wind = 0;
+      double start = 0;
+      for (int i = 0; i < nx; i++) {
+        int was_in = rule == EVEN_ODD ? (wind & 1) : wind != 0;
+        wind += rule == EVEN_ODD ? 1 : dirs_[i];
+        int is_in = rule == EVEN_ODD ? (wind & 1) : wind != 0;
+        if (is_in == was_in) continue;
+        if (is_in) {
+          start = xs_[i];
+          continue;
+        }
+        if (antialias) {
+          add_coverage(cover_, x, w, start, xs_[i], 1.0f / sub);
+          continue;
+        }
+        // the pixels whose center is inside
+        int a = (int)ceil(start - 0.5), b = (int)ceil(xs_[i] - 0.5);
+        if (a < x) a = x;
+        if (b > x + w) b = x + w;
+        if (a < b) cb(data, a, line, b - a, 0);
+      }
+    }
+    if (!antialias) continue;
+    for (int i = 0; i < w; i++) {
+      float c = cover_[i] * 255 + 0.5f;
+      alpha_[i] = c >= 255 ? 255 : uchar(c);
+    }
+    for (int i = 0; i < w; ) {
+      int j = i + 1;
+      if (alpha_[i] == 255) {
+        while (j < w && alpha_[j] == 255) j++;
+        cb(data, x + i, line, j - i, 0);
+      } else if (alpha_[i]) {
+        while (j < w && alpha_[j] && alpha_[j] != 255) j++;
+        cb(data, x + i, line, j - i, alpha_ + i);
+      }
+      i = j;
+    }
+  }
+}
+
+
+// x / 255, rounded, for x up to 255 * 255
+static inline unsigned div255(unsigned x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+
+/**
+ Blends \p color, given as red, green and blue, with \p n pixels of an RGBA
+ buffer, with the opacity of \p alpha. The alpha of the pixels is kept.
+ */
+void Fl_Coverage_Rasterizer::blend(uchar *rgba, int n, const uchar *alpha, const uchar *color) {
+  int i = 0;
+#if BLEND_SSE2
+  // 4 pixels at a time, as 16 bit channels
+  __m128i zero = _mm_setzero_si128();
+  __m128i c255 = _mm_set1_epi16(255), c128 = _mm_set1_epi16(128);
+  __m128i c = _mm_set_epi16(0, color[2], color[1], color[0], 0, color[2], color[1], color[0]);
+  __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+  for (; i + 4 <= n; i += 4) {
+    __m128i d = _mm_loadu_si128((const __m128i*)(rgba + 4 * i));
+    int a4;
+    memcpy(&a4, alpha + i, 4);
+    __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(a4), zero);
+    a = _mm_unpacklo_epi16(a, a);
+    __m128i a_lo = _mm_unpacklo_epi32(a, a), a_hi = _mm_unpackhi_epi32(a, a);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(c, a_lo),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(c255, a_lo)));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(c, a_hi),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(c255, a_hi)));
+    lo = _mm_add_epi16(lo, c128);
+    hi = _mm_add_epi16(hi, c128);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    __m128i r = _mm_packus_epi16(lo, hi);
+    r = _mm_or_si128(_mm_and_si128(d, alpha_mask), _mm_andnot_si128(alpha_mask, r));
+    _mm_storeu_si128((__m128i*)(rgba + 4 * i), r);
+  }
+#endif
+  for (uchar *p = rgba + 4 * i; i < n; i++, p += 4) {
+    unsigned a = alpha[i];
+    p[0] = uchar(div255(color[0] * a + p[0] * (255 - a)));
+    p[1] = uchar(div255(color[1] * a + p[1] * (255 - a)));
+    p[2] = uchar(div255(color[2] * a + p[2] * (255 - a)));
+  }
+}
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,712 @@
+//
+// "$Id$"
+//
+// Display lists of graphics calls for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Display_List.H"
+#include "Fl_Banded_Region.H"
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Bitmap.H>
+#include <FL/Fl_Pixmap.H>
+#include <stdlib.h>
+#include <string.h>
+
+// the recorded calls
+enum {
+  OP_COLOR, OP_RGB_COLOR, OP_FONT, OP_LINE_STYLE,
+  OP_POINT, OP_RECT, OP_FOCUS_RECT, OP_RECTF, OP_LINE, OP_LINE2,
+  OP_XYLINE, OP_XYLINE2, OP_XYLINE3, OP_YXLINE, OP_YXLINE2, OP_YXLINE3,
+  OP_LOOP, OP_LOOP4, OP_POLYGON, OP_POLYGON4,
+  OP_PUSH_CLIP, OP_PUSH_NO_CLIP, OP_POP_CLIP, OP_CLIP_REGION, OP_RESTORE_CLIP,
+  OP_BEGIN_POINTS, OP_BEGIN_LINE, OP_BEGIN_LOOP, OP_BEGIN_POLYGON, OP_BEGIN_COMPLEX_POLYGON,
+  OP_VERTEX, OP_END_POINTS, OP_END_LINE, OP_END_LOOP, OP_END_POLYGON, OP_END_COMPLEX_POLYGON, OP_GAP,
+  OP_CIRCLE, OP_ARC, OP_PIE,
+  OP_TEXT, OP_TEXT_ANGLE, OP_TEXT_RTL,
+  OP_IMAGE, OP_IMAGE_MONO, OP_RGB_IMAGE, OP_BITMAP,
+  OP_ORIGIN, OP_ORIGIN_POP
+};
+
+// A call starts with this header, followed by its integers, its doubles and
+// its bytes, each part padded to 8 bytes.
+struct Op {
+  uchar op, n_ints, n_doubles, pad;
+  unsigned n_bytes;
+};
+
+static inline size_t pad8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// the deepest translations that replay() follows
+#define ORIGIN_STACK_SIZE 20
+
+
+Fl_Display_List::Fl_Display_List() {
+  data_ = 0;
+  size_ = alloc_ = 0;
+  n_ops_ = 0;
+  images_ = 0;
+  n_images_ = images_alloc_ = 0;
+}
+
+
+Fl_Display_List::~Fl_Display_List() {
+  clear();
+  free(data_);
+  free(images_);
+}
+
+
+/** Forgets all calls, and deletes the copies of their images. */
+void Fl_Display_List::clear() {
+  for (int i = 0; i < n_images_; i++) delete images_[i];
+  n_images_ = 0;
+  size_ = 0;
+  n_ops_ = 0;
+}
+
+
+/** Returns the number of bytes of the images of the recorded calls. */
+size_t Fl_Display_List::image_bytes() const {
+  size_t bytes = 0;
+  for (int i = 0; i < n_images_; i++) {
+    Fl_Image *img = images_[i];
+    if (img->d()) bytes += (size_t)img->data_w() * img->data_h() * img->d();
+    else bytes += (size_t)((img->data_w() + 7) / 8) * img->data_h();
+  }
+  return bytes;
+}
+
+
+// Adds a call whose integers and doubles are set by the caller, and returns
+// the start of its integers.
+uchar *Fl_Display_List::add(int op, int n_ints, int n_doubles, size_t n_bytes) {
+  size_t size = sizeof(Op) + pad8(n_ints * sizeof(int)) + n_doubles * sizeof(double) +
+                pad8(n_bytes);
+  if (size_ + size > alloc_) {
+    alloc_ = alloc_ ? 2 * alloc_ : 4096;
+    while (alloc_ < size_ + size) alloc_ *= 2;
+    data_ = (uchar*)realloc(data_, alloc_);
+  }
+  Op *o = (Op*)(data_ + size_);
+  o->op = (uchar)op;
+  o->n_ints = (uchar)n_ints;
+  o->n_doubles = (uchar)n_doubles;
+  o->pad = 0;
+  o->n_bytes = (unsigned)n_bytes;
+  size_ += size;
+  n_ops_++;
+  return (uchar*)(o + 1);
+}
+
+
+void Fl_Display_List::add(int op, const int *ints, int n_ints) {
+  memcpy(add(op, n_ints, 0, 0), ints, n_ints * sizeof(int));
+}
+
+
+// Keeps img, and returns its index.
+int Fl_Display_List::add_image(Fl_Image *img) {
+  if (n_images_ >= images_alloc_) {
+    images_alloc_ = images_alloc_ ? 2 * images_alloc_ : 16;
+    images_ = (Fl_Image**)realloc(images_, images_alloc_ * sizeof(Fl_Image*));
+  }
+  images_[n_images_] = img;
+  return n_images_++;
+}
+
+
+/**
+ Sends the recorded calls to \p d, moved by \p dx, \p dy. The vertices of
+ paths and circles go through the current matrix of \p d, translated by
+ \p dx, \p dy.
+ */
+void Fl_Display_List::replay(Fl_Graphics_Driver *d, int dx, int dy) const {
+  int stack_x[ORIGIN_STACK_SIZE], stack_y[ORIGIN_STACK_SIZE];
+  int depth = 0, in_path = 0;
+  int tx = dx, ty = dy;
+  const uchar *p = data_, *end = data_ + size_;
+  while (p < end) {
+    const Op *o = (const Op*)p;
+    const int *v = (const int*)(o + 1);
+    const double *f = (const double*)((const uchar*)v + pad8(o->n_ints * sizeof(int)));
+    const uchar *bytes = (const uchar*)(f + o->n_doubles);
+    p = bytes + pad8(o->n_bytes);
+    switch (o->op) {
+      case OP_COLOR: d->color((Fl_Color)v[0]); break;
+      case OP_RGB_COLOR: d->color((uchar)v[0], (uchar)v[1], (uchar)v[2]); break;
+      case OP_FONT: d->font((Fl_Font)v[0], (Fl_Fontsize)v[1]); break;
+      case OP_LINE_STYLE: d->line_style(v[0], v[1], v[2] ? (char*)bytes : 0); break;
+      case OP_POINT: d->point(v[0] + tx, v[1] + ty); break;
+      case OP_RECT: d->rect(v[0] + tx, v[1] + ty, v[2], v[3]); break;
+      case OP_FOCUS_RECT: d->focus_rect(v[0] + tx, v[1] + ty, v[2], v[3]); break;
+      case OP_RECTF: d->rectf(v[0] + tx, v[1] + ty, v[2], v[3]); break;
+      case OP_LINE: d->line(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty); break;
+      case OP_LINE2:
+        d->line(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty, v[4] + tx, v[5] + ty);
+        break;
+      case OP_XYLINE: d->xyline(v[0] + tx, v[1] + ty, v[2] + tx); break;
+      case OP_XYLINE2: d->xyline(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty); break;
+      case OP_XYLINE3: d->xyline(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty, v[4] + tx); break;
+      case OP_YXLINE: d->yxline(v[0] + tx, v[1] + ty, v[2] + ty); break;
+      case OP_YXLINE2: d->yxline(v[0] + tx, v[1] + ty, v[2] + ty, v[3] + tx); break;
+      case OP_YXLINE3: d->yxline(v[0] + tx, v[1] + ty, v[2] + ty, v[3] + tx, v[4] + ty); break;
+      case OP_LOOP:
+        d->loop(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty, v[4] + tx, v[5] + ty);
+        break;
+      case OP_LOOP4:
+        d->loop(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty,
+                v[4] + tx, v[5] + ty, v[6] + tx, v[7] + ty);
+        break;
+      case OP_POLYGON:
+        d->polygon(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty, v[4] + tx, v[5] + ty);
+        break;
+      case OP_POLYGON4:
+        d->polygon(v[0] + tx, v[1] + ty, v[2] + tx, v[3] + ty,
+                   v[4] + tx, v[5] + ty, v[6] + tx, v[7] + ty);
+        break;
+      case OP_PUSH_CLIP: d->push_clip(v[0] + tx, v[1] + ty, v[2], v[3]); break;
+      case OP_PUSH_NO_CLIP: d->push_no_clip(); break;
+      case OP_POP_CLIP: d->pop_clip(); break;
+      case OP_CLIP_REGION: {
+        if (!v[0]) {
+          d->clip_region(0);
+          break;
+        }
+        // the rectangles of the region are the bytes of the call
+        const int *r = (const int*)bytes;
+        int n = int(o->n_bytes / (4 * sizeof(int)));
+        Fl_Region region = d->XRectangleRegion(n ? r[0] + tx : 0, n ? r[1] + ty : 0,
+                                               n ? r[2] : 0, n ? r[3] : 0);
+        for (int i = 1; i < n; i++)
+          d->add_rectangle_to_region(region, r[4*i] + tx, r[4*i+1] + ty, r[4*i+2], r[4*i+3]);
+        d->clip_region(region);
+        break;
+      }
+      case OP_RESTORE_CLIP: d->restore_clip(); break;
+      case OP_BEGIN_POINTS: case OP_BEGIN_LINE: case OP_BEGIN_LOOP:
+      case OP_BEGIN_POLYGON: case OP_BEGIN_COMPLEX_POLYGON:
+        if (in_path) d->pop_matrix();
+        in_path = 1;
+        d->push_matrix();
+        d->translate(tx, ty);
+        switch (o->op) {
+          case OP_BEGIN_POINTS: d->begin_points(); break;
+          case OP_BEGIN_LINE: d->begin_line(); break;
+          case OP_BEGIN_LOOP: d->begin_loop(); break;
+          case OP_BEGIN_POLYGON: d->begin_polygon(); break;
+          default: d->begin_complex_polygon(); break;
+        }
+        break;
+      case OP_VERTEX: d->vertex(f[0], f[1]); break;
+      case OP_GAP: d->gap(); break;
+      case OP_END_POINTS: case OP_END_LINE: case OP_END_LOOP:
+      case OP_END_POLYGON: case OP_END_COMPLEX_POLYGON:
+        switch (o->op) {
+          case OP_END_POINTS: d->end_points(); break;
+          case OP_END_LINE: d->end_line(); break;
+          case OP_END_LOOP: d->end_loop(); break;
+          case OP_END_POLYGON: d->end_polygon(); break;
+          default: d->end_complex_polygon(); break;
+        }
+        if (in_path) d->pop_matrix();
+        in_path = 0;
+        break;
+      case OP_CIRCLE:
+        d->push_matrix();
+        if (!in_path) d->translate(tx, ty);
+        d->mult_matrix(f[3], f[4], f[5], f[6], f[7], f[8]);
+        d->circle(f[0], f[1], f[2]);
+        d->pop_matrix();
+        break;
+      case OP_ARC: d->arc(v[0] + tx, v[1] + ty, v[2], v[3], f[0], f[1]); break;
+      case OP_PIE: d->pie(v[0] + tx, v[1] + ty, v[2], v[3], f[0], f[1]); break;
+      case OP_TEXT: d->draw((const char*)bytes, (int)o->n_bytes, v[0] + tx, v[1] + ty); break;
+      case OP_TEXT_ANGLE:
+        d->draw(v[0], (const char*)bytes, (int)o->n_bytes, v[1] + tx, v[2] + ty);
+        break;
+      case OP_TEXT_RTL: d->rtl_draw((const char*)bytes, (int)o->n_bytes, v[0] + tx, v[1] + ty); break;
+      case OP_IMAGE: d->draw_image(bytes, v[0] + tx, v[1] + ty, v[2], v[3], v[4], 0); break;
+      case OP_IMAGE_MONO: d->draw_image_mono(bytes, v[0] + tx, v[1] + ty, v[2], v[3], v[4], 0); break;
+      case OP_RGB_IMAGE:
+        d->draw_rgb((Fl_RGB_Image*)images_[v[0]], v[1] + tx, v[2] + ty, v[3], v[4], v[5], v[6]);
+        break;
+      case OP_BITMAP:
+        d->draw_bitmap((Fl_Bitmap*)images_[v[0]], v[1] + tx, v[2] + ty, v[3], v[4], v[5], v[6]);
+        break;
+      case OP_ORIGIN:
+        if (depth < ORIGIN_STACK_SIZE) {
+          stack_x[depth] = tx;
+          stack_y[depth] = ty;
+        }
+        depth++;
+        tx += v[0];
+        ty += v[1];
+        break;
+      case OP_ORIGIN_POP:
+        if (depth > 0 && --depth < ORIGIN_STACK_SIZE) {
+          tx = stack_x[depth];
+          ty = stack_y[depth];
+        }
+        break;
+    }
+  }
+  if (in_path) d->pop_matrix();
+}
+
+
+/**
+ Creates a driver that records in \p list, and gets the sizes of texts
+ from \p metrics.
+ */
+Fl_Display_List_Driver::Fl_Display_List_Driver(Fl_Display_List *list, Fl_Graphics_Driver *metrics) {
+  list_ = list;
+  metrics_ = metrics;
+  color_ = FL_BLACK;
+}
+
+
+/** Moves all later calls by \p dx, \p dy, until untranslate_all(). */
+void Fl_Display_List_Driver::translate_all(int dx, int dy) {
+  int v[2] = {dx, dy};
+  list_->add(OP_ORIGIN, v, 2);
+}
+
+
+/** Ends the last translate_all(). */
+void Fl_Display_List_Driver::untranslate_all() {
+  list_->add(OP_ORIGIN_POP, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::point(int x, int y) {
+  int v[2] = {x, y};
+  list_->add(OP_POINT, v, 2);
+}
+
+
+void Fl_Display_List_Driver::rect(int x, int y, int w, int h) {
+  int v[4] = {x, y, w, h};
+  list_->add(OP_RECT, v, 4);
+}
+
+
+void Fl_Display_List_Driver::focus_rect(int x, int y, int w, int h) {
+  int v[4] = {x, y, w, h};
+  list_->add(OP_FOCUS_RECT, v, 4);
+}
+
+
+void Fl_Display_List_Driver::rectf(int x, int y, int w, int h) {
+  int v[4] = {x, y, w, h};
+  list_->add(OP_RECTF, v, 4);
+}
+
+
+void Fl_Display_List_Driver::line(int x, int y, int x1, int y1) {
+  int v[4] = {x, y, x1, y1};
+  list_->add(OP_LINE, v, 4);
+}
+
+
+void Fl_Display_List_Driver::line(int x, int y, int x1, int y1, int x2, int y2) {
+  int v[6] = {x, y, x1, y1, x2, y2};
+  list_->add(OP_LINE2, v, 6);
+}
+
+
+void Fl_Display_List_Driver::xyline(int x, int y, int x1) {
+  int v[3] = {x, y, x1};
+  list_->add(OP_XYLINE, v, 3);
+}
+
+
+void Fl_Display_List_Driver::xyline(int x, int y, int x1, int y2) {
+  int v[4] = {x, y, x1, y2};
+  list_->add(OP_XYLINE2, v, 4);
+}
+
+
+void Fl_Display_List_Driver::xyline(int x, int y, int x1, int y2, int x3) {
+  int v[5] = {x, y, x1, y2, x3};
+  list_->add(OP_XYLINE3, v, 5);
+}
+
+
+void Fl_Display_List_Driver::yxline(int x, int y, int y1) {
+  int v[3] = {x, y, y1};
+  list_->add(OP_YXLINE, v, 3);
+}
+
+
+void Fl_Display_List_Driver::yxline(int x, int y, int y1, int x2) {
+  int v[4] = {x, y, y1, x2};
+  list_->add(OP_YXLINE2, v, 4);
+}
+
+
+void Fl_Display_List_Driver::yxline(int x, int y, int y1, int x2, int y3) {
+  int v[5] = {x, y, y1, x2, y3};
+  list_->add(OP_YXLINE3, v, 5);
+}
+
+
+void Fl_Display_List_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2) {
+  int v[6] = {x0, y0, x1, y1, x2, y2};
+  list_->add(OP_LOOP, v, 6);
+}
+
+
+void Fl_Display_List_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
+  int v[8] = {x0, y0, x1, y1, x2, y2, x3, y3};
+  list_->add(OP_LOOP4, v, 8);
+}
+
+
+void Fl_Display_List_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2) {
+  int v[6] = {x0, y0, x1, y1, x2, y2};
+  list_->add(OP_POLYGON, v, 6);
+}
+
+
+void Fl_Display_List_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
+  int v[8] = {x0, y0, x1, y1, x2, y2, x3, y3};
+  list_->add(OP_POLYGON4, v, 8);
+}
+
+
+void Fl_Display_List_Driver::push_clip(int x, int y, int w, int h) {
+  int v[4] = {x, y, w, h};
+  list_->add(OP_PUSH_CLIP, v, 4);
+  if (rstackptr < region_stack_max) rstack[++rstackptr] = 0;
+}
+
+
+// The clip is only known when the list is replayed.
+int Fl_Display_List_Driver::clip_box(int x, int y, int w, int h, int &X, int &Y, int &W, int &H) {
+  X = x; Y = y; W = w; H = h;
+  return 0;
+}
+
+
+void Fl_Display_List_Driver::push_no_clip() {
+  list_->add(OP_PUSH_NO_CLIP, 0, 0);
+  if (rstackptr < region_stack_max) rstack[++rstackptr] = 0;
+}
+
+
+void Fl_Display_List_Driver::pop_clip() {
+  list_->add(OP_POP_CLIP, 0, 0);
+  if (rstackptr > 0) {
+    if (rstack[rstackptr]) XDestroyRegion(rstack[rstackptr]);
+    rstackptr--;
+  }
+}
+
+
+/** Records the rectangles of \p r, which the driver keeps. */
+void Fl_Display_List_Driver::clip_region(Fl_Region r) {
+  Fl_Banded_Region *region = (Fl_Banded_Region*)r;
+  int n = region ? region->rectangles() : 0;
+  int v[1] = {r != 0};
+  uchar *to = list_->add(OP_CLIP_REGION, 1, 0, n * 4 * sizeof(int));
+  memcpy(to, v, sizeof(int));
+  if (n) {
+    int *rects = (int*)(to + pad8(sizeof(int)));
+    int x, y, w, h;
+    region->extents(x, y, w, h);
+    Fl_Banded_Region::Iterator it(*region, x, y, w, h);
+    while (it.next(rects[0], rects[1], rects[2], rects[3])) rects += 4;
+  }
+  if (rstack[rstackptr]) XDestroyRegion(rstack[rstackptr]);
+  rstack[rstackptr] = r;
+  fl_clip_state_number++;
+}
+
+
+void Fl_Display_List_Driver::restore_clip() {
+  list_->add(OP_RESTORE_CLIP, 0, 0);
+  Fl_Graphics_Driver::restore_clip();
+}
+
+
+void Fl_Display_List_Driver::add_rectangle_to_region(Fl_Region r, int x, int y, int w, int h) {
+  ((Fl_Banded_Region*)r)->unite(x, y, w, h);
+}
+
+
+Fl_Region Fl_Display_List_Driver::XRectangleRegion(int x, int y, int w, int h) {
+  return (Fl_Region)new Fl_Banded_Region(x, y, w, h);
+}
+
+
+void Fl_Display_List_Driver::XDestroyRegion(Fl_Region r) {
+  delete (Fl_Banded_Region*)r;
+}
+
+
+void Fl_Display_List_Driver::begin_points() {
+  what = POINT_;
+  list_->add(OP_BEGIN_POINTS, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::begin_line() {
+  what = LINE;
+  list_->add(OP_BEGIN_LINE, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::begin_loop() {
+  what = LOOP;
+  list_->add(OP_BEGIN_LOOP, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::begin_polygon() {
+  what = POLYGON;
+  list_->add(OP_BEGIN_POLYGON, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::begin_complex_polygon() {
+  what = POLYGON;
+  list_->add(OP_BEGIN_COMPLEX_POLYGON, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::transformed_vertex(double xf, double yf) {
+  double *f = (double*)list_->add(OP_VERTEX, 0, 2, 0);
+  f[0] = xf;
+  f[1] = yf;
+}
+
+
+void Fl_Display_List_Driver::vertex(double x, double y) {
+  transformed_vertex(x*m.a + y*m.c + m.x, x*m.b + y*m.d + m.y);
+}
+
+
+void Fl_Display_List_Driver::end_points() {
+  list_->add(OP_END_POINTS, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::end_line() {
+  list_->add(OP_END_LINE, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::end_loop() {
+  list_->add(OP_END_LOOP, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::end_polygon() {
+  list_->add(OP_END_POLYGON, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::end_complex_polygon() {
+  list_->add(OP_END_COMPLEX_POLYGON, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::gap() {
+  list_->add(OP_GAP, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::circle(double x, double y, double r) {
+  double *f = (double*)list_->add(OP_CIRCLE, 0, 9, 0);
+  f[0] = x; f[1] = y; f[2] = r;
+  f[3] = m.a; f[4] = m.b; f[5] = m.c; f[6] = m.d; f[7] = m.x; f[8] = m.y;
+}
+
+
+void Fl_Display_List_Driver::arc(int x, int y, int w, int h, double a1, double a2) {
+  int *v = (int*)list_->add(OP_ARC, 4, 2, 0);
+  v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+  double *f = (double*)((uchar*)v + pad8(4 * sizeof(int)));
+  f[0] = a1; f[1] = a2;
+}
+
+
+void Fl_Display_List_Driver::pie(int x, int y, int w, int h, double a1, double a2) {
+  int *v = (int*)list_->add(OP_PIE, 4, 2, 0);
+  v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+  double *f = (double*)((uchar*)v + pad8(4 * sizeof(int)));
+  f[0] = a1; f[1] = a2;
+}
+
+
+void Fl_Display_List_Driver::line_style(int style, int width, char *dashes) {
+  size_t n = dashes ? strlen(dashes) + 1 : 0;
+  int *v = (int*)list_->add(OP_LINE_STYLE, 3, 0, n);
+  v[0] = style; v[1] = width; v[2] = dashes != 0;
+  if (n) memcpy((uchar*)v + pad8(3 * sizeof(int)), dashes, n);
+}
+
+
+void Fl_Display_List_Driver::color(Fl_Color c) {
+  color_ = c;
+  int v[1] = {(int)c};
+  list_->add(OP_COLOR, v, 1);
+}
+
+
+void Fl_Display_List_Driver::color(uchar r, uchar g, uchar b) {
+  color_ = fl_rgb_color(r, g, b);
+  int v[3] = {r, g, b};
+  list_->add(OP_RGB_COLOR, v, 3);
+}
+
+
+void Fl_Display_List_Driver::font(Fl_Font face, Fl_Fontsize fsize) {
+  Fl_Graphics_Driver::font(face, fsize);
+  int v[2] = {face, fsize};
+  list_->add(OP_FONT, v, 2);
+  metrics_->font(face, fsize);
+}
+
+
+double Fl_Display_List_Driver::width(const char *str, int n) {
+  if (metrics_->font() != font_ || metrics_->size() != size_) metrics_->font(font_, size_);
+  return metrics_->width(str, n);
+}
+
+
+double Fl_Display_List_Driver::width(unsigned int c) {
+  if (metrics_->font() != font_ || metrics_->size() != size_) metrics_->font(font_, size_);
+  return metrics_->width(c);
+}
+
+
+void Fl_Display_List_Driver::text_extents(const char *str, int n, int &dx, int &dy, int &w, int &h) {
+  if (metrics_->font() != font_ || metrics_->size() != size_) metrics_->font(font_, size_);
+  metrics_->text_extents(str, n, dx, dy, w, h);
+}
+
+
+int Fl_Display_List_Driver::height() {
+  if (metrics_->font() != font_ || metrics_->size() != size_) metrics_->font(font_, size_);
+  return metrics_->height();
+}
+
+
+int Fl_Display_List_Driver::descent() {
+  if (metrics_->font() != font_ || metrics_->size() != size_) metrics_->font(font_, size_);
+  return metrics_->descent();
+}
+
+
+// Records a text, with the angle for OP_TEXT_ANGLE.
+void Fl_Display_List_Driver::record_text(int op, const char *str, int n, int x, int y, int angle) {
+  if (n <= 0) return;
+  int n_ints = op == OP_TEXT_ANGLE ? 3 : 2;
+  int *v = (int*)list_->add(op, n_ints, 0, n);
+  int i = 0;
+  if (op == OP_TEXT_ANGLE) v[i++] = angle;
+  v[i++] = x;
+  v[i] = y;
+  memcpy((uchar*)v + pad8(n_ints * sizeof(int)), str, n);
+}
+
+
+void Fl_Display_List_Driver::draw(const char *str, int n, int x, int y) {
+  record_text(OP_TEXT, str, n, x, y, 0);
+}
+
+
+void Fl_Display_List_Driver::draw(int angle, const char *str, int n, int x, int y) {
+  record_text(OP_TEXT_ANGLE, str, n, x, y, angle);
+}
+
+
+void Fl_Display_List_Driver::rtl_draw(const char *str, int n, int x, int y) {
+  record_text(OP_TEXT_RTL, str, n, x, y, 0);
+}
+
+
+// Copies the pixels of an image, from buf or cb, without gaps between
+// pixels and lines.
+void Fl_Display_List_Driver::record_image(const uchar *buf, Fl_Draw_Image_Cb cb, void *data,
+                                          int X, int Y, int W, int H, int D, int L, int mono) {
+  int d = D < 0 ? -D : D;
+  if (W <= 0 || H <= 0 || !d || (cb && D < 0)) return;
+  size_t line = (size_t)W * d;
+  int *v = (int*)list_->add(mono ? OP_IMAGE_MONO : OP_IMAGE, 5, 0, line * H);
+  v[0] = X; v[1] = Y; v[2] = W; v[3] = H; v[4] = d;
+  uchar *to = (uchar*)v + pad8(5 * sizeof(int));
+  if (!L) L = W * d;
+  for (int y = 0; y < H; y++, to += line) {
+    if (cb) {
+      cb(data, 0, y, W, to);
+      continue;
+    }
+    const uchar *from = buf + (ptrdiff_t)y * L;
+    if (D > 0) {
+      memcpy(to, from, line);
+      continue;
+    }
+    for (int x = 0; x < W; x++, from += D) memcpy(to + x * d, from, d);
+  }
+}
+
+
+void Fl_Display_List_Driver::draw_image(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  record_image(buf, 0, 0, X, Y, W, H, D, L, 0);
+}
+
+
+void Fl_Display_List_Driver::draw_image_mono(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  record_image(buf, 0, 0, X, Y, W, H, D, L, 1);
+}
+
+
+void Fl_Display_List_Driver::draw_image(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  record_image(0, cb, data, X, Y, W, H, D, 0, 0);
+}
+
+
+void Fl_Display_List_Driver::draw_image_mono(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  record_image(0, cb, data, X, Y, W, H, D, 0, 1);
+}
+
+
+// Images are copied at the size they are drawn.
+void Fl_Display_List_Driver::draw_rgb(Fl_RGB_Image *img, int XP, int YP, int WP, int HP, int cx, int cy) {
+  if (!img->d() || !img->array) return;
+  int v[7] = {list_->add_image(img->copy(img->w(), img->h())), XP, YP, WP, HP, cx, cy};
+  list_->add(OP_RGB_IMAGE, v, 7);
+}
+
+
+void Fl_Display_List_Driver::draw_pixmap(Fl_Pixmap *pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  if (pxm->w() <= 0 || pxm->h() <= 0) return;
+  int v[7] = {list_->add_image(new Fl_RGB_Image(pxm)), XP, YP, WP, HP, cx, cy};
+  list_->add(OP_RGB_IMAGE, v, 7);
+}
+
+
+void Fl_Display_List_Driver::draw_bitmap(Fl_Bitmap *bm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  if (!bm->array) return;
+  int v[7] = {list_->add_image(bm->copy(bm->w(), bm->h())), XP, YP, WP, HP, cx, cy};
+  list_->add(OP_BITMAP, v, 7);
+}
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,251 @@
+//
+// "$Id$"
+//
+// Drawing profiler for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Draw_Profiler.H>
+#include <FL/Fl_Trace.H>
+#include <FL/Fl_Widget.H>
+#include <FL/Fl_Device.H>
+#include <FL/fl_draw.H>
+#include "Fl_Profiling_Graphics_Driver.H"
+#include "flstring.h"
+#include <stdlib.h>
+
+// The counters of each widget are kept in an open addressing hash table
+// keyed by the address of the widget.
+
+#define LABEL_SIZE 32
+// widgets drawn inside more widgets than this are counted with their parents
+#define MAX_DEPTH 64
+
+struct Widget_Entry {
+  const Fl_Widget *widget;
+  const char *class_name;
+  char label[LABEL_SIZE];
+  Fl_Draw_Profiler_Record record;
+};
+
+int Fl_Draw_Profiler::enabled_ = 0;
+
+static Widget_Entry *table = 0;
+static int table_size = 0, table_count = 0;  // table_size is a power of 2
+static Fl_Draw_Profiler_Record totals_record, other_record;
+static unsigned long frame_count = 0;
+static const Fl_Widget *stack[MAX_DEPTH];
+static int depth = 0;
+static Fl_Draw_Profiler_Record *current = &other_record;
+static Fl_Profiling_Graphics_Driver *profiling_driver = 0;
+
+static const char *kind_names[FL_PROFILE_KINDS] = {
+  "point", "line", "rect", "polygon", "arc", "text", "metrics", "image", "clip", "state"
+};
+
+static unsigned hash(const Fl_Widget *w) {
+  fl_uintptr_t p = (fl_uintptr_t)w;
+  return (unsigned)((p >> 4) ^ (p >> 16)) * 2654435761U;
+}
+
+static Widget_Entry *find(const Fl_Widget *w) {
+  if (!table_size) return 0;
+  for (unsigned i = hash(w) & (table_size - 1); ; i = (i + 1) & (table_size - 1)) {
+    if (table[i].widget == w) return table + i;
+    if (!table[i].widget) return 0;
+  }
+}
+
+// Returns the entry of w, adding it, and growing the table, when needed.
+static Widget_Entry *add(const Fl_Widget *w) {
+  Widget_Entry *e = find(w);
+  if (e) return e;
+  if (4 * (table_count + 1) > 3 * table_size) {
+    Widget_Entry *old = table;
+    int old_size = table_size;
+    table_size = table_size ? 2 * table_size : 256;
+    table = (Widget_Entry*)calloc(table_size, sizeof(Widget_Entry));
+    for (int i = 0; i < old_size; i++) {
+      if (!old[i].widget) continue;
+      unsigned j = hash(old[i].widget) & (table_size - 1);
+      while (table[j].widget) j = (j + 1) & (table_size - 1);
+      table[j] = old[i];
+    }
+    free(old);
+  }
+  unsigned i = hash(w) & (table_size - 1);
+  while (table[i].widget) i = (i + 1) & (table_size - 1);
+  e = table + i;
+  e->widget = w;
+  e->class_name = Fl_Trace::class_name(w);
+  strlcpy(e->label, w->label() ? w->label() : "", LABEL_SIZE);
+  table_count++;
+  return e;
+}
+
+/**
+ Enables or disables the profiler.
+
+ Enabling it wraps the graphics driver of the display in a driver that
+ counts the calls, and disabling it unwraps the driver. Counters are kept
+ when the profiler is disabled; use reset() to clear them.
+ */
+void Fl_Draw_Profiler::enable(int on) {
+  on = (on != 0);
+  if (on == enabled_) return;
+  Fl_Display_Device *display = Fl_Display_Device::display_device();
+  // the display driver is remembered before it is wrapped
+  Fl_Graphics_Driver *real = &Fl_Graphics_Driver::default_driver();
+  if (on) {
+    if (!profiling_driver) profiling_driver = new Fl_Profiling_Graphics_Driver(real);
+    profiling_driver->sync();
+    display->driver(profiling_driver);
+    if (fl_graphics_driver == real) fl_graphics_driver = profiling_driver;
+  } else {
+    display->driver(real);
+    if (fl_graphics_driver == profiling_driver) fl_graphics_driver = real;
+  }
+  depth = 0;
+  current = &other_record;
+  enabled_ = on;
+}
+
+/** Clears all counters. */
+void Fl_Draw_Profiler::reset() {
+  if (table) memset(table, 0, table_size * sizeof(Widget_Entry));
+  table_count = 0;
+  memset(&totals_record, 0, sizeof(totals_record));
+  memset(&other_record, 0, sizeof(other_record));
+  frame_count = 0;
+  current = &other_record;
+  if (depth) current = &add(stack[(depth < MAX_DEPTH ? depth : MAX_DEPTH) - 1])->record;
+}
+
+void Fl_Draw_Profiler::begin_(const Fl_Widget *w) {
+  if (!depth) frame_count++;
+  if (depth < MAX_DEPTH) {
+    stack[depth] = w;
+    current = &add(w)->record;
+  }
+  depth++;
+}
+
+void Fl_Draw_Profiler::end_() {
+  if (!depth) return;
+  depth--;
+  if (!depth) current = &other_record;
+  else if (depth <= MAX_DEPTH) current = &find(stack[depth - 1])->record;
+}
+
+void Fl_Draw_Profiler::record(Fl_Draw_Profiler_Kind kind, double t, unsigned long bytes) {
+  if (t < 0) t = 0; // the clock went backwards
+  current->calls[kind]++;
+  current->time[kind] += t;
+  current->image_bytes += bytes;
+  totals_record.calls[kind]++;
+  totals_record.time[kind] += t;
+  totals_record.image_bytes += bytes;
+}
+
+/** Returns the number of frames, that is, of flushes of a window. */
+unsigned long Fl_Draw_Profiler::frames() {
+  return frame_count;
+}
+
+/** Returns the counters of all calls. */
+const Fl_Draw_Profiler_Record *Fl_Draw_Profiler::totals() {
+  return &totals_record;
+}
+
+/**
+ Returns the counters of the calls made while drawing \p w itself, not
+ its children, or NULL if \p w was never drawn. With NULL, returns the
+ counters of the calls made outside of any widget.
+ */
+const Fl_Draw_Profiler_Record *Fl_Draw_Profiler::widget(const Fl_Widget *w) {
+  if (!w) return &other_record;
+  Widget_Entry *e = find(w);
+  return e ? &e->record : NULL;
+}
+
+/** Returns a short printable name of \p kind. */
+const char *Fl_Draw_Profiler::kind_name(Fl_Draw_Profiler_Kind kind) {
+  if (kind < 0 || kind >= FL_PROFILE_KINDS) return "?";
+  return kind_names[kind];
+}
+
+static unsigned long total_calls(const Fl_Draw_Profiler_Record *r) {
+  unsigned long n = 0;
+  for (int k = 0; k < FL_PROFILE_KINDS; k++) n += r->calls[k];
+  return n;
+}
+
+static double total_time(const Fl_Draw_Profiler_Record *r) {
+  double t = 0;
+  for (int k = 0; k < FL_PROFILE_KINDS; k++) t += r->time[k];
+  return t;
+}
+
+extern "C" {
+  static int compare_entries(const void *a, const void *b) {
+    unsigned long ca = total_calls(&(*(const Widget_Entry* const*)a)->record);
+    unsigned long cb = total_calls(&(*(const Widget_Entry* const*)b)->record);
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+  }
+}
+
+/**
+ Prints the calls of each kind, then the \p max_widgets widgets that make
+ the most calls, per frame, to \p f.
+ */
+void Fl_Draw_Profiler::dump(FILE *f, int max_widgets) {
+  double frames = frame_count ? (double)frame_count : 1.0;
+  fprintf(f, "%lu frames\n", frame_count);
+  fprintf(f, "%-8s %12s %10s %10s\n", "kind", "calls", "per frame", "time(ms)");
+  for (int k = 0; k < FL_PROFILE_KINDS; k++) {
+    if (!totals_record.calls[k]) continue;
+    fprintf(f, "%-8s %12lu %10.1f %10.3f\n", kind_names[k], totals_record.calls[k],
+            totals_record.calls[k] / frames, totals_record.time[k] * 1000);
+  }
+  fprintf(f, "%lu bytes of images, %.0f per frame\n", totals_record.image_bytes,
+          totals_record.image_bytes / frames);
+  if (max_widgets <= 0) {
+    fflush(f);
+    return;
+  }
+  Widget_Entry **sorted = new Widget_Entry*[table_count + 1];
+  int n = 0;
+  for (int i = 0; i < table_size; i++) if (table[i].widget) sorted[n++] = table + i;
+  qsort(sorted, n, sizeof(Widget_Entry*), compare_entries);
+  fprintf(f, "%10s %12s %10s %10s  %s\n", "calls/fr", "bytes/fr", "ms/fr", "main kind", "widget");
+  for (int i = 0; i <= n && i <= max_widgets; i++) {
+    // calls outside of widgets come last
+    int other = (i == n || i == max_widgets);
+    const Fl_Draw_Profiler_Record *r = other ? &other_record : &sorted[i]->record;
+    if (!total_calls(r)) continue;
+    int main_kind = 0;
+    for (int k = 1; k < FL_PROFILE_KINDS; k++) if (r->calls[k] > r->calls[main_kind]) main_kind = k;
+    fprintf(f, "%10.1f %12.0f %10.3f %10s  ", total_calls(r) / frames, r->image_bytes / frames,
+            total_time(r) * 1000 / frames, kind_names[main_kind]);
+    if (other) fprintf(f, "(outside of widgets)\n");
+    else fprintf(f, "%s \"%s\" %p\n", sorted[i]->class_name, sorted[i]->label, (void*)sorted[i]->widget);
+  }
+  delete[] sorted;
+  fflush(f);
+}
+
+//
+// End of "$Id$".
+//
@@ -23,8 +23,12 @@
 
 #include <FL/Fl_Group.H>
 #include "Fl_Window_Driver.H"
+#include "Fl_Group_Index.H"
+#include "Fl_Pointer_Set.H"
 #include <FL/Fl_Rect.H>
 #include <FL/fl_draw.H>
+#include <FL/Fl_Trace.H>
+#include <FL/Fl_Draw_Profiler.H>
 
 #include <stdlib.h> // malloc etc.
 
@@ -120,6 +124,27 @@ static int send(Fl_Widget* o, int event) {
   return ret;
 }
 
+// The children of a group that may be below the mouse, topmost first:
+// either all children or the result of a query of the spatial index.
+class Fl_Group_Mouse_Children {
+  Fl_Widget*const* a_;
+  int n_;
+  int indexed_;
+  Fl_Group_Index_List list_;
+public:
+  Fl_Group_Mouse_Children(Fl_Group_Index *index, Fl_Widget*const* a, int n) {
+    a_ = a;
+    n_ = n;
+    indexed_ = (index != 0);
+    if (indexed_) {
+      index->at(Fl::event_x(), Fl::event_y(), list_);
+      n_ = list_.size();
+    }
+  }
+  int size() const { return n_; }
+  Fl_Widget *operator[](int k) const { return a_[indexed_ ? list_[k] : n_ - 1 - k]; }
+};
+
 // translate the current keystroke into up/down/left/right for navigation:
 static int navkey() {
   // The app may want these for hotkeys, check key state
@@ -173,12 +198,13 @@ int Fl_Group::handle(int event) {
   case FL_KEYBOARD:
     return navigation(navkey());
 
-  case FL_SHORTCUT:
-    for (i = children(); i--;) {
-      o = a[i];
+  case FL_SHORTCUT: {
+    Fl_Group_Mouse_Children below(index_, a, children());
+    for (i = 0; i < below.size(); i++) {
+      o = below[i];
       if (o->takesevents() && Fl::event_inside(o) && send(o,FL_SHORTCUT))
 	return 1;
-    }
+    }}
     for (i = children(); i--;) {
       o = a[i];
       if (o->takesevents() && !Fl::event_inside(o) && send(o,FL_SHORTCUT))
@@ -188,9 +214,10 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_ENTER:
-  case FL_MOVE:
-    for (i = children(); i--;) {
-      o = a[i];
+  case FL_MOVE: {
+    Fl_Group_Mouse_Children below(index_, a, children());
+    for (i = 0; i < below.size(); i++) {
+      o = below[i];
       if (o->visible() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_MOVE);
@@ -201,12 +228,13 @@ int Fl_Group::handle(int event) {
       }
     }
     Fl::belowmouse(this);
-    return 1;
+    return 1;}
 
   case FL_DND_ENTER:
-  case FL_DND_DRAG:
-    for (i = children(); i--;) {
-      o = a[i];
+  case FL_DND_DRAG: {
+    Fl_Group_Mouse_Children below(index_, a, children());
+    for (i = 0; i < below.size(); i++) {
+      o = below[i];
       if (o->takesevents() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_DND_DRAG);
@@ -217,11 +245,12 @@ int Fl_Group::handle(int event) {
       }
     }
     Fl::belowmouse(this);
-    return 0;
+    return 0;}
 
-  case FL_PUSH:
-    for (i = children(); i--;) {
-      o = a[i];
+  case FL_PUSH: {
+    Fl_Group_Mouse_Children below(index_, a, children());
+    for (i = 0; i < below.size(); i++) {
+      o = below[i];
       if (o->takesevents() && Fl::event_inside(o)) {
 	Fl_Widget_Tracker wp(o);
 	if (send(o,FL_PUSH)) {
@@ -230,7 +259,7 @@ int Fl_Group::handle(int event) {
 	}
       }
     }
-    return 0;
+    return 0;}
 
   case FL_RELEASE:
   case FL_DRAG:
@@ -238,8 +267,9 @@ int Fl_Group::handle(int event) {
     if (o == this) return 0;
     else if (o) send(o,event);
     else {
-      for (i = children(); i--;) {
-	o = a[i];
+      Fl_Group_Mouse_Children below(index_, a, children());
+      for (i = 0; i < below.size(); i++) {
+	o = below[i];
 	if (o->takesevents() && Fl::event_inside(o)) {
 	  if (send(o,event)) return 1;
 	}
@@ -247,12 +277,13 @@ int Fl_Group::handle(int event) {
     }
     return 0;
 
-  case FL_MOUSEWHEEL:
-    for (i = children(); i--;) {
-      o = a[i];
+  case FL_MOUSEWHEEL: {
+    Fl_Group_Mouse_Children below(index_, a, children());
+    for (i = 0; i < below.size(); i++) {
+      o = below[i];
       if (o->takesevents() && Fl::event_inside(o) && send(o,FL_MOUSEWHEEL))
 	return 1;
-    }
+    }}
     for (i = children(); i--;) {
       o = a[i];
       if (o->takesevents() && !Fl::event_inside(o) && send(o,FL_MOUSEWHEEL))
@@ -363,9 +394,13 @@ Fl_Group::Fl_Group(int X,int Y,int W,int H,const char *l)
 : Fl_Widget(X,Y,W,H,l) {
   align(FL_ALIGN_TOP);
   children_ = 0;
+  alloc_ = 0;
+  bulk_ = 0;
+  bulk_init_sizes_ = 0;
   array_ = 0;
   savedfocus_ = 0;
   resizable_ = this;
+  index_ = 0;
   bounds_ = 0; // this is allocated when first resize() is done
   sizes_ = 0; // see bounds_ (FLTK 1.3 compatibility)
 
@@ -452,7 +487,9 @@ void Fl_Group::clear() {
   widgets' destructors would be called twice!
 */
 Fl_Group::~Fl_Group() {
+  bulk_ = 0;
   clear();
+  delete index_;
 }
 
 /**
@@ -476,13 +513,16 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
     array_ = (Fl_Widget**)&o;
   } else if (children_ == 1) { // go from 1 to 2 children
     Fl_Widget* t = (Fl_Widget*)array_;
-    array_ = (Fl_Widget**)malloc(2*sizeof(Fl_Widget*));
+    if (alloc_ < 2) alloc_ = 2;
+    array_ = (Fl_Widget**)malloc(alloc_*sizeof(Fl_Widget*));
     if (index) {array_[0] = t; array_[1] = &o;}
     else {array_[0] = &o; array_[1] = t;}
   } else {
-    if (!(children_ & (children_-1))) // double number of children
+    if (children_ >= alloc_) { // double number of children
+      alloc_ = 2*children_;
       array_ = (Fl_Widget**)realloc((void*)array_,
-				    2*children_*sizeof(Fl_Widget*));
+				    alloc_*sizeof(Fl_Widget*));
+    }
     int j; for (j = children_; j > index; j--) array_[j] = array_[j-1];
     array_[j] = &o;
   }
@@ -496,6 +536,75 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
 */
 void Fl_Group::add(Fl_Widget &o) {insert(o, children_);}
 
+/**
+  Adds \p n widgets to the end of this group.
+
+  This is the same as calling add() for each widget of \p list, in order,
+  but the child array is grown only once and init_sizes() is called only
+  once at the end, so that adding many widgets takes linear time.
+
+  \param[in] list array of \p n widgets
+  \param[in] n number of widgets in \p list
+
+  \see reserve(int), begin_bulk()
+  \since FLTK 1.4.0
+*/
+void Fl_Group::add_many(Fl_Widget* const* list, int n) {
+  if (n <= 0) return;
+  begin_bulk();
+  reserve(children_ + n);
+  for (int i = 0; i < n; i++) insert(*list[i], children_);
+  end_bulk();
+}
+
+/**
+  Preallocates room for \p n children.
+
+  Use this before adding a known, large number of children to avoid
+  repeated reallocation of the child array. This does not change
+  the number of children. The reserved room is released when the
+  group goes down to one child.
+
+  \since FLTK 1.4.0
+*/
+void Fl_Group::reserve(int n) {
+  if (n <= alloc_) return;
+  if (children_ > 1)
+    array_ = (Fl_Widget**)realloc((void*)array_, n*sizeof(Fl_Widget*));
+  alloc_ = n;
+}
+
+/**
+  Starts a bulk modification of the group.
+
+  Until the matching end_bulk() call, init_sizes() - which is called
+  by every add(), insert() and remove() - is deferred and run only once
+  by end_bulk(). Calls can be nested.
+
+  \code
+    group->begin_bulk();
+    for (int i = 0; i < 10000; i++) group->add(new Fl_Box(...));
+    group->end_bulk();
+  \endcode
+
+  \see end_bulk(), add_many()
+  \since FLTK 1.4.0
+*/
+void Fl_Group::begin_bulk() {
+  bulk_++;
+}
+
+/**
+  Ends a bulk modification of the group started by begin_bulk().
+  Runs init_sizes() if it was requested in between.
+
+  \since FLTK 1.4.0
+*/
+void Fl_Group::end_bulk() {
+  if (bulk_ > 0) bulk_--;
+  if (!bulk_ && bulk_init_sizes_) init_sizes();
+}
+
 /**
   Removes the widget at \p index from the group but does not delete it.
 
@@ -521,6 +630,7 @@ void Fl_Group::remove(int index) {
     Fl_Widget *t = array_[!index];
     free((void*)array_);
     array_ = (Fl_Widget**)t;
+    alloc_ = 0;
   } else if (children_ > 1) { // delete from array
     for (; index < children_; index++) array_[index] = array_[index+1];
   }
@@ -546,6 +656,51 @@ void Fl_Group::remove(Fl_Widget &o) {
   if (i < children_) remove(i);
 }
 
+/**
+  Removes several widgets from the group but does not delete them.
+
+  This is the same as calling remove(Fl_Widget&) for each widget of \p list,
+  but the array of children is compacted in a single pass, which is much
+  faster when many children of a large group are removed at once.
+  Widgets of \p list that are not children of the group are ignored.
+
+  \param[in] list array of pointers to the widgets to remove
+  \param[in] n number of widgets in \p list
+
+  \see add_many()
+  \since FLTK 1.4.0
+*/
+void Fl_Group::remove_many(Fl_Widget* const* list, int n) {
+  if (n <= 0 || !children_) return;
+  if (n == 1 || children_ == 1) {
+    for (int i = 0; i < n; i++) if (list[i]) remove(*list[i]);
+    return;
+  }
+  Fl_Pointer_Set set;
+  int i;
+  for (i = 0; i < n; i++) if (list[i] && list[i]->parent_ == this) set.insert(list[i]);
+  if (!set.count()) return;
+  Fl_Widget **a = array_;
+  int j = 0;
+  for (i = 0; i < children_; i++) {
+    Fl_Widget *o = a[i];
+    if (set.contains(o)) {
+      if (o == savedfocus_) savedfocus_ = 0;
+      o->parent_ = 0;
+    } else {
+      a[j++] = o;
+    }
+  }
+  children_ = j;
+  if (children_ < 2) { // back to the single child or empty array
+    Fl_Widget *t = children_ ? a[0] : 0;
+    free((void*)a);
+    array_ = children_ ? (Fl_Widget**)t : 0;
+    alloc_ = 0;
+  }
+  init_sizes();
+}
+
 /**
   Resets the internal array of widget sizes and positions.
 
@@ -565,12 +720,49 @@ void Fl_Group::remove(Fl_Widget &o) {
   \see sizes() (deprecated)
 */
 void Fl_Group::init_sizes() {
+  if (index_) index_->invalidate();
+  if (bulk_) { // deferred until end_bulk()
+    bulk_init_sizes_ = 1;
+    return;
+  }
+  bulk_init_sizes_ = 0;
   delete[] bounds_;
   bounds_ = 0;
   delete[] sizes_;	// FLTK 1.3 compatibility
   sizes_ = 0;		// FLTK 1.3 compatibility
 }
 
+/**
+  Enables or disables the spatial index of the children of the group.
+
+  By default, Fl_Group::handle() finds the child below the mouse by testing
+  all children, and draw_children() visits all children when the group
+  is fully redrawn. This is fine for usual groups, but costly for groups
+  holding thousands of children, such as canvas or schematic views.
+
+  With the spatial index enabled, the group keeps a grid of the areas covered
+  by its children, including their outside labels. Mouse events are only
+  tested against the children that overlap the grid cell of the mouse, and
+  a full redraw only visits the children that overlap the clip region.
+  The order in which children receive events and are drawn is unchanged.
+
+  The index is rebuilt in a single pass over all children when it is used
+  after a child was added, removed or resized, or after init_sizes()
+  was called. If you change the geometry of children without calling their
+  resize() method, call init_sizes().
+
+  \param[in] on non-zero to enable the spatial index, 0 to disable it
+
+  \since FLTK 1.4.0
+*/
+void Fl_Group::spatial_index(int on) {
+  if (on && !index_) index_ = new Fl_Group_Index(this);
+  else if (!on && index_) {
+    delete index_;
+    index_ = 0;
+  }
+}
+
 /**
   Returns the internal array of widget sizes and positions.
 
@@ -614,6 +806,13 @@ void Fl_Group::init_sizes() {
       lots of unnecessary dependencies on Fl_Rect.H.
 */
 Fl_Rect* Fl_Group::bounds() {
+  if (bulk_init_sizes_) { // children changed during a bulk operation
+    bulk_init_sizes_ = 0;
+    delete[] bounds_;
+    bounds_ = 0;
+    delete[] sizes_;
+    sizes_ = 0;
+  }
   if (!bounds_) {
     Fl_Rect* p = bounds_ = new Fl_Rect[children_+2];
     // first thing in bounds array is the group's size:
@@ -673,10 +872,10 @@ Fl_Rect* Fl_Group::bounds() {
 */
 int* Fl_Group::sizes()
 {
+  Fl_Rect *rb = bounds(); // this also discards an outdated sizes_ array
   if (sizes_) return sizes_;
   // allocate new sizes_ array and copy bounds_ over to sizes_
   int* pi = sizes_ = new int[4*(children_+2)];
-  Fl_Rect *rb = bounds();
   for (int i = 0; i < children_+2; i++, rb++) {
     *pi++ = rb->x();
     *pi++ = rb->r();
@@ -801,7 +1000,18 @@ void Fl_Group::draw_children() {
 		 h() - Fl::box_dh(box()));
   }
 
-  if (damage() & ~FL_DAMAGE_CHILD) { // redraw the entire thing:
+  if ((damage() & ~FL_DAMAGE_CHILD) && index_) {
+    // redraw the children that overlap the clip region:
+    int X, Y, W, H;
+    fl_clip_box(-0x4000, -0x4000, 0x8000, 0x8000, X, Y, W, H);
+    Fl_Group_Index_List list;
+    index_->in_rect(X, Y, W, H, list);
+    for (int i = 0; i < list.size(); i++) {
+      Fl_Widget& o = *a[list[i]];
+      draw_child(o);
+      draw_outside_label(o);
+    }
+  } else if (damage() & ~FL_DAMAGE_CHILD) { // redraw the entire thing:
     for (int i=children_; i--;) {
       Fl_Widget& o = **a++;
       draw_child(o);
@@ -833,7 +1043,11 @@ void Fl_Group::draw() {
 void Fl_Group::update_child(Fl_Widget& widget) const {
   if (widget.damage() && widget.visible() && widget.type() < FL_WINDOW &&
       fl_not_clipped(widget.x(), widget.y(), widget.w(), widget.h())) {
+    Fl_Trace::begin(&widget, "draw");
+    Fl_Draw_Profiler::begin(&widget);
     widget.draw();
+    Fl_Draw_Profiler::end();
+    Fl_Trace::end();
     widget.clear_damage();
   }
 }
@@ -848,7 +1062,11 @@ void Fl_Group::draw_child(Fl_Widget& widget) const {
   if (widget.visible() && widget.type() < FL_WINDOW &&
       fl_not_clipped(widget.x(), widget.y(), widget.w(), widget.h())) {
     widget.clear_damage(FL_DAMAGE_ALL);
+    Fl_Trace::begin(&widget, "draw");
+    Fl_Draw_Profiler::begin(&widget);
     widget.draw();
+    Fl_Draw_Profiler::end();
+    Fl_Trace::end();
     widget.clear_damage();
   }
 }
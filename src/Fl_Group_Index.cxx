@@ -0,0 +1,223 @@
+//
+// "$Id$"
+//
+// Spatial index of the children of an Fl_Group for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Group_Index.H"
+#include <FL/Fl_Widget.H>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The grid never has more than MAX_CELLS columns or rows
+#define MAX_CELLS 512
+
+Fl_Group_Index_List::~Fl_Group_Index_List() {
+  if (list_ != local_) free(list_);
+}
+
+void Fl_Group_Index_List::grow() {
+  alloc_ *= 2;
+  if (list_ == local_) {
+    list_ = (int*)malloc(alloc_ * sizeof(int));
+    memcpy(list_, local_, size_ * sizeof(int));
+  } else {
+    list_ = (int*)realloc(list_, alloc_ * sizeof(int));
+  }
+}
+
+static int compare_ints(const void *a, const void *b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+/** Sorts the list in increasing order and removes duplicates. */
+void Fl_Group_Index_List::sort_unique() {
+  if (size_ < 2) return;
+  qsort(list_, size_, sizeof(int), compare_ints);
+  int j = 1;
+  for (int i = 1; i < size_; i++) {
+    if (list_[i] != list_[j-1]) list_[j++] = list_[i];
+  }
+  size_ = j;
+}
+
+Fl_Group_Index::Fl_Group_Index(Fl_Group *g) {
+  group_ = g;
+  dirty_ = 1;
+  n_ = 0;
+  gx_ = gy_ = 1;
+  x0_ = y0_ = 0;
+  cw_ = ch_ = 1;
+  cell_start_ = 0;
+  entries_ = 0;
+  big_ = 0;
+  nbig_ = 0;
+}
+
+Fl_Group_Index::~Fl_Group_Index() {
+  free(cell_start_);
+  free(entries_);
+  free(big_);
+}
+
+// The area a child may draw into: its bounding box, plus the box of
+// its label if the label is drawn outside by Fl_Group::draw_outside_label().
+void Fl_Group_Index::child_box(Fl_Widget *o, int &X, int &Y, int &W, int &H) const {
+  X = o->x(); Y = o->y(); W = o->w(); H = o->h();
+  Fl_Align a = o->align();
+  if (!(a & 15) || (a & FL_ALIGN_INSIDE)) return;
+  if (!o->label() && !o->image()) return;
+  int ww = 0, hh = 0;
+  o->measure_label(ww, hh);
+  if (a & (FL_ALIGN_LEFT | FL_ALIGN_RIGHT)) {
+    if (a & FL_ALIGN_LEFT) X -= ww + 3;
+    W += ww + 3;
+    Y -= hh / 2; H += hh;
+  } else {
+    if (a & FL_ALIGN_TOP) Y -= hh;
+    H += hh;
+    X -= ww / 2; W += ww;
+  }
+}
+
+void Fl_Group_Index::cell_range(int X, int Y, int W, int H,
+                                int &c0, int &r0, int &c1, int &r1) const {
+  if (W < 1) W = 1;
+  if (H < 1) H = 1;
+  c0 = X < x0_ ? 0 : (X - x0_) / cw_;
+  r0 = Y < y0_ ? 0 : (Y - y0_) / ch_;
+  c1 = X + W - 1 < x0_ ? 0 : (X + W - 1 - x0_) / cw_;
+  r1 = Y + H - 1 < y0_ ? 0 : (Y + H - 1 - y0_) / ch_;
+  if (c0 >= gx_) c0 = gx_ - 1;
+  if (c1 >= gx_) c1 = gx_ - 1;
+  if (r0 >= gy_) r0 = gy_ - 1;
+  if (r1 >= gy_) r1 = gy_ - 1;
+}
+
+void Fl_Group_Index::rebuild() {
+  free(cell_start_); cell_start_ = 0;
+  free(entries_); entries_ = 0;
+  free(big_); big_ = 0;
+  nbig_ = 0;
+  dirty_ = 0;
+  int n = n_ = group_->children();
+  Fl_Widget*const* a = group_->array();
+
+  // get all boxes and their bounding box:
+  int *box = (int*)malloc((4 * n + 1) * sizeof(int));
+  int xmin = 0, ymin = 0, xmax = 1, ymax = 1;
+  int i;
+  for (i = 0; i < n; i++) {
+    int *b = box + 4 * i;
+    child_box(a[i], b[0], b[1], b[2], b[3]);
+    if (!i || b[0] < xmin) xmin = b[0];
+    if (!i || b[1] < ymin) ymin = b[1];
+    if (!i || b[0] + b[2] > xmax) xmax = b[0] + b[2];
+    if (!i || b[1] + b[3] > ymax) ymax = b[1] + b[3];
+  }
+  int W = xmax - xmin; if (W < 1) W = 1;
+  int H = ymax - ymin; if (H < 1) H = 1;
+
+  // about one cell per child, as square as possible:
+  gx_ = (int)sqrt(double(n) * W / H);
+  if (gx_ < 1) gx_ = 1; else if (gx_ > MAX_CELLS) gx_ = MAX_CELLS;
+  gy_ = (n + gx_ - 1) / gx_;
+  if (gy_ < 1) gy_ = 1; else if (gy_ > MAX_CELLS) gy_ = MAX_CELLS;
+  x0_ = xmin; y0_ = ymin;
+  cw_ = (W + gx_ - 1) / gx_;
+  ch_ = (H + gy_ - 1) / gy_;
+  int ncells = gx_ * gy_;
+  int big_limit = ncells / 4; if (big_limit < 4) big_limit = 4;
+
+  // count the entries of each cell, shifted by one for the prefix sum:
+  cell_start_ = (int*)calloc(ncells + 1, sizeof(int));
+  char *is_big = (char*)calloc(n + 1, 1);
+  int c0, r0, c1, r1, c, r;
+  for (i = 0; i < n; i++) {
+    int *b = box + 4 * i;
+    cell_range(b[0], b[1], b[2], b[3], c0, r0, c1, r1);
+    if ((c1 - c0 + 1) * (r1 - r0 + 1) > big_limit) {
+      is_big[i] = 1;
+      nbig_++;
+      continue;
+    }
+    for (r = r0; r <= r1; r++)
+      for (c = c0; c <= c1; c++) cell_start_[r * gx_ + c + 1]++;
+  }
+  for (c = 0; c < ncells; c++) cell_start_[c + 1] += cell_start_[c];
+
+  // fill the cells in increasing child order:
+  entries_ = (int*)malloc((cell_start_[ncells] + 1) * sizeof(int));
+  big_ = (int*)malloc((nbig_ + 1) * sizeof(int));
+  int *fill = (int*)malloc(ncells * sizeof(int));
+  memcpy(fill, cell_start_, ncells * sizeof(int));
+  int k = 0;
+  for (i = 0; i < n; i++) {
+    if (is_big[i]) { big_[k++] = i; continue; }
+    int *b = box + 4 * i;
+    cell_range(b[0], b[1], b[2], b[3], c0, r0, c1, r1);
+    for (r = r0; r <= r1; r++)
+      for (c = c0; c <= c1; c++) entries_[fill[r * gx_ + c]++] = i;
+  }
+  free(fill);
+  free(is_big);
+  free(box);
+}
+
+/**
+ Returns the children that may contain the point (X,Y), topmost
+ (highest index) first. The caller must still test each child.
+ */
+void Fl_Group_Index::at(int X, int Y, Fl_Group_Index_List &list) {
+  if (dirty_ || n_ != group_->children()) rebuild();
+  list.clear();
+  if (!n_) return;
+  int c0, r0, c1, r1;
+  cell_range(X, Y, 1, 1, c0, r0, c1, r1);
+  int cell = r0 * gx_ + c0;
+  int s = cell_start_[cell];
+  int i = cell_start_[cell + 1] - 1;
+  int j = nbig_ - 1;
+  // merge the cell and the big children, in decreasing order:
+  while (i >= s || j >= 0) {
+    if (j < 0 || (i >= s && entries_[i] > big_[j])) list.add(entries_[i--]);
+    else list.add(big_[j--]);
+  }
+}
+
+/**
+ Returns the children that may draw into the given rectangle,
+ in increasing index order.
+ */
+void Fl_Group_Index::in_rect(int X, int Y, int W, int H, Fl_Group_Index_List &list) {
+  if (dirty_ || n_ != group_->children()) rebuild();
+  list.clear();
+  if (!n_) return;
+  int c0, r0, c1, r1, c, r, i;
+  cell_range(X, Y, W, H, c0, r0, c1, r1);
+  for (r = r0; r <= r1; r++) {
+    for (c = c0; c <= c1; c++) {
+      int cell = r * gx_ + c;
+      for (i = cell_start_[cell]; i < cell_start_[cell + 1]; i++) list.add(entries_[i]);
+    }
+  }
+  for (i = 0; i < nbig_; i++) list.add(big_[i]);
+  list.sort_unique();
+}
+
+//
+// End of "$Id$".
+//
@@ -104,6 +104,36 @@ Fl_Shared_Image* Fl_Image_Surface::highres_image()
   return s_img;
 }
 
+/** Makes the surface render large images in tiles, with several threads.
+ The surface then records all graphics requests instead of executing them,
+ and draws them when it stops being the current drawing surface or when
+ image() is called: the target is cut into squares of \p tile_size pixels,
+ which \p threads threads, or as many threads as processors if \p threads
+ is 0, take in turn and draw clipped to the square, directly in the memory
+ of the image.
+
+ This is available with the headless platform, whose images are in memory,
+ and where the result is the same as without tiles, and with X11. There,
+ the tiles are drawn in memory by the software driver of the headless
+ platform, so that image() doesn't read the pixels back from the X server,
+ but the image is of lower fidelity than without tiles: texts use the
+ stroke font of that driver, which only has ASCII characters and
+ approximate widths, shapes are rasterized by that driver rather than by
+ the X server, and offscreen() doesn't receive the drawing. Don't use it
+ on X11 for images that must look like the display. A surface that draws
+ into an offscreen of the caller, or that the GUI scale factor enlarges,
+ draws as before, as does the surface on the other platforms. Call it
+ before the surface becomes the current drawing surface.
+ \return non-zero if the surface draws in tiles
+ \version 1.4
+ */
+int Fl_Image_Surface::tiled(int tile_size, int threads) {
+  if (!platform_surface || Fl_Surface_Device::surface() == platform_surface) return 0;
+  if (!platform_surface->tiled(tile_size, threads)) return 0;
+  driver(platform_surface->driver());
+  return 1;
+}
+
 // Allows to delete the Fl_Image_Surface object while keeping its underlying Fl_Offscreen
 Fl_Offscreen Fl_Image_Surface::get_offscreen_before_delete_() {
   Fl_Offscreen keep = platform_surface->offscreen;
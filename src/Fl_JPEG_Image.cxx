@@ -82,123 +82,6 @@ extern "C" {
 #endif // HAVE_LIBJPEG
 
 
-/**
- \brief The constructor loads the JPEG image from the given jpeg filename.
- 
- The inherited destructor frees all memory and server resources that are used 
- by the image.
- 
- Use Fl_Image::fail() to check if Fl_JPEG_Image failed to load. fail() returns
- ERR_FILE_ACCESS if the file could not be opened or read, ERR_FORMAT if the
- JPEG format could not be decoded, and ERR_NO_IMAGE if the image could not
- be loaded for another reason. If the image has loaded correctly,
- w(), h(), and d() should return values greater than zero.
- 
- \param[in] filename a full path and name pointing to a valid jpeg file.
- */
-Fl_JPEG_Image::Fl_JPEG_Image(const char *filename)	// I - File to load
-: Fl_RGB_Image(0,0,0) {
-#ifdef HAVE_LIBJPEG
-  FILE				*fp;	// File pointer
-  jpeg_decompress_struct	dinfo;	// Decompressor info
-  fl_jpeg_error_mgr		jerr;	// Error handler info
-  JSAMPROW			row;	// Sample row pointer
-  
-  // the following variables are pointers allocating some private space that
-  // is not reset by 'setjmp()'
-  char* max_finish_decompress_err;      // count errors and give up afer a while
-  char* max_destroy_decompress_err;     // to avoid recusion and deadlock
-  
-  // Clear data...
-  alloc_array = 0;
-  array = (uchar *)0;
-  
-  // Open the image file...
-  if ((fp = fl_fopen(filename, "rb")) == NULL) {
-    ld(ERR_FILE_ACCESS);
-    return;
-  }
-  
-  // Setup the decompressor info and read the header...
-  dinfo.err                = jpeg_std_error((jpeg_error_mgr *)&jerr);
-  jerr.pub_.error_exit     = fl_jpeg_error_handler;
-  jerr.pub_.output_message = fl_jpeg_output_handler;
-  
-  // Setup error loop variables
-  max_finish_decompress_err = (char*)malloc(1);   // allocate space on the frame for error counters
-  max_destroy_decompress_err = (char*)malloc(1);  // otherwise, the variables are reset on the longjmp
-  *max_finish_decompress_err=10;
-  *max_destroy_decompress_err=10;
-  
-  if (setjmp(jerr.errhand_))
-  {
-    // JPEG error handling...
-    Fl::warning("JPEG file \"%s\" is too large or contains errors!\n", filename);
-    // if any of the cleanup routines hits another error, we would end up 
-    // in a loop. So instead, we decrement max_err for some upper cleanup limit.
-    if ( ((*max_finish_decompress_err)-- > 0) && array)
-      jpeg_finish_decompress(&dinfo);
-    if ( (*max_destroy_decompress_err)-- > 0)
-      jpeg_destroy_decompress(&dinfo);
-    
-    fclose(fp);
-    
-    w(0);
-    h(0);
-    d(0);
-    
-    if (array) {
-      delete[] (uchar *)array;
-      array = 0;
-      alloc_array = 0;
-    }
-    
-    free(max_destroy_decompress_err);
-    free(max_finish_decompress_err);
-    
-    ld(ERR_FORMAT);
-    return;
-  }
-  
-  jpeg_create_decompress(&dinfo);
-  jpeg_stdio_src(&dinfo, fp);
-  jpeg_read_header(&dinfo, TRUE);
-  
-  dinfo.quantize_colors      = (boolean)FALSE;
-  dinfo.out_color_space      = JCS_RGB;
-  dinfo.out_color_components = 3;
-  dinfo.output_components    = 3;
-  
-  jpeg_calc_output_dimensions(&dinfo);
-  
-  w(dinfo.output_width); 
-  h(dinfo.output_height);
-  d(dinfo.output_components);
-  
-  if (((size_t)w()) * h() * d() > max_size() ) longjmp(jerr.errhand_, 1);
-  array = new uchar[w() * h() * d()];
-  alloc_array = 1;
-  
-  jpeg_start_decompress(&dinfo);
-  
-  while (dinfo.output_scanline < dinfo.output_height) {
-    row = (JSAMPROW)(array +
-                     dinfo.output_scanline * dinfo.output_width *
-                     dinfo.output_components);
-    jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
-  }
-  
-  jpeg_finish_decompress(&dinfo);
-  jpeg_destroy_decompress(&dinfo);
-  
-  free(max_destroy_decompress_err);
-  free(max_finish_decompress_err);
-  
-  fclose(fp);
-#endif // HAVE_LIBJPEG
-}
-
-
 // data source manager for reading jpegs from memory
 // init_source (j_decompress_ptr cinfo)
 // fill_input_buffer (j_decompress_ptr cinfo)
@@ -271,6 +154,50 @@ static void jpeg_mem_src(j_decompress_ptr cinfo, const unsigned char *data)
 #endif // HAVE_LIBJPEG
 
 
+/**
+ \brief The constructor loads the JPEG image from the given jpeg filename.
+ 
+ The inherited destructor frees all memory and server resources that are used 
+ by the image.
+ 
+ Use Fl_Image::fail() to check if Fl_JPEG_Image failed to load. fail() returns
+ ERR_FILE_ACCESS if the file could not be opened or read, ERR_FORMAT if the
+ JPEG format could not be decoded, and ERR_NO_IMAGE if the image could not
+ be loaded for another reason. If the image has loaded correctly,
+ w(), h(), and d() should return values greater than zero.
+ 
+ \param[in] filename a full path and name pointing to a valid jpeg file.
+ */
+Fl_JPEG_Image::Fl_JPEG_Image(const char *filename)	// I - File to load
+: Fl_RGB_Image(0,0,0) {
+  load_jpg_(filename, 0, 0, 0, 0);
+}
+
+
+/**
+ \brief The constructor loads the JPEG image from the given jpeg filename,
+ reduced for display at size \p W x \p H.
+
+ The image is decoded at 1/2, 1/4 or 1/8 of its size, the smallest of these
+ that is still at least \p W x \p H, or at full size if none is. The
+ reduction is done by the JPEG decoder, which then computes and stores up
+ to 64 times fewer pixels. The image keeps the reduced size, and
+ Fl_Image::copy() can give it the exact size. If \p W or \p H is 0, this is
+ the same as Fl_JPEG_Image(const char *filename).
+
+ Fl_Shared_Image::get() uses this constructor when it is given a size.
+
+ \param[in] filename a full path and name pointing to a valid jpeg file.
+ \param[in] W, H the smallest size of the image
+
+ \version 1.4.0
+ */
+Fl_JPEG_Image::Fl_JPEG_Image(const char *filename, int W, int H)
+: Fl_RGB_Image(0,0,0) {
+  load_jpg_(filename, 0, 0, W, H);
+}
+
+
 /**
  \brief The constructor loads the JPEG image from memory.
 
@@ -293,7 +220,18 @@ static void jpeg_mem_src(j_decompress_ptr cinfo, const unsigned char *data)
  */
 Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
 : Fl_RGB_Image(0,0,0) {
+  load_jpg_(0, name, data, 0, 0);
+}
+
+
+// Loads the image from the file \p filename, or from \p data if filename
+// is NULL, then adds it to the shared images as \p sharename if not NULL.
+// If W and H are not 0, the image is decoded at a reduced scale.
+void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename,
+                              const unsigned char *data, int W, int H)
+{
 #ifdef HAVE_LIBJPEG
+  FILE				*fp = 0;	// File pointer
   jpeg_decompress_struct	dinfo;	// Decompressor info
   fl_jpeg_error_mgr		jerr;	// Error handler info
   JSAMPROW			row;	// Sample row pointer
@@ -307,6 +245,12 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   alloc_array = 0;
   array = (uchar *)0;
   
+  // Open the image file...
+  if (filename && (fp = fl_fopen(filename, "rb")) == NULL) {
+    ld(ERR_FILE_ACCESS);
+    return;
+  }
+  
   // Setup the decompressor info and read the header...
   dinfo.err                = jpeg_std_error((jpeg_error_mgr *)&jerr);
   jerr.pub_.error_exit     = fl_jpeg_error_handler;
@@ -321,7 +265,10 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   if (setjmp(jerr.errhand_))
   {
     // JPEG error handling...
-    Fl::warning("JPEG data is too large or contains errors!\n");
+    if (filename)
+      Fl::warning("JPEG file \"%s\" is too large or contains errors!\n", filename);
+    else
+      Fl::warning("JPEG data is too large or contains errors!\n");
     // if any of the cleanup routines hits another error, we would end up 
     // in a loop. So instead, we decrement max_err for some upper cleanup limit.
     if ( ((*max_finish_decompress_err)-- > 0) && array)
@@ -329,6 +276,8 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
     if ( (*max_destroy_decompress_err)-- > 0)
       jpeg_destroy_decompress(&dinfo);
     
+    if (fp) fclose(fp);
+    
     w(0);
     h(0);
     d(0);
@@ -342,11 +291,13 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
     free(max_destroy_decompress_err);
     free(max_finish_decompress_err);
     
+    ld(ERR_FORMAT);
     return;
   }
   
   jpeg_create_decompress(&dinfo);
-  jpeg_mem_src(&dinfo, data);
+  if (fp) jpeg_stdio_src(&dinfo, fp);
+  else jpeg_mem_src(&dinfo, data);
   jpeg_read_header(&dinfo, TRUE);
   
   dinfo.quantize_colors      = (boolean)FALSE;
@@ -356,6 +307,23 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   
   jpeg_calc_output_dimensions(&dinfo);
   
+  if (W > 0 && H > 0) {
+    // Let the decoder scale the image down in the DCT domain, as much as
+    // it can while keeping it at least W x H...
+    unsigned denom;
+    for (denom = 8; denom > 1; denom /= 2) {
+      dinfo.scale_num   = 1;
+      dinfo.scale_denom = denom;
+      jpeg_calc_output_dimensions(&dinfo);
+      if (dinfo.output_width >= (JDIMENSION)W &&
+          dinfo.output_height >= (JDIMENSION)H) break;
+    }
+    if (denom == 1) {
+      dinfo.scale_denom = 1;
+      jpeg_calc_output_dimensions(&dinfo);
+    }
+  }
+  
   w(dinfo.output_width); 
   h(dinfo.output_height);
   d(dinfo.output_components);
@@ -378,9 +346,11 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *name, const unsigned char *data)
   
   free(max_destroy_decompress_err);
   free(max_finish_decompress_err);
+  
+  if (fp) fclose(fp);
 
-  if (w() && h() && name) {
-    Fl_Shared_Image *si = new Fl_Shared_Image(name, this);
+  if (w() && h() && sharename) {
+    Fl_Shared_Image *si = new Fl_Shared_Image(sharename, this);
     si->add();
   }
 #endif // HAVE_LIBJPEG
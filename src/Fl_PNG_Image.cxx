@@ -53,6 +53,8 @@ typedef struct  {
   png_structp pp;
   const unsigned char *current;
   const unsigned char *last;
+  unsigned char *buffer;        // when writing
+  size_t size;
 } fl_png_memory;
 
 extern "C" {
@@ -70,7 +72,66 @@ extern "C" {
     /* advance in the memory data */
     png_mem_data->current += length;
   }
+
+  static void png_write_data_to_mem(png_structp png_ptr, png_bytep data, png_size_t length)
+  {
+    fl_png_memory *mem = (fl_png_memory*)png_get_io_ptr(png_ptr);
+    size_t used = mem->current - (const unsigned char*)mem->buffer;
+    if (used + length > mem->size) {
+      size_t size = 2 * mem->size + length;
+      unsigned char *buffer = (unsigned char*)realloc(mem->buffer, size);
+      if (!buffer) {
+        png_error(mem->pp, "Out of memory");
+        return;
+      }
+      mem->buffer = buffer;
+      mem->size = size;
+      mem->current = buffer + used;
+    }
+    memcpy(mem->buffer + used, data, length);
+    mem->current += length;
+  }
+
+  static void png_flush_mem(png_structp) {}
 } // extern "C"
+
+/*
+ Encodes w x h 24-bit pixels, in RGB order or BGR order if \p bgr is
+ non-zero, in PNG format in memory. Lines are \p ld bytes apart, which is
+ negative for bottom-up images. Favors speed over size, as wanted for
+ clipboard data. Returns a buffer to be released with free() and sets
+ \p size to its length, or returns NULL.
+ */
+uchar *fl_png_encode(const uchar *pixels, int w, int h, int ld, int bgr, int *size)
+{
+  // static for the same reason as the file pointer of load_png_()
+  static fl_png_memory mem;
+  mem.size = (size_t)w * h + 1024;
+  mem.buffer = (unsigned char*)malloc(mem.size);
+  if (!mem.buffer) return NULL;
+  mem.current = mem.buffer;
+  png_structp pp = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = pp ? png_create_info_struct(pp) : NULL;
+  mem.pp = pp;
+  if (!info || setjmp(png_jmpbuf(pp))) {
+    png_destroy_write_struct(&pp, &info);
+    free(mem.buffer);
+    return NULL;
+  }
+  png_set_write_fn(pp, &mem, png_write_data_to_mem, png_flush_mem);
+  png_set_compression_level(pp, Z_BEST_SPEED);
+  png_set_filter(pp, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+  png_set_IHDR(pp, info, w, h, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(pp, info);
+  if (bgr) png_set_bgr(pp);
+  for (int y = 0; y < h; y++)
+    png_write_row(pp, (png_bytep)(pixels + (long)y * ld));
+  png_write_end(pp, info);
+  png_destroy_write_struct(&pp, &info);
+  *size = (int)(mem.current - mem.buffer);
+  return mem.buffer;
+}
 #endif // HAVE_LIBPNG && HAVE_LIBZ
 
 
@@ -119,14 +180,15 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
   int channels;		// Number of color channels
   png_structp pp;	// PNG read pointer
   png_infop info = 0;	// PNG info pointers
-  png_bytep *rows;	// PNG row pointers
   fl_png_memory png_mem_data;
   int from_memory = (buffer_png != NULL); // true if reading image from memory
 
-  // Note: The file pointer fp must not be an automatic (stack) variable
-  // to avoid potential clobbering by setjmp/longjmp (gcc: [-Wclobbered]).
-  static FILE *fp;	// intentionally initialized separately below
-  fp = NULL;		// always initialize file pointer
+  // Note: the file pointer and the row pointers are used after a longjmp(),
+  // so they are volatile, so that setjmp() can't clobber them
+  // (gcc: [-Wclobbered]). They must not be static: images are loaded by
+  // several threads at once with Fl_Shared_Image::get_async().
+  FILE * volatile fp = NULL;		// File pointer
+  png_bytep * volatile rows = NULL;	// PNG row pointers
 
   if (!from_memory) {
     if ((fp = fl_fopen(name_png, "rb")) == NULL) {
@@ -149,6 +211,7 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
 
   if (setjmp(png_jmpbuf(pp))) {
     png_destroy_read_struct(&pp, &info, NULL);
+    delete[] rows;
     if (!from_memory) fclose(fp);
     Fl::warning("PNG file or data \"%s\" is too large or contains errors!\n", display_name);
     w(0); h(0); d(0); ld(ERR_FORMAT);
@@ -217,6 +280,7 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
 
   // Free memory and return...
   delete[] rows;
+  rows = NULL;
 
   png_read_end(pp, info);
   png_destroy_read_struct(&pp, &info, NULL);
@@ -0,0 +1,579 @@
+//
+// "$Id$"
+//
+// Profiling graphics driver for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Profiling_Graphics_Driver.H"
+#include <FL/Fl_Draw_Profiler.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_RGB_Image.H>
+
+// Times one call of the wrapped driver, from its creation to the end of the
+// scope, so that functions can simply return what the wrapped driver returns.
+class Fl_Profiling_Graphics_Driver::Call {
+  Fl_Draw_Profiler_Kind kind_;
+  unsigned long bytes_;
+  double t0_;
+public:
+  Call(Fl_Draw_Profiler_Kind kind, unsigned long bytes = 0) : kind_(kind), bytes_(bytes) {
+    t0_ = Fl_Stats::now();
+  }
+  ~Call() {
+    Fl_Draw_Profiler::record(kind_, Fl_Stats::now() - t0_, bytes_);
+  }
+};
+
+// bytes of W x H pixels of depth D, which is negative for images drawn upwards
+static unsigned long image_bytes(int W, int H, int D) {
+  if (W <= 0 || H <= 0) return 0;
+  return (unsigned long)W * H * (D < 0 ? -D : D);
+}
+
+
+Fl_Profiling_Graphics_Driver::Fl_Profiling_Graphics_Driver(Fl_Graphics_Driver *wrapped) {
+  wrapped_ = wrapped;
+  sync();
+}
+
+/** Copies the state that is read without virtual calls from the wrapped driver. */
+void Fl_Profiling_Graphics_Driver::sync() {
+  if (Fl_Graphics_Driver::scale() != wrapped_->scale()) Fl_Graphics_Driver::scale(wrapped_->scale());
+  font_descriptor_ = wrapped_->font_descriptor();
+  font_ = wrapped_->font_;
+  size_ = wrapped_->size_;
+  color_ = wrapped_->color_;
+  fl_clip_state_number = wrapped_->fl_clip_state_number;
+}
+
+void Fl_Profiling_Graphics_Driver::draw_fixed(Fl_Pixmap *pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  wrapped_->draw_fixed(pxm, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_fixed(Fl_Bitmap *bm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  wrapped_->draw_fixed(bm, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_fixed(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
+  wrapped_->draw_fixed(rgb, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::make_unused_color_(unsigned char &r, unsigned char &g, unsigned char &b) {
+  wrapped_->make_unused_color_(r, g, b);
+}
+
+void Fl_Profiling_Graphics_Driver::set_current_() {
+  wrapped_->set_current_();
+  sync();
+}
+
+void Fl_Profiling_Graphics_Driver::scale(float f) {
+  wrapped_->scale(f);
+  Fl_Graphics_Driver::scale(f);
+}
+
+void Fl_Profiling_Graphics_Driver::global_gc() {
+  wrapped_->global_gc();
+}
+
+void Fl_Profiling_Graphics_Driver::cache(Fl_Pixmap *img) {
+  wrapped_->cache(img);
+}
+
+void Fl_Profiling_Graphics_Driver::cache(Fl_Bitmap *img) {
+  wrapped_->cache(img);
+}
+
+void Fl_Profiling_Graphics_Driver::cache(Fl_RGB_Image *img) {
+  wrapped_->cache(img);
+}
+
+void Fl_Profiling_Graphics_Driver::uncache(Fl_RGB_Image *img, fl_uintptr_t &id_, fl_uintptr_t &mask_) {
+  wrapped_->uncache(img, id_, mask_);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_image(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(W, H, D));
+  wrapped_->draw_image(buf, X, Y, W, H, D, L);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_image_mono(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(W, H, 1));
+  wrapped_->draw_image_mono(buf, X, Y, W, H, D, L);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_image(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(W, H, D));
+  wrapped_->draw_image(cb, data, X, Y, W, H, D);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_image_mono(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(W, H, 1));
+  wrapped_->draw_image_mono(cb, data, X, Y, W, H, D);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(WP, HP, rgb->d()));
+  wrapped_->draw_rgb(rgb, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_pixmap(Fl_Pixmap *pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(WP, HP, 4));
+  wrapped_->draw_pixmap(pxm, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::draw_bitmap(Fl_Bitmap *bm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  Call p(FL_PROFILE_IMAGE, image_bytes((WP + 7) / 8, HP, 1));
+  wrapped_->draw_bitmap(bm, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Profiling_Graphics_Driver::copy_offscreen(int x, int y, int w, int h, Fl_Offscreen pixmap, int srcx, int srcy) {
+  Call p(FL_PROFILE_IMAGE, image_bytes(w, h, 4));
+  wrapped_->copy_offscreen(x, y, w, h, pixmap, srcx, srcy);
+}
+
+Fl_Bitmask Fl_Profiling_Graphics_Driver::create_bitmask(int w, int h, const uchar *array) {
+  return wrapped_->create_bitmask(w, h, array);
+}
+
+void Fl_Profiling_Graphics_Driver::delete_bitmask(Fl_Bitmask bm) {
+  wrapped_->delete_bitmask(bm);
+}
+
+void Fl_Profiling_Graphics_Driver::uncache_pixmap(fl_uintptr_t p) {
+  wrapped_->uncache_pixmap(p);
+}
+
+char Fl_Profiling_Graphics_Driver::can_do_alpha_blending() {
+  return wrapped_->can_do_alpha_blending();
+}
+
+void Fl_Profiling_Graphics_Driver::point(int x, int y) {
+  Call p(FL_PROFILE_POINT);
+  wrapped_->point(x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::rect(int x, int y, int w, int h) {
+  Call p(FL_PROFILE_RECT);
+  wrapped_->rect(x, y, w, h);
+}
+
+void Fl_Profiling_Graphics_Driver::focus_rect(int x, int y, int w, int h) {
+  Call p(FL_PROFILE_RECT);
+  wrapped_->focus_rect(x, y, w, h);
+}
+
+void Fl_Profiling_Graphics_Driver::rectf(int x, int y, int w, int h) {
+  Call p(FL_PROFILE_RECT);
+  wrapped_->rectf(x, y, w, h);
+}
+
+void Fl_Profiling_Graphics_Driver::line(int x, int y, int x1, int y1) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->line(x, y, x1, y1);
+}
+
+void Fl_Profiling_Graphics_Driver::line(int x, int y, int x1, int y1, int x2, int y2) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->line(x, y, x1, y1, x2, y2);
+}
+
+void Fl_Profiling_Graphics_Driver::xyline(int x, int y, int x1) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->xyline(x, y, x1);
+}
+
+void Fl_Profiling_Graphics_Driver::xyline(int x, int y, int x1, int y2) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->xyline(x, y, x1, y2);
+}
+
+void Fl_Profiling_Graphics_Driver::xyline(int x, int y, int x1, int y2, int x3) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->xyline(x, y, x1, y2, x3);
+}
+
+void Fl_Profiling_Graphics_Driver::yxline(int x, int y, int y1) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->yxline(x, y, y1);
+}
+
+void Fl_Profiling_Graphics_Driver::yxline(int x, int y, int y1, int x2) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->yxline(x, y, y1, x2);
+}
+
+void Fl_Profiling_Graphics_Driver::yxline(int x, int y, int y1, int x2, int y3) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->yxline(x, y, y1, x2, y3);
+}
+
+void Fl_Profiling_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->loop(x0, y0, x1, y1, x2, y2);
+}
+
+void Fl_Profiling_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->loop(x0, y0, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Profiling_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2) {
+  Call p(FL_PROFILE_POLYGON);
+  wrapped_->polygon(x0, y0, x1, y1, x2, y2);
+}
+
+void Fl_Profiling_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
+  Call p(FL_PROFILE_POLYGON);
+  wrapped_->polygon(x0, y0, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Profiling_Graphics_Driver::push_clip(int x, int y, int w, int h) {
+  Call p(FL_PROFILE_CLIP);
+  wrapped_->push_clip(x, y, w, h);
+}
+
+int Fl_Profiling_Graphics_Driver::clip_box(int x, int y, int w, int h, int &X, int &Y, int &W, int &H) {
+  return wrapped_->clip_box(x, y, w, h, X, Y, W, H);
+}
+
+int Fl_Profiling_Graphics_Driver::not_clipped(int x, int y, int w, int h) {
+  return wrapped_->not_clipped(x, y, w, h);
+}
+
+void Fl_Profiling_Graphics_Driver::push_no_clip() {
+  Call p(FL_PROFILE_CLIP);
+  wrapped_->push_no_clip();
+}
+
+void Fl_Profiling_Graphics_Driver::pop_clip() {
+  Call p(FL_PROFILE_CLIP);
+  wrapped_->pop_clip();
+}
+
+Fl_Region Fl_Profiling_Graphics_Driver::clip_region() {
+  return wrapped_->clip_region();
+}
+
+void Fl_Profiling_Graphics_Driver::clip_region(Fl_Region r) {
+  {
+    Call p(FL_PROFILE_CLIP);
+    wrapped_->clip_region(r);
+  }
+  // windows set their clip when they become current, and may change the scale
+  sync();
+}
+
+void Fl_Profiling_Graphics_Driver::restore_clip() {
+  Call p(FL_PROFILE_CLIP);
+  wrapped_->restore_clip();
+}
+
+void Fl_Profiling_Graphics_Driver::push_matrix() {
+  wrapped_->push_matrix();
+}
+
+void Fl_Profiling_Graphics_Driver::pop_matrix() {
+  wrapped_->pop_matrix();
+}
+
+void Fl_Profiling_Graphics_Driver::mult_matrix(double a, double b, double c, double d, double x, double y) {
+  wrapped_->mult_matrix(a, b, c, d, x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::rotate(double d) {
+  wrapped_->rotate(d);
+}
+
+void Fl_Profiling_Graphics_Driver::translate(double x, double y) {
+  wrapped_->translate(x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::begin_points() {
+  wrapped_->begin_points();
+}
+
+void Fl_Profiling_Graphics_Driver::begin_line() {
+  wrapped_->begin_line();
+}
+
+void Fl_Profiling_Graphics_Driver::begin_loop() {
+  wrapped_->begin_loop();
+}
+
+void Fl_Profiling_Graphics_Driver::begin_polygon() {
+  wrapped_->begin_polygon();
+}
+
+void Fl_Profiling_Graphics_Driver::begin_complex_polygon() {
+  wrapped_->begin_complex_polygon();
+}
+
+double Fl_Profiling_Graphics_Driver::transform_x(double x, double y) {
+  return wrapped_->transform_x(x, y);
+}
+
+double Fl_Profiling_Graphics_Driver::transform_y(double x, double y) {
+  return wrapped_->transform_y(x, y);
+}
+
+double Fl_Profiling_Graphics_Driver::transform_dx(double x, double y) {
+  return wrapped_->transform_dx(x, y);
+}
+
+double Fl_Profiling_Graphics_Driver::transform_dy(double x, double y) {
+  return wrapped_->transform_dy(x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::transformed_vertex(double xf, double yf) {
+  wrapped_->transformed_vertex(xf, yf);
+}
+
+void Fl_Profiling_Graphics_Driver::vertex(double x, double y) {
+  wrapped_->vertex(x, y);
+}
+
+// Paths are counted once, when they are drawn by their end function.
+
+void Fl_Profiling_Graphics_Driver::end_points() {
+  Call p(FL_PROFILE_POINT);
+  wrapped_->end_points();
+}
+
+void Fl_Profiling_Graphics_Driver::end_line() {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->end_line();
+}
+
+void Fl_Profiling_Graphics_Driver::end_loop() {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->end_loop();
+}
+
+void Fl_Profiling_Graphics_Driver::end_polygon() {
+  Call p(FL_PROFILE_POLYGON);
+  wrapped_->end_polygon();
+}
+
+void Fl_Profiling_Graphics_Driver::end_complex_polygon() {
+  Call p(FL_PROFILE_POLYGON);
+  wrapped_->end_complex_polygon();
+}
+
+void Fl_Profiling_Graphics_Driver::gap() {
+  wrapped_->gap();
+}
+
+void Fl_Profiling_Graphics_Driver::circle(double x, double y, double r) {
+  Call p(FL_PROFILE_ARC);
+  wrapped_->circle(x, y, r);
+}
+
+void Fl_Profiling_Graphics_Driver::arc(double x, double y, double r, double start, double end) {
+  wrapped_->arc(x, y, r, start, end);
+}
+
+void Fl_Profiling_Graphics_Driver::arc(int x, int y, int w, int h, double a1, double a2) {
+  Call p(FL_PROFILE_ARC);
+  wrapped_->arc(x, y, w, h, a1, a2);
+}
+
+void Fl_Profiling_Graphics_Driver::pie(int x, int y, int w, int h, double a1, double a2) {
+  Call p(FL_PROFILE_ARC);
+  wrapped_->pie(x, y, w, h, a1, a2);
+}
+
+void Fl_Profiling_Graphics_Driver::curve(double X0, double Y0, double X1, double Y1,
+                                         double X2, double Y2, double X3, double Y3) {
+  wrapped_->curve(X0, Y0, X1, Y1, X2, Y2, X3, Y3);
+}
+
+void Fl_Profiling_Graphics_Driver::line_style(int style, int width, char* dashes) {
+  Call p(FL_PROFILE_STATE);
+  wrapped_->line_style(style, width, dashes);
+}
+
+void Fl_Profiling_Graphics_Driver::color(Fl_Color c) {
+  Call p(FL_PROFILE_STATE);
+  wrapped_->color(c);
+  color_ = c;
+}
+
+void Fl_Profiling_Graphics_Driver::set_color(Fl_Color i, unsigned int c) {
+  wrapped_->set_color(i, c);
+}
+
+void Fl_Profiling_Graphics_Driver::free_color(Fl_Color i, int overlay) {
+  wrapped_->free_color(i, overlay);
+}
+
+Fl_Color Fl_Profiling_Graphics_Driver::color() {
+  return wrapped_->color();
+}
+
+void Fl_Profiling_Graphics_Driver::color(uchar r, uchar g, uchar b) {
+  Call p(FL_PROFILE_STATE);
+  wrapped_->color(r, g, b);
+  color_ = wrapped_->color_;
+}
+
+void Fl_Profiling_Graphics_Driver::draw(const char *str, int n, int x, int y) {
+  Call p(FL_PROFILE_TEXT);
+  wrapped_->draw(str, n, x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::draw(const char *str, int n, float x, float y) {
+  Call p(FL_PROFILE_TEXT);
+  wrapped_->draw(str, n, x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::draw(int angle, const char *str, int n, int x, int y) {
+  Call p(FL_PROFILE_TEXT);
+  wrapped_->draw(angle, str, n, x, y);
+}
+
+void Fl_Profiling_Graphics_Driver::rtl_draw(const char *str, int n, int x, int y) {
+  Call p(FL_PROFILE_TEXT);
+  wrapped_->rtl_draw(str, n, x, y);
+}
+
+int Fl_Profiling_Graphics_Driver::has_feature(driver_feature feature) {
+  return wrapped_->has_feature(feature);
+}
+
+void Fl_Profiling_Graphics_Driver::font(Fl_Font face, Fl_Fontsize fsize) {
+  {
+    Call p(FL_PROFILE_STATE);
+    wrapped_->font(face, fsize);
+  }
+  font_ = wrapped_->font_;
+  size_ = wrapped_->size_;
+  font_descriptor_ = wrapped_->font_descriptor();
+}
+
+Fl_Font Fl_Profiling_Graphics_Driver::font() {
+  return wrapped_->font();
+}
+
+Fl_Fontsize Fl_Profiling_Graphics_Driver::size() {
+  return wrapped_->size();
+}
+
+double Fl_Profiling_Graphics_Driver::width(const char *str, int n) {
+  Call p(FL_PROFILE_METRICS);
+  return wrapped_->width(str, n);
+}
+
+double Fl_Profiling_Graphics_Driver::width(unsigned int c) {
+  Call p(FL_PROFILE_METRICS);
+  return wrapped_->width(c);
+}
+
+void Fl_Profiling_Graphics_Driver::text_extents(const char *str, int n, int &dx, int &dy, int &w, int &h) {
+  Call p(FL_PROFILE_METRICS);
+  wrapped_->text_extents(str, n, dx, dy, w, h);
+}
+
+int Fl_Profiling_Graphics_Driver::height() {
+  Call p(FL_PROFILE_METRICS);
+  return wrapped_->height();
+}
+
+int Fl_Profiling_Graphics_Driver::descent() {
+  Call p(FL_PROFILE_METRICS);
+  return wrapped_->descent();
+}
+
+void Fl_Profiling_Graphics_Driver::font_descriptor(Fl_Font_Descriptor *d) {
+  wrapped_->font_descriptor(d);
+  font_descriptor_ = d;
+}
+
+void Fl_Profiling_Graphics_Driver::gc(void *ctxt) {
+  wrapped_->gc(ctxt);
+}
+
+void *Fl_Profiling_Graphics_Driver::gc() {
+  return wrapped_->gc();
+}
+
+uchar **Fl_Profiling_Graphics_Driver::mask_bitmap() {
+  return wrapped_->mask_bitmap();
+}
+
+float Fl_Profiling_Graphics_Driver::scale_font_for_PostScript(Fl_Font_Descriptor *desc, int s) {
+  return wrapped_->scale_font_for_PostScript(desc, s);
+}
+
+float Fl_Profiling_Graphics_Driver::scale_bitmap_for_PostScript() {
+  return wrapped_->scale_bitmap_for_PostScript();
+}
+
+void Fl_Profiling_Graphics_Driver::set_spot(int font, int size, int X, int Y, int W, int H, Fl_Window *win) {
+  wrapped_->set_spot(font, size, X, Y, W, H, win);
+}
+
+void Fl_Profiling_Graphics_Driver::reset_spot() {
+  wrapped_->reset_spot();
+}
+
+void Fl_Profiling_Graphics_Driver::add_rectangle_to_region(Fl_Region r, int x, int y, int w, int h) {
+  wrapped_->add_rectangle_to_region(r, x, y, w, h);
+}
+
+Fl_Region Fl_Profiling_Graphics_Driver::XRectangleRegion(int x, int y, int w, int h) {
+  return wrapped_->XRectangleRegion(x, y, w, h);
+}
+
+void Fl_Profiling_Graphics_Driver::XDestroyRegion(Fl_Region r) {
+  wrapped_->XDestroyRegion(r);
+}
+
+const char *Fl_Profiling_Graphics_Driver::get_font_name(Fl_Font fnum, int* ap) {
+  return wrapped_->get_font_name(fnum, ap);
+}
+
+int Fl_Profiling_Graphics_Driver::get_font_sizes(Fl_Font fnum, int*& sizep) {
+  return wrapped_->get_font_sizes(fnum, sizep);
+}
+
+Fl_Font Fl_Profiling_Graphics_Driver::set_fonts(const char *name) {
+  return wrapped_->set_fonts(name);
+}
+
+Fl_Fontdesc *Fl_Profiling_Graphics_Driver::calc_fl_fonts() {
+  return wrapped_->calc_fl_fonts();
+}
+
+unsigned Fl_Profiling_Graphics_Driver::font_desc_size() {
+  return wrapped_->font_desc_size();
+}
+
+const char *Fl_Profiling_Graphics_Driver::font_name(int num) {
+  return wrapped_->font_name(num);
+}
+
+void Fl_Profiling_Graphics_Driver::font_name(int num, const char *name) {
+  wrapped_->font_name(num, name);
+}
+
+void Fl_Profiling_Graphics_Driver::overlay_rect(int x, int y, int w, int h) {
+  Call p(FL_PROFILE_LINE);
+  wrapped_->overlay_rect(x, y, w, h);
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,89 @@
+//
+// "$Id$"
+//
+// Recording surface for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl_Recording_Surface.H>
+#include "Fl_Display_List.H"
+
+
+/** Constructor.
+ \param w, h The size of the recorded drawing, in FLTK units, which
+ printable_rect() returns. Drawing outside of it is recorded too.
+ */
+Fl_Recording_Surface::Fl_Recording_Surface(int w, int h) : Fl_Widget_Surface(NULL) {
+  width_ = w;
+  height_ = h;
+  list_ = new Fl_Display_List();
+  driver(new Fl_Display_List_Driver(list_, Fl_Display_Device::display_device()->driver()));
+}
+
+
+/** The destructor. */
+Fl_Recording_Surface::~Fl_Recording_Surface() {
+  delete driver();
+  delete list_;
+}
+
+
+void Fl_Recording_Surface::translate(int x, int y) {
+  ((Fl_Display_List_Driver*)driver())->translate_all(x, y);
+}
+
+
+void Fl_Recording_Surface::untranslate() {
+  ((Fl_Display_List_Driver*)driver())->untranslate_all();
+}
+
+
+int Fl_Recording_Surface::printable_rect(int *w, int *h) {
+  *w = width_;
+  *h = height_;
+  return 0;
+}
+
+
+/**
+ Draws the recording on the current drawing surface, with its origin at
+ \p x, \p y. The surface must not be this one.
+ */
+void Fl_Recording_Surface::replay(int x, int y) {
+  Fl_Graphics_Driver *d = Fl_Surface_Device::surface()->driver();
+  if (d != driver()) list_->replay(d, x, y);
+}
+
+
+/** Forgets the recorded drawing, so that the surface records a new one. */
+void Fl_Recording_Surface::clear() {
+  list_->clear();
+}
+
+
+/** Returns the number of recorded graphics requests. */
+int Fl_Recording_Surface::calls() {
+  return list_->calls();
+}
+
+
+/** Returns the number of bytes of the recorded requests, with the copies of their images. */
+size_t Fl_Recording_Surface::size() {
+  return list_->size() + list_->image_bytes();
+}
+
+
+//
+// End of "$Id$".
+//
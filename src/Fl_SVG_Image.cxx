@@ -175,7 +175,8 @@ void Fl_SVG_Image::init_(const char *filename, const char *in_filedata, Fl_SVG_I
 
 
 void Fl_SVG_Image::rasterize_(int W, int H) {
-  static NSVGrasterizer *rasterizer = nsvgCreateRasterizer();
+  // a rasterizer per call, as images may be loaded by several threads
+  NSVGrasterizer *rasterizer = nsvgCreateRasterizer();
   double fx, fy;
   if (proportional) {
     fx = svg_scaling_(W, H);
@@ -186,6 +187,7 @@ void Fl_SVG_Image::rasterize_(int W, int H) {
   }
   array = new uchar[W*H*4];
   nsvgRasterizeXY(rasterizer, counted_svg_image_->svg_image, 0, 0, fx, fy, (uchar* )array, W, H, W*4);
+  nsvgDeleteRasterizer(rasterizer);
   alloc_array = 1;
   data((const char * const *)&array, 1);
   d(4);
@@ -39,6 +39,19 @@ int	Fl_Shared_Image::alloc_images_ = 0;	// Allocated shared images
 Fl_Shared_Handler *Fl_Shared_Image::handlers_ = 0;// Additional format handlers
 int	Fl_Shared_Image::num_handlers_ = 0;	// Number of format handlers
 int	Fl_Shared_Image::alloc_handlers_ = 0;	// Allocated format handlers
+Fl_Shared_Sized_Handler *Fl_Shared_Image::sized_handlers_ = 0;// Handlers that can reduce images
+int	Fl_Shared_Image::num_sized_handlers_ = 0;	// Number of sized handlers
+int	Fl_Shared_Image::alloc_sized_handlers_ = 0;	// Allocated sized handlers
+
+Fl_Shared_Image **Fl_Shared_Image::hash_ = 0;	// Hash index of the images
+int	Fl_Shared_Image::hash_size_ = 0;	// Number of hash buckets
+Fl_Shared_Image *Fl_Shared_Image::lru_first_ = 0;// Least recently released image
+Fl_Shared_Image *Fl_Shared_Image::lru_last_ = 0;// Most recently released image
+size_t	Fl_Shared_Image::cache_size_ = 0;	// No released image is kept
+size_t	Fl_Shared_Image::cache_bytes_ = 0;	// Estimated size of the images
+unsigned long Fl_Shared_Image::hits_ = 0;
+unsigned long Fl_Shared_Image::misses_ = 0;
+unsigned long Fl_Shared_Image::evictions_ = 0;
 
 
 //
@@ -50,6 +63,27 @@ extern "C" {
 }
 
 
+// FNV-1a hash of an image name
+static unsigned name_hash(const char *name) {
+  unsigned h = 2166136261U;
+  for (const uchar *p = (const uchar *)name; *p; p ++) {
+    h ^= *p;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+
+// Estimates the memory used by the data of an image
+static size_t image_bytes(Fl_Image *img) {
+  if (!img || img->data_w() <= 0 || img->data_h() <= 0) return 0;
+  size_t pixels = (size_t)img->data_w() * img->data_h();
+  if (img->d() > 0) return pixels * img->d();
+  if (img->d() == 0) return (size_t)((img->data_w() + 7) / 8) * img->data_h(); // bitmap
+  return pixels * 4; // pixmap, as drawn
+}
+
+
 /** Returns the Fl_Shared_Image* array */
 Fl_Shared_Image **Fl_Shared_Image::images() {
   return images_;
@@ -78,9 +112,8 @@ int Fl_Shared_Image::num_images() {
   An image is marked \p original if it was directly loaded from a file or
   from memory as opposed to copied and resized images.
 
-  This comparison is used in Fl_Shared_Image::find() to find an image that
-  matches the requested one or to find the position where a new image
-  should be entered into the sorted list of shared images.
+  Fl_Shared_Image::find() and Fl_Shared_Image::get() find the images of the
+  cache that match the requested one with the same rules.
 
   It is usually used in two steps:
 
@@ -123,6 +156,11 @@ Fl_Shared_Image::Fl_Shared_Image() : Fl_Image(0,0,0) {
   original_    = 0;
   image_       = 0;
   alloc_image_ = 0;
+  hash_next_   = 0;
+  lru_prev_    = 0;
+  lru_next_    = 0;
+  bytes_       = 0;
+  loader_      = 0;
 }
 
 
@@ -143,6 +181,11 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
   image_       = img;
   alloc_image_ = !img;
   original_    = 1;
+  hash_next_   = 0;
+  lru_prev_    = 0;
+  lru_next_    = 0;
+  bytes_       = 0;
+  loader_      = 0;
 
   if (!img) reload();
   else update();
@@ -152,18 +195,20 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
 /**
   Adds a shared image to the image cache.
 
-  This \b protected method adds an image to the cache, an ordered list
-  of shared images. The cache is searched for a matching image whenever
-  one is requested, for instance with Fl_Shared_Image::get() or
+  This \b protected method adds an image to the cache, a list of shared
+  images indexed by name. The cache is searched for a matching image
+  whenever one is requested, for instance with Fl_Shared_Image::get() or
   Fl_Shared_Image::find().
 */
 void
 Fl_Shared_Image::add() {
   Fl_Shared_Image	**temp;		// New image pointer array...
+  int			i;		// Looping var...
 
   if (num_images_ >= alloc_images_) {
     // Allocate more memory...
-    temp = new Fl_Shared_Image *[alloc_images_ + 32];
+    int n = alloc_images_ ? 2 * alloc_images_ : 32;
+    temp = new Fl_Shared_Image *[n];
 
     if (alloc_images_) {
       memcpy(temp, images_, alloc_images_ * sizeof(Fl_Shared_Image *));
@@ -172,15 +217,130 @@ Fl_Shared_Image::add() {
     }
 
     images_       = temp;
-    alloc_images_ += 32;
+    alloc_images_ = n;
   }
 
   images_[num_images_] = this;
   num_images_ ++;
 
-  if (num_images_ > 1) {
-    qsort(images_, num_images_, sizeof(Fl_Shared_Image *),
-          (compare_func_t)compare);
+  if (num_images_ > hash_size_) {
+    // Grow the index, and put all images back in it...
+    delete[] hash_;
+    hash_size_ = hash_size_ ? 2 * hash_size_ : 64;
+    hash_      = new Fl_Shared_Image *[hash_size_];
+    memset(hash_, 0, hash_size_ * sizeof(Fl_Shared_Image *));
+
+    for (i = 0; i < num_images_ - 1; i ++) {
+      unsigned b = name_hash(images_[i]->name_) & (hash_size_ - 1);
+      images_[i]->hash_next_ = hash_[b];
+      hash_[b] = images_[i];
+    }
+  }
+
+  unsigned b = name_hash(name_) & (hash_size_ - 1);
+  hash_next_ = hash_[b];
+  hash_[b]   = this;
+
+  bytes_ = image_bytes(image_ ? image_ : this);
+  cache_bytes_ += bytes_;
+  trim();
+}
+
+
+// Removes this image from the cache, if it is there.
+void
+Fl_Shared_Image::remove() {
+  int	i;	// Looping var...
+
+  for (i = 0; i < num_images_; i ++)
+    if (images_[i] == this) {
+      num_images_ --;
+
+      if (i < num_images_) {
+        memmove(images_ + i, images_ + i + 1,
+               (num_images_ - i) * sizeof(Fl_Shared_Image *));
+      }
+
+      break;
+    }
+
+  if (hash_size_ && name_) {
+    Fl_Shared_Image **p = hash_ + (name_hash(name_) & (hash_size_ - 1));
+
+    while (*p && *p != this) p = &(*p)->hash_next_;
+
+    if (*p) {
+      *p = hash_next_;
+      cache_bytes_ -= bytes_;
+    }
+  }
+
+  hash_next_ = 0;
+
+  if (lru_prev_) lru_prev_->lru_next_ = lru_next_;
+  else if (lru_first_ == this) lru_first_ = lru_next_;
+  if (lru_next_) lru_next_->lru_prev_ = lru_prev_;
+  else if (lru_last_ == this) lru_last_ = lru_prev_;
+  lru_prev_ = lru_next_ = 0;
+
+  if (num_images_ == 0 && images_) {
+    delete[] images_;
+    delete[] hash_;
+
+    images_       = 0;
+    alloc_images_ = 0;
+    hash_         = 0;
+    hash_size_    = 0;
+  }
+}
+
+
+// Returns the cached image that matches name, W and H, see compare().
+// A loaded image is preferred to the placeholder of get_async(), which is
+// only returned if there is no other match.
+Fl_Shared_Image *
+Fl_Shared_Image::lookup(const char *name, int W, int H) {
+  if (!hash_size_) return 0;
+
+  Fl_Shared_Image *img = hash_[name_hash(name) & (hash_size_ - 1)];
+  Fl_Shared_Image *loading = 0;
+
+  for (; img; img = img->hash_next_) {
+    if (strcmp(img->name_, name)) continue;
+    if ((W == 0 && img->original_) || (img->w() == W && img->h() == H)) {
+      if (!img->loader_) return img;
+      if (!loading) loading = img;
+    }
+  }
+
+  return loading;
+}
+
+
+// Adds a reference to a cached image, which may have been released.
+void
+Fl_Shared_Image::use() {
+  if (refcount_ == 0) {
+    if (lru_prev_) lru_prev_->lru_next_ = lru_next_;
+    else lru_first_ = lru_next_;
+    if (lru_next_) lru_next_->lru_prev_ = lru_prev_;
+    else lru_last_ = lru_prev_;
+    lru_prev_ = lru_next_ = 0;
+  }
+
+  refcount_ ++;
+}
+
+
+// Deletes released images, least recently released first, until the
+// cache is within its budget.
+void
+Fl_Shared_Image::trim() {
+  while (lru_first_ && cache_bytes_ > cache_size_) {
+    Fl_Shared_Image *img = lru_first_;
+    img->remove();
+    delete img;
+    evictions_ ++;
   }
 }
 
@@ -215,69 +375,108 @@ Fl_Shared_Image::~Fl_Shared_Image() {
 /**
   Releases and possibly destroys (if refcount <= 0) a shared image.
 
-  In the latter case, it will reorganize the shared image array
-  so that no hole will occur.
+  If a memory budget is set with cache_size(), an image that is released
+  by all its users is kept in the cache, and deleted later if the cache
+  exceeds its budget.
 */
 void Fl_Shared_Image::release() {
-  int	i;	// Looping var...
-
   refcount_ --;
   if (refcount_ > 0) return;
 
-  for (i = 0; i < num_images_; i ++)
-    if (images_[i] == this) {
-      num_images_ --;
+  if (cache_size_ && refcount_ == 0 && hash_size_ && name_) {
+    Fl_Shared_Image *img = hash_[name_hash(name_) & (hash_size_ - 1)];
 
-      if (i < num_images_) {
-        memmove(images_ + i, images_ + i + 1,
-               (num_images_ - i) * sizeof(Fl_Shared_Image *));
-      }
+    while (img && img != this) img = img->hash_next_;
 
-      break;
+    if (img) {
+      // Keep the image as the most recently released one...
+      lru_prev_ = lru_last_;
+      lru_next_ = 0;
+      if (lru_last_) lru_last_->lru_next_ = this;
+      else lru_first_ = this;
+      lru_last_ = this;
+
+      trim();
+      return;
     }
+  }
 
+  remove();
   delete this;
+}
 
-  if (num_images_ == 0 && images_) {
-    delete[] images_;
 
-    images_       = 0;
-    alloc_images_ = 0;
-  }
+// Reads the start of an image file, to detect its format.
+static int read_header(const char *name, uchar *header, int headerlen) {
+  FILE		*fp;		// File pointer
+
+  if ((fp = fl_fopen(name, "rb")) == NULL) return 0;
+  if (fread(header, 1, headerlen, fp)==0) { /* ignore */ }
+  fclose(fp);
+  return 1;
 }
 
 
-/** Reloads the shared image from disk. */
-void Fl_Shared_Image::reload() {
-  // Load image from disk...
+// Loads an image file reduced to about W x H with a sized handler, or
+// returns NULL if no sized handler supports its format.
+Fl_Image *Fl_Shared_Image::load_sized_(const char *name, int W, int H) {
   int		i;		// Looping var
-  FILE		*fp;		// File pointer
   uchar		header[64];	// Buffer for auto-detecting files
   Fl_Image	*img;		// New image
 
-  if (!name_) return;
+  if (!num_sized_handlers_ || !read_header(name, header, sizeof(header)))
+    return 0;
 
-  if ((fp = fl_fopen(name_, "rb")) != NULL) {
-    if (fread(header, 1, sizeof(header), fp)==0) { /* ignore */ }
-    fclose(fp);
-  } else {
-    return;
+  for (i = 0, img = 0; i < num_sized_handlers_; i ++) {
+    img = (sized_handlers_[i])(name, header, sizeof(header), W, H);
+
+    if (img) break;
   }
 
+  return img;
+}
+
+
+// Loads an image file with the handler of its format. This only reads
+// the list of handlers, so that threads can load several files at once.
+// If W and H are not 0, the image may be reduced to about W x H.
+Fl_Image *Fl_Shared_Image::load_image_(const char *name, int W, int H) {
+  int		i;		// Looping var
+  uchar		header[64];	// Buffer for auto-detecting files
+  Fl_Image	*img;		// New image
+
+  if (W && H && (img = load_sized_(name, W, H)) != NULL) return img;
+
+  if (!read_header(name, header, sizeof(header))) return 0;
+
   // Load the image as appropriate...
   if (memcmp(header, "#define", 7) == 0) // XBM file
-    img = new Fl_XBM_Image(name_);
+    img = new Fl_XBM_Image(name);
   else if (memcmp(header, "/* XPM */", 9) == 0) // XPM file
-    img = new Fl_XPM_Image(name_);
+    img = new Fl_XPM_Image(name);
   else {
     // Not a standard format; try an image handler...
     for (i = 0, img = 0; i < num_handlers_; i ++) {
-      img = (handlers_[i])(name_, header, sizeof(header));
+      img = (handlers_[i])(name, header, sizeof(header));
 
       if (img) break;
     }
   }
 
+  return img;
+}
+
+
+/** Reloads the shared image from disk. */
+void Fl_Shared_Image::reload() {
+  // Load image from disk...
+  Fl_Image	*img;		// New image
+
+  if (!name_) return;
+
+  if (original_) img = load_image_(name_);
+  else img = load_image_(name_, w(), h());
+
   if (img) {
     if (alloc_image_) delete image_;
 
@@ -385,7 +584,7 @@ void Fl_Shared_Image::uncache()
 
 /** Finds a shared image from its name and size specifications.
 
-  This uses a binary search in the image cache.
+  This uses a hash index of the image cache.
 
   If the image \p name exists with the exact width \p W and height \p H,
   then it is returned.
@@ -398,29 +597,16 @@ void Fl_Shared_Image::uncache()
   when no longer needed.
 */
 Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
-  Fl_Shared_Image	*key,		// Image key
-			**match;	// Matching image
+  Fl_Shared_Image *match = lookup(name, W, H);
 
-  if (num_images_) {
-    key = new Fl_Shared_Image();
-    key->name_ = new char[strlen(name) + 1];
-    strcpy((char *)key->name_, name);
-    key->w(W);
-    key->h(H);
-
-    match = (Fl_Shared_Image **)bsearch(&key, images_, num_images_,
-                                        sizeof(Fl_Shared_Image *),
-                                        (compare_func_t)compare);
-
-    delete key;
-
-    if (match) {
-      (*match)->refcount_ ++;
-      return *match;
-    }
+  if (match) {
+    hits_ ++;
+    match->use();
+  } else {
+    misses_ ++;
   }
 
-  return 0;
+  return match;
 }
 
 
@@ -446,9 +632,18 @@ Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
 	If you request the same image with another size later, then the
 	\b original image will be found, copied, resized, and returned.
 
+  As an exception, if the image is not in the cache and a handler added
+  with add_handler(Fl_Shared_Sized_Handler) supports its format, the file
+  is loaded reduced, and only the resized image is added to the list.
+  With fl_register_images(), this is how JPEG files are loaded, at 1/2,
+  1/4 or 1/8 of their size, which is much faster for thumbnails.
+
   Shared JPEG and PNG images can also be created from memory by using their
   named memory access constructor.
 
+  If get_async() is loading the file, get() doesn't return its empty
+  placeholder: the file is loaded again, at once, as a separate image.
+
   You should release() the image when you're done with it.
 
   \param name name of the image
@@ -461,10 +656,39 @@ Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
 */
 Fl_Shared_Image* Fl_Shared_Image::get(const char *name, int W, int H) {
   Fl_Shared_Image	*temp;		// Image
+  Fl_Image		*img;		// Reduced image
 
-  if ((temp = find(name, W, H)) != NULL) return temp;
+  if ((temp = lookup(name, W, H)) != NULL && !temp->loader_) {
+    hits_ ++;
+    temp->use();
+    return temp;
+  }
+
+  // Placeholders of get_async() are skipped, and the file loaded now...
+  if ((temp = lookup(name, 0, 0)) != NULL && !temp->loader_) {
+    hits_ ++;
+    // The resized copy below doesn't keep a reference of the original
+    if (!W || !H) {
+      temp->use();
+      return temp;
+    }
+  } else if (W && H && (img = load_sized_(name, W, H)) != NULL) {
+    // The image was loaded reduced, so only cache the requested size...
+    misses_ ++;
 
-  if ((temp = find(name)) == NULL) {
+    if (img->w() && img->h() && (img->w() != W || img->h() != H)) {
+      Fl_Image *temp_image = img->copy(W, H);
+      delete img;
+      img = temp_image;
+    }
+
+    temp = new Fl_Shared_Image(name, img);
+    temp->alloc_image_ = 1;
+    temp->original_    = 0;
+    temp->add();
+    return temp;
+  } else {
+    misses_ ++;
     temp = new Fl_Shared_Image(name);
 
     if (!temp->image_) {
@@ -500,8 +724,484 @@ Fl_Shared_Image *Fl_Shared_Image::get(Fl_RGB_Image *rgb, int own_it)
 }
 
 
+/**
+  Sets the memory budget of the image cache, in bytes.
+
+  When the budget is not 0, images released by all their users stay in the
+  cache, so that get() and find() return them without loading them again.
+  They are deleted, least recently released first, when the estimated size
+  of all cached images exceeds \p bytes. Images in use are never deleted,
+  and count in the size of the cache.
+
+  The budget is 0 by default: released images are deleted at once, and
+  setting the budget to 0 deletes all released images.
+
+  \see cache_bytes(), cache_stats()
+  \version 1.4.0
+*/
+void Fl_Shared_Image::cache_size(size_t bytes) {
+  cache_size_ = bytes;
+  trim();
+}
+
+
+/**
+  Gets the statistics of the image cache.
+
+  \param[out] hits	number of images found by get() and find()
+  \param[out] misses	number of images not found, that get() loaded
+  \param[out] evictions	number of released images deleted to fit the budget
+
+  Any of the pointers may be NULL.
+  \version 1.4.0
+*/
+void Fl_Shared_Image::cache_stats(unsigned long *hits, unsigned long *misses,
+                                  unsigned long *evictions) {
+  if (hits) *hits = hits_;
+  if (misses) *misses = misses_;
+  if (evictions) *evictions = evictions_;
+}
+
+
+/** Sets the statistics of the image cache to 0. \version 1.4.0 */
+void Fl_Shared_Image::reset_cache_stats() {
+  hits_ = misses_ = evictions_ = 0;
+}
+
+
+//
+// Asynchronous loading: get_async() queues a job per placeholder image, the
+// workers load the files, and a timeout of the main thread, which runs
+// while jobs are pending, hands the images to the placeholders.
+//
+
+struct Async_Waiter {
+  Fl_Shared_Image_Callback cb;
+  void		*data;
+  Fl_Widget_Tracker *owner;	// The requesting widget, or NULL
+  Async_Waiter	*next;
+};
+
+struct Async_Message {
+  int		error;		// From Fl::error(), else Fl::warning()
+  char		*text;
+  Async_Message	*next;
+};
+
+struct Async_Job {
+  Fl_Shared_Image *image;	// The placeholder, with a reference of the job
+  char		*name;		// File name, for the worker
+  Fl_Image	*(*load)(const char *name, int W, int H);
+  int		W, H;		// Requested size, or 0
+  Fl_Image	*result;	// Loaded image, set by the worker
+  Async_Message	*messages;	// Messages of the loaders, set by the worker
+  Async_Waiter	*waiters;	// Only used by the main thread
+  Async_Job	*next;
+};
+
+#define ASYNC_POLL_DELAY (1.0 / 60)
+
+static Async_Job *pending_first = 0, *pending_last = 0; // Jobs to load, in order
+static Async_Job *done_first = 0;	// Loaded jobs, in any order
+static int	jobs_in_flight = 0;	// Jobs queued by get_async() and not delivered
+static int	max_threads = 0;	// Number of workers, 0 until the first job
+static int	started_threads = 0;
+static int	async_ready = 0;	// Non-zero once init_async() was called
+
+static void *async_worker(void *);
+
+#if defined(_WIN32)
+
+#  include <windows.h>
+#  include <process.h>
+
+static CRITICAL_SECTION async_lock;
+static HANDLE async_sem;
+static DWORD job_key;
+static void init_async() {
+  InitializeCriticalSection(&async_lock);
+  async_sem = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+  job_key = TlsAlloc();
+}
+static void lock_async() { EnterCriticalSection(&async_lock); }
+static void unlock_async() { LeaveCriticalSection(&async_lock); }
+static void signal_async() { ReleaseSemaphore(async_sem, 1, NULL); }
+// called with the lock, returns with the lock
+static void wait_async() {
+  unlock_async();
+  WaitForSingleObject(async_sem, INFINITE);
+  lock_async();
+}
+static Async_Job *current_job() { return (Async_Job *)TlsGetValue(job_key); }
+static void set_current_job(Async_Job *job) { TlsSetValue(job_key, job); }
+static void __cdecl async_worker_win(void *) { async_worker(0); }
+static int start_async_thread() { return _beginthread(async_worker_win, 0, 0) != (uintptr_t)-1; }
+static int cpu_count() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+}
+
+#elif defined(HAVE_PTHREAD)
+
+#  include <pthread.h>
+#  include <unistd.h>
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t job_key;
+static void init_async() { pthread_key_create(&job_key, NULL); }
+static void lock_async() { pthread_mutex_lock(&async_lock); }
+static void unlock_async() { pthread_mutex_unlock(&async_lock); }
+static void signal_async() { pthread_cond_signal(&async_cond); }
+static void wait_async() { pthread_cond_wait(&async_cond, &async_lock); }
+static Async_Job *current_job() { return (Async_Job *)pthread_getspecific(job_key); }
+static void set_current_job(Async_Job *job) { pthread_setspecific(job_key, job); }
+static int start_async_thread() {
+  pthread_t t;
+  if (pthread_create(&t, 0, async_worker, 0)) return 0;
+  pthread_detach(t);
+  return 1;
+}
+static int cpu_count() { return (int)sysconf(_SC_NPROCESSORS_ONLN); }
+
+#else // no thread support: files are loaded by get_async()
+
+#  define NO_ASYNC_THREADS 1
+static void init_async() {}
+static void lock_async() {}
+static void unlock_async() {}
+static void signal_async() {}
+static void wait_async() {}
+static Async_Job *current_job() { return 0; }
+static void set_current_job(Async_Job *) {}
+static int start_async_thread() { return 0; }
+static int cpu_count() { return 1; }
+
+#endif
+
+// While jobs are in flight, Fl::warning() and Fl::error() are replaced by
+// these functions: the messages of the image loaders, which run in the
+// workers, are kept in their jobs and shown by the main thread when the
+// jobs are delivered, and those of the main thread are passed on.
+static void (*app_warning)(const char *, ...);
+static void (*app_error)(const char *, ...);
+
+static void async_message(int error, const char *format, va_list ap) {
+  char text[1024];
+  vsnprintf(text, sizeof(text), format, ap);
+  Async_Job *job = current_job();
+  if (!job) {
+    if (error) app_error("%s", text);
+    else app_warning("%s", text);
+    return;
+  }
+  Async_Message *m = new Async_Message, **p;
+  m->error = error;
+  m->text  = strdup(text);
+  m->next  = 0;
+  for (p = &job->messages; *p; p = &(*p)->next) {}
+  *p = m;
+}
+
+static void async_warning(const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  async_message(0, format, ap);
+  va_end(ap);
+}
+
+static void async_error(const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  async_message(1, format, ap);
+  va_end(ap);
+}
+
+// Each worker loads the files of the pending jobs, one after the other.
+static void *async_worker(void *) {
+  lock_async();
+  for (;;) {
+    while (!pending_first) wait_async();
+    Async_Job *job = pending_first;
+    pending_first = job->next;
+    if (!pending_first) pending_last = 0;
+    unlock_async();
+    set_current_job(job);
+    Fl_Image *img = job->load(job->name, job->W, job->H);
+    set_current_job(0);
+    lock_async();
+    job->result = img;
+    job->next = done_first;
+    done_first = job;
+  }
+  return 0;
+}
+
+
+// Hands the loaded images to their placeholders, and calls the callbacks
+// of their requests. Runs in a timeout of the main thread while jobs are
+// in flight.
+void Fl_Shared_Image::deliver_async_(void *) {
+  Async_Job *done, *cancelled = 0, **p, *job;
+  Async_Waiter *w;
+  Async_Message *m;
+
+  lock_async();
+  done       = done_first;
+  done_first = 0;
+
+  // Drop the pending jobs that only deleted widgets are waiting for...
+  pending_last = 0;
+  for (p = &pending_first; (job = *p) != NULL; ) {
+    for (w = job->waiters; w && w->owner && w->owner->deleted(); w = w->next) {}
+    if (w) {
+      pending_last = job;
+      p = &job->next;
+    } else {
+      *p = job->next;
+      job->next = cancelled;
+      cancelled = job;
+    }
+  }
+  unlock_async();
+
+  for (int pass = 0; pass < 2; pass ++) {
+    while ((job = pass ? cancelled : done) != NULL) {
+      if (pass) cancelled = job->next;
+      else done = job->next;
+
+      Fl_Shared_Image *img = job->image;
+      Fl_Image *result = job->result;
+
+      while ((m = job->messages) != NULL) {
+        job->messages = m->next;
+        if (m->error) Fl::error("%s", m->text);
+        else Fl::warning("%s", m->text);
+        free(m->text);
+        delete m;
+      }
+
+      if (result && (result->w() <= 0 || result->h() <= 0)) {
+        delete result;
+        result = 0;
+      }
+
+      if (result) {
+        if (job->W && (result->w() != job->W || result->h() != job->H)) {
+          Fl_Image *temp = result->copy(job->W, job->H);
+          delete result;
+          result = temp;
+        }
+
+        img->image_       = result;
+        img->alloc_image_ = 1;
+        img->update();
+
+        size_t bytes = image_bytes(result);
+        cache_bytes_ += bytes;
+        cache_bytes_ -= img->bytes_;
+        img->bytes_ = bytes;
+      } else {
+        // Forget the placeholder, so that the file can be requested again;
+        // a cancelled file was not read, so it didn't fail...
+        if (!pass) img->ld(ERR_FILE_ACCESS);
+        img->remove();
+      }
+
+      img->loader_ = 0;
+
+      while ((w = job->waiters) != NULL) {
+        job->waiters = w->next;
+        if (!pass && w->cb && (!w->owner || !w->owner->deleted())) (w->cb)(img, w->data);
+        delete w->owner;
+        delete w;
+      }
+
+      jobs_in_flight --;
+      free(job->name);
+      delete job;
+      img->release();
+      trim();
+    }
+  }
+
+  if (jobs_in_flight) {
+    if (!Fl::has_timeout(deliver_async_))
+      Fl::repeat_timeout(ASYNC_POLL_DELAY, deliver_async_);
+  } else {
+    // No worker is loading a file, give the messages back...
+    if (Fl::warning == async_warning) Fl::warning = app_warning;
+    if (Fl::error == async_error) Fl::error = app_error;
+  }
+}
+
+
+/**
+  Gets an image that can be shared, and loads it with a thread if needed.
+
+  This is the same as get(const char *name, int W, int H), except that
+  the image file is loaded without blocking the caller. If the image is in
+  the cache, it is returned, and \p cb is not called. Otherwise, the
+  returned image is an empty placeholder, of size \p W x \p H if they are
+  not 0, that is put in the cache, and the file is loaded by a worker
+  thread. When it is loaded, the placeholder takes its contents, and
+  \p cb is called by the main thread with the placeholder and \p data,
+  typically to redraw the widgets that show it. If the file can't be
+  loaded, the placeholder stays empty, its fail() method returns
+  Fl_Image::ERR_FILE_ACCESS, and it is removed from the cache.
+
+  Requests of an image that is being loaded get the same placeholder,
+  and the file is loaded once. If \p owner is not NULL, \p cb is not
+  called once \p owner is deleted, and the file isn't loaded if the owners
+  of all requests are deleted before a thread starts loading it.
+
+  As with get(), the image should be released when it is no longer needed.
+  While a file is loaded, find() may return its placeholder; get() loads
+  the file again instead.
+
+  Callbacks are called by a timeout that runs while files are loaded, so
+  this doesn't need Fl::lock(). Image handlers must not be added or
+  removed while files are loaded. Without thread support, the file is
+  loaded by get_async() and \p cb is called by the timeout.
+
+  \note The image handlers, those of fl_register_images() and those added
+	with add_handler(), are called by the worker threads, several at
+	once: they must be thread-safe, without static or global state,
+	and must not call FLTK functions that need the main thread.
+	While files are loaded, Fl::warning() and Fl::error() keep the
+	messages of the worker threads, and the main thread passes them
+	to the previous handlers when their files are delivered.
+
+  \param name name of the image file
+  \param W, H desired size, or 0 for the size of the file
+  \param cb function called when the image is loaded, or NULL
+  \param data argument of \p cb
+  \param owner widget that requests the image, or NULL
+
+  \see async_threads(int)
+  \version 1.4.0
+*/
+Fl_Shared_Image *Fl_Shared_Image::get_async(const char *name, int W, int H,
+                                            Fl_Shared_Image_Callback cb,
+                                            void *data, Fl_Widget *owner) {
+  Fl_Shared_Image	*img;		// Image
+  Async_Job		*job;		// Load of the image
+
+  if (!W || !H) W = H = 0;
+
+  if ((img = lookup(name, W, H)) != NULL && !img->loader_) {
+    hits_ ++;
+    img->use();
+    return img;
+  }
+
+  if (!img && W && (img = lookup(name, 0, 0)) != NULL && !img->loader_) {
+    // Resize the cached original...
+    return get(name, W, H);
+  }
+
+  if (img) {
+    // The image is loading, wait for it too...
+    hits_ ++;
+    img->use();
+    job = (Async_Job *)img->loader_;
+  } else {
+    misses_ ++;
+    img = new Fl_Shared_Image();
+    img->name_ = new char[strlen(name) + 1];
+    strcpy((char *)img->name_, name);
+    img->original_ = !W;
+    if (W) {
+      img->w(W);
+      img->h(H);
+    }
+    img->add();
+    img->refcount_ ++; // the reference of the job
+
+    job           = new Async_Job;
+    job->image    = img;
+    job->name     = strdup(name);
+    job->load     = load_image_;
+    job->W        = W;
+    job->H        = H;
+    job->result   = 0;
+    job->messages = 0;
+    job->waiters  = 0;
+    job->next     = 0;
+    img->loader_  = job;
+    jobs_in_flight ++;
+
+#ifdef NO_ASYNC_THREADS
+    job->result = load_image_(name, W, H);
+    job->next   = done_first;
+    done_first  = job;
+#else
+    if (!max_threads) async_threads(0);
+    if (!async_ready) {
+      init_async();
+      async_ready = 1;
+    }
+    if (started_threads < max_threads && started_threads < jobs_in_flight &&
+        start_async_thread()) started_threads ++;
+
+    if (Fl::warning != async_warning) {
+      app_warning  = Fl::warning;
+      Fl::warning  = async_warning;
+    }
+    if (Fl::error != async_error) {
+      app_error    = Fl::error;
+      Fl::error    = async_error;
+    }
+
+    lock_async();
+    if (pending_last) pending_last->next = job;
+    else pending_first = job;
+    pending_last = job;
+    signal_async();
+    unlock_async();
+#endif // NO_ASYNC_THREADS
+
+    if (!Fl::has_timeout(deliver_async_))
+      Fl::add_timeout(ASYNC_POLL_DELAY, deliver_async_);
+  }
+
+  Async_Waiter *w = new Async_Waiter;
+  w->cb        = cb;
+  w->data      = data;
+  w->owner     = owner ? new Fl_Widget_Tracker(owner) : 0;
+  w->next      = job->waiters;
+  job->waiters = w;
+
+  return img;
+}
+
+
+/**
+  Sets the number of threads that load files for get_async().
+
+  Threads are started when files are requested, and are never stopped.
+  If \p n is 0 or less, the default is one thread less than the number of
+  processors, between 1 and 4.
+
+  \version 1.4.0
+*/
+void Fl_Shared_Image::async_threads(int n) {
+  if (n <= 0) {
+    n = cpu_count() - 1;
+    if (n > 4) n = 4;
+    if (n < 1) n = 1;
+  }
+  max_threads = n;
+}
+
+
 /** Adds a shared image handler, which is basically a test function
     for adding new formats.
+
+    Handlers are also called by the threads of get_async(), several at
+    once, so they must be thread-safe: they must not keep the image or
+    the file they load in static or global variables.
 */
 void Fl_Shared_Image::add_handler(Fl_Shared_Handler f) {
   int			i;		// Looping var...
@@ -553,6 +1253,65 @@ void Fl_Shared_Image::remove_handler(Fl_Shared_Handler f) {
 }
 
 
+/** Adds a shared image handler that can load an image at a smaller size.
+
+    Sized handlers are tried before the other handlers when get() or
+    get_async() is given a size \p W x \p H and the image is not in the
+    cache. They return NULL if they don't support the format of the file,
+    and may return an image of any size between \p W x \p H and the size
+    of the file, that Fl_Shared_Image then resizes. fl_register_images()
+    adds one for JPEG files, that are decoded at 1/2, 1/4 or 1/8 scale.
+    Like the other handlers, they must be thread-safe.
+    \version 1.4.0
+*/
+void Fl_Shared_Image::add_handler(Fl_Shared_Sized_Handler f) {
+  int			i;		// Looping var...
+  Fl_Shared_Sized_Handler *temp;	// New image handler array...
+
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) return;
+  }
+
+  if (num_sized_handlers_ >= alloc_sized_handlers_) {
+    temp = new Fl_Shared_Sized_Handler [alloc_sized_handlers_ + 32];
+
+    if (alloc_sized_handlers_) {
+      memcpy(temp, sized_handlers_,
+             alloc_sized_handlers_ * sizeof(Fl_Shared_Sized_Handler));
+
+      delete[] sized_handlers_;
+    }
+
+    sized_handlers_       = temp;
+    alloc_sized_handlers_ += 32;
+  }
+
+  sized_handlers_[num_sized_handlers_] = f;
+  num_sized_handlers_ ++;
+}
+
+
+/** Removes a shared image handler that can load an image at a smaller size.
+    \version 1.4.0
+*/
+void Fl_Shared_Image::remove_handler(Fl_Shared_Sized_Handler f) {
+  int	i;				// Looping var...
+
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) break;
+  }
+
+  if (i >= num_sized_handlers_) return;
+
+  num_sized_handlers_ --;
+
+  if (i < num_sized_handlers_) {
+    memmove(sized_handlers_ + i, sized_handlers_ + i + 1,
+           (num_sized_handlers_ - i) * sizeof(Fl_Shared_Sized_Handler));
+  }
+}
+
+
 //
 // End of "$Id$".
 //
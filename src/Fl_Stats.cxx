@@ -0,0 +1,181 @@
+//
+// "$Id$"
+//
+// Event loop instrumentation for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Stats.H>
+#include "Fl_System_Driver.H"
+#include <string.h>
+
+int Fl_Stats::enabled_ = 0;
+Fl_Stats_Record Fl_Stats::records_[FL_STATS_PHASES];
+unsigned long Fl_Stats::counters_[FL_STATS_COUNTERS];
+
+static const char *phase_names[FL_STATS_PHASES] = {
+  "event", "timeout", "idle", "check", "awake", "fd", "flush", "draw", "wait"
+};
+
+static time_t base_sec; // origin of now(), keeps the double precise
+
+/**
+ Sets the origin of now(), once.
+ enable() and Fl_Trace::enable() call this before they use the clock.
+ */
+void Fl_Stats::init_clock() {
+  if (!base_sec) {
+    int usec;
+    Fl::system_driver()->gettime(&base_sec, &usec);
+    base_sec--; // so that now() is never 0
+  }
+}
+
+/**
+ Enables or disables event loop instrumentation.
+ Counters are kept when instrumentation is disabled; use reset() to clear them.
+ */
+void Fl_Stats::enable(int on) {
+  if (on) init_clock();
+  enabled_ = (on != 0);
+}
+
+/** Clears all counters and histograms. */
+void Fl_Stats::reset() {
+  memset(records_, 0, sizeof(records_));
+  memset(counters_, 0, sizeof(counters_));
+}
+
+/**
+ Returns the counters of one phase of the event loop,
+ or NULL if \p phase is out of range.
+ */
+const Fl_Stats_Record *Fl_Stats::get(Fl_Stats_Phase phase) {
+  if (phase < 0 || phase >= FL_STATS_PHASES) return NULL;
+  return records_ + phase;
+}
+
+/** Returns a short printable name of \p phase. */
+const char *Fl_Stats::phase_name(Fl_Stats_Phase phase) {
+  if (phase < 0 || phase >= FL_STATS_PHASES) return "?";
+  return phase_names[phase];
+}
+
+/** Returns the value of a counter, or 0 if \p c is out of range. */
+unsigned long Fl_Stats::counter(Fl_Stats_Counter c) {
+  if (c < 0 || c >= FL_STATS_COUNTERS) return 0;
+  return counters_[c];
+}
+
+/**
+ Returns the current time in seconds, as used by the instrumentation.
+ Only differences between two values are meaningful.
+ */
+double Fl_Stats::now() {
+  time_t sec;
+  int usec;
+  Fl::system_driver()->gettime(&sec, &usec);
+  return double(sec - base_sec) + usec / 1000000.0;
+}
+
+void Fl_Stats::record(Fl_Stats_Phase phase, double t) {
+  if (t < 0) t = 0; // the clock went backwards
+  Fl_Stats_Record *r = records_ + phase;
+  r->count++;
+  r->total += t;
+  if (t > r->max) r->max = t;
+  // bucket = number of significant bits of the duration in microseconds
+  unsigned long us = (unsigned long)(t * 1000000.0);
+  int b = 0;
+  while (us && b < FL_STATS_BUCKETS - 1) { us >>= 1; b++; }
+  r->histogram[b]++;
+}
+
+/**
+ Returns an estimate of the duration, in seconds, below which the given
+ \p fraction (between 0 and 1) of the samples of \p phase fall.
+ The value is the upper limit of the histogram bucket that contains
+ the requested percentile, clamped to the longest sample.
+ */
+double Fl_Stats::percentile(Fl_Stats_Phase phase, double fraction) {
+  const Fl_Stats_Record *r = get(phase);
+  if (!r || !r->count) return 0;
+  if (fraction > 1) fraction = 1;
+  unsigned long wanted = (unsigned long)(fraction * r->count + 0.5);
+  if (wanted < 1) wanted = 1;
+  unsigned long seen = 0;
+  for (int b = 0; b < FL_STATS_BUCKETS; b++) {
+    seen += r->histogram[b];
+    if (seen >= wanted) {
+      double limit = (1UL << b) / 1000000.0;
+      return limit < r->max ? limit : r->max;
+    }
+  }
+  return r->max;
+}
+
+/** Prints a table of all counters to \p f. */
+void Fl_Stats::dump(FILE *f) {
+  fprintf(f, "%-8s %10s %12s %10s %10s %10s %10s\n",
+          "phase", "count", "total(ms)", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+  for (int i = 0; i < FL_STATS_PHASES; i++) {
+    Fl_Stats_Phase p = (Fl_Stats_Phase)i;
+    const Fl_Stats_Record *r = records_ + i;
+    if (!r->count) continue;
+    fprintf(f, "%-8s %10lu %12.3f %10.1f %10.0f %10.0f %10.0f\n",
+            phase_names[i], r->count, r->total * 1000,
+            r->total * 1000000 / r->count,
+            percentile(p, 0.5) * 1000000, percentile(p, 0.99) * 1000000,
+            r->max * 1000000);
+  }
+  unsigned long prims = counters_[FL_STATS_PRIMITIVES];
+  if (prims) {
+    unsigned long reqs = counters_[FL_STATS_REQUESTS];
+    unsigned long frames = records_[FL_STATS_DRAW].count;
+    fprintf(f, "batched %lu primitives in %lu requests", prims, reqs);
+    if (frames && prims >= reqs)
+      fprintf(f, ", %.1f requests saved per redraw", double(prims - reqs) / frames);
+    fprintf(f, "\n");
+  }
+  fflush(f);
+}
+
+static double dump_delay = 0;
+static FILE *dump_file = NULL;
+static int dump_reset = 0;
+
+static void dump_cb(void *) {
+  Fl_Stats::dump(dump_file);
+  if (dump_reset) Fl_Stats::reset();
+  Fl::repeat_timeout(dump_delay, dump_cb);
+}
+
+/**
+ Prints the counters to \p f every \p seconds seconds, using a timeout.
+ If \p reset_after is non-zero, the counters are cleared after each report
+ so that each one describes the last interval only.
+ A value of 0 or less for \p seconds stops the periodic report.
+ */
+void Fl_Stats::dump_interval(double seconds, FILE *f, int reset_after) {
+  Fl::remove_timeout(dump_cb);
+  dump_delay = seconds;
+  dump_file = f ? f : stderr;
+  dump_reset = reset_after;
+  if (seconds > 0) Fl::add_timeout(seconds, dump_cb);
+}
+
+//
+// End of "$Id$".
+//
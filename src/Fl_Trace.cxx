@@ -0,0 +1,261 @@
+//
+// "$Id$"
+//
+// Trace event recorder for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "config_lib.h"
+#include <FL/Fl.H>
+#include <FL/Fl_Trace.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Widget.H>
+#include <FL/fl_utf8.h>
+#include "flstring.h"
+#include <stdlib.h>
+#include <typeinfo>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(HAVE_PTHREAD)
+#  include <pthread.h>
+#endif
+
+// Each thread records into its own ring of events. The rings are linked
+// together so that write() can find all of them. They are never freed
+// because the trace of a finished thread is still interesting.
+
+#define ARG_SIZE 32
+
+struct Trace_Event {
+  double ts;              // seconds, from Fl_Stats::now()
+  const char *name;       // static string
+  const char *cat;        // static string
+  char arg[ARG_SIZE];     // copied label, may be empty
+  char ph;                // 'B' or 'E'
+};
+
+struct Trace_Ring {
+  Trace_Event *events;
+  int size;
+  unsigned long count;    // number of events ever written
+  int tid;
+  Trace_Ring *next;
+};
+
+int Fl_Trace::enabled_ = 0;
+static int ring_size = 65536;
+static Trace_Ring *rings = NULL;
+static int thread_count = 0;
+
+#if defined(_WIN32)
+
+static DWORD ring_key = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION ring_list_lock;
+static void init_thread_support() {
+  if (ring_key != TLS_OUT_OF_INDEXES) return;
+  InitializeCriticalSection(&ring_list_lock);
+  ring_key = TlsAlloc();
+}
+static Trace_Ring *get_ring() { return (Trace_Ring*)TlsGetValue(ring_key); }
+static void set_ring(Trace_Ring *r) { TlsSetValue(ring_key, r); }
+static void lock_list() { EnterCriticalSection(&ring_list_lock); }
+static void unlock_list() { LeaveCriticalSection(&ring_list_lock); }
+
+#elif defined(HAVE_PTHREAD)
+
+static pthread_key_t ring_key;
+static int ring_key_created = 0;
+static pthread_mutex_t ring_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static void init_thread_support() {
+  if (ring_key_created) return;
+  pthread_key_create(&ring_key, NULL);
+  ring_key_created = 1;
+}
+static Trace_Ring *get_ring() { return (Trace_Ring*)pthread_getspecific(ring_key); }
+static void set_ring(Trace_Ring *r) { pthread_setspecific(ring_key, r); }
+static void lock_list() { pthread_mutex_lock(&ring_list_lock); }
+static void unlock_list() { pthread_mutex_unlock(&ring_list_lock); }
+
+#else // no thread support: a single ring
+
+static Trace_Ring *the_ring = NULL;
+static void init_thread_support() {}
+static Trace_Ring *get_ring() { return the_ring; }
+static void set_ring(Trace_Ring *r) { the_ring = r; }
+static void lock_list() {}
+static void unlock_list() {}
+
+#endif
+
+static Trace_Ring *current_ring() {
+  Trace_Ring *r = get_ring();
+  if (!r) {
+    r = (Trace_Ring*)calloc(1, sizeof(Trace_Ring));
+    r->size = ring_size;
+    r->events = (Trace_Event*)malloc(r->size * sizeof(Trace_Event));
+    lock_list();
+    r->tid = ++thread_count;
+    r->next = rings;
+    rings = r;
+    unlock_list();
+    set_ring(r);
+  }
+  return r;
+}
+
+static void add_event(char ph, const char *name, const char *cat, const char *arg) {
+  Trace_Ring *r = current_ring();
+  Trace_Event *e = r->events + (r->count % r->size);
+  e->ts = Fl_Stats::now();
+  e->ph = ph;
+  e->name = name;
+  e->cat = cat;
+  if (arg) {
+    strlcpy(e->arg, arg, ARG_SIZE);
+    if (e->arg[ARG_SIZE-2] && arg[ARG_SIZE-1]) {
+      // the label was truncated: don't cut it inside a UTF-8 sequence
+      int l = ARG_SIZE - 1;
+      while (l > 0 && (arg[l] & 0xC0) == 0x80) l--;
+      e->arg[l] = 0;
+    }
+  } else e->arg[0] = 0;
+  r->count++;
+}
+
+/**
+ Starts or stops recording trace events.
+ \param on non-zero to record events
+ \param events_per_thread size of the ring buffer of each thread, in events.
+        0 keeps the current size (65536 events by default). A new size only
+        applies to threads that did not record any event yet.
+ */
+void Fl_Trace::enable(int on, int events_per_thread) {
+  if (events_per_thread > 0) ring_size = events_per_thread;
+  if (on) {
+    init_thread_support();
+    Fl_Stats::init_clock();
+  }
+  enabled_ = (on != 0);
+}
+
+void Fl_Trace::begin_(const char *name, const char *cat, const char *arg) {
+  add_event('B', name, cat, arg);
+}
+
+void Fl_Trace::end_() {
+  add_event('E', NULL, NULL, NULL);
+}
+
+void Fl_Trace::widget_begin_(const Fl_Widget *w, const char *cat) {
+  add_event('B', class_name(w), cat, w->label());
+}
+
+/**
+ Returns the name of the class of widget \p w.
+ The name is obtained through RTTI and is only slightly cleaned up,
+ so it depends on the compiler for classes declared inside a namespace.
+ */
+const char *Fl_Trace::class_name(const Fl_Widget *w) {
+  const char *n = typeid(*w).name();
+  // GCC and clang: classes at global scope are mangled as <length><name>
+  while (*n >= '0' && *n <= '9') n++;
+  // Visual C++
+  if (!strncmp(n, "class ", 6)) n += 6;
+  return n;
+}
+
+/** Discards all recorded events. */
+void Fl_Trace::clear() {
+  lock_list();
+  for (Trace_Ring *r = rings; r; r = r->next) r->count = 0;
+  unlock_list();
+}
+
+// write a JSON string, escaping what must be escaped
+static void write_string(FILE *f, const char *s) {
+  putc('"', f);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if (c < 0x20) fprintf(f, "\\u%04x", c);
+    else putc(c, f);
+  }
+  putc('"', f);
+}
+
+/**
+ Writes all recorded events to \p f in the Chrome trace-event JSON format.
+ Recording is suspended while the file is written.
+ \return 0 on success, -1 on write error.
+ */
+int Fl_Trace::write(FILE *f) {
+  int was_enabled = enabled_;
+  enabled_ = 0;
+  fputs("{\"traceEvents\":[\n", f);
+  int first = 1;
+  lock_list();
+  for (Trace_Ring *r = rings; r; r = r->next) {
+    unsigned long n = r->count < (unsigned long)r->size ? r->count : r->size;
+    unsigned long start = r->count - n;
+    // The ring may have overwritten the beginning of some events:
+    // drop the 'E' records that have no matching 'B'.
+    int depth = 0;
+    for (unsigned long i = start; i < r->count; i++) {
+      Trace_Event *e = r->events + (i % r->size);
+      if (e->ph == 'E') {
+        if (depth == 0) continue;
+        depth--;
+      } else {
+        depth++;
+      }
+      fprintf(f, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+              first ? "" : ",\n", e->ph, r->tid, e->ts * 1000000.0);
+      first = 0;
+      if (e->ph == 'B') {
+        fputs(",\"name\":", f);
+        write_string(f, e->name ? e->name : "?");
+        fputs(",\"cat\":", f);
+        write_string(f, e->cat ? e->cat : "");
+        if (e->arg[0]) {
+          fputs(",\"args\":{\"label\":", f);
+          write_string(f, e->arg);
+          putc('}', f);
+        }
+      }
+      putc('}', f);
+    }
+  }
+  unlock_list();
+  fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+  enabled_ = was_enabled;
+  return ferror(f) ? -1 : 0;
+}
+
+/**
+ Writes all recorded events to the file \p filename.
+ \return 0 on success, -1 on error.
+ \see write(FILE*)
+ */
+int Fl_Trace::save(const char *filename) {
+  FILE *f = fl_fopen(filename, "w");
+  if (!f) return -1;
+  int ret = write(f);
+  if (fclose(f)) ret = -1;
+  return ret;
+}
+
+//
+// End of "$Id$".
+//
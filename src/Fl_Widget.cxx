@@ -23,6 +23,7 @@
 #include <FL/fl_draw.H>
 #include <stdlib.h>
 #include "flstring.h"
+#include "Fl_Group_Index.H"
 
 
 ////////////////////////////////////////////////////////////////
@@ -140,6 +141,10 @@ Fl_Widget::Fl_Widget(int X, int Y, int W, int H, const char* L) {
 
 void Fl_Widget::resize(int X, int Y, int W, int H) {
   x_ = X; y_ = Y; w_ = W; h_ = H;
+  // parent_ is not always a group: Fl_Value_Input makes itself the parent
+  // of its Fl_Input
+  Fl_Group *g = parent_ ? parent_->as_group() : 0;
+  if (g && g->index_) g->index_->invalidate();
 }
 
 // this is useful for parent widgets to call to resize children:
@@ -20,6 +20,7 @@
 // Replaces the older set_idle() call (which is used to implement this)
 
 #include <FL/Fl.H>
+#include <FL/Fl_Stats.H>
 
 struct idle_cb {
   void (*cb)(void*);
@@ -37,7 +38,9 @@ static idle_cb* freelist;
 static void call_idle() {
   idle_cb* p = first;
   last = p; first = p->next;
+  double t0 = Fl_Stats::start();
   p->cb(p->data); // this may call add_idle() or remove_idle()!
+  Fl_Stats::stop(FL_STATS_IDLE, t0);
 }
 
 /**
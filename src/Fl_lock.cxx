@@ -18,6 +18,8 @@
 
 #include "config_lib.h"
 #include <FL/Fl.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Trace.H>
 #include "Fl_System_Driver.H"
 
 #include <stdlib.h>
@@ -336,7 +338,11 @@ static void thread_awake_cb(int fd, void*) {
   Fl_Awake_Handler func;
   void *data;
   while (Fl::get_awake_handler_(func, data)==0) {
+    double t0 = Fl_Stats::start();
+    Fl_Trace::begin("awake", "awake");
     (*func)(data);
+    Fl_Trace::end();
+    Fl_Stats::stop(FL_STATS_AWAKE, t0);
   }
 }
 
@@ -66,6 +66,8 @@ void fl_cleanup_dc_list(void);
 #include <FL/fl_draw.H>
 #include <FL/Enumerations.H>
 #include <FL/Fl_Tooltip.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Trace.H>
 #include <FL/Fl_Paged_Device.H>
 #include <FL/Fl_Image_Surface.H>
 #include "flstring.h"
@@ -400,7 +402,11 @@ static void process_awake_handler_requests(void) {
   Fl_Awake_Handler func;
   void *data;
   while (Fl::get_awake_handler_(func, data) == 0) {
+    double t0 = Fl_Stats::start();
+    Fl_Trace::begin("awake", "awake");
     func(data);
+    Fl_Trace::end();
+    Fl_Stats::stop(FL_STATS_AWAKE, t0);
   }
 }
 
@@ -29,6 +29,8 @@
 #  include <FL/Fl_Window.H>
 #  include <FL/fl_utf8.h>
 #  include <FL/Fl_Tooltip.H>
+#  include <FL/Fl_Stats.H>
+#  include <FL/Fl_Trace.H>
 #  include <FL/fl_draw.H>
 #  include <FL/Fl_Paged_Device.H>
 #  include <FL/Fl_Shared_Image.H>
@@ -246,6 +248,7 @@ int Fl_X11_Screen_Driver::poll_or_select_with_delay(double time_to_wait) {
 #  endif
   int n;
 
+  double t0 = Fl_Stats::start();
   fl_unlock_function();
 
   if (time_to_wait < 2147483.648) {
@@ -266,18 +269,27 @@ int Fl_X11_Screen_Driver::poll_or_select_with_delay(double time_to_wait) {
   }
 
   fl_lock_function();
+  Fl_Stats::stop(FL_STATS_WAIT, t0);
 
   if (n > 0) {
     for (int i=0; i<nfds; i++) {
 #  if USE_POLL
-      if (pollfds[i].revents) fd[i].cb(pollfds[i].fd, fd[i].arg);
+      if (pollfds[i].revents) {
+        t0 = Fl_Stats::start();
+        fd[i].cb(pollfds[i].fd, fd[i].arg);
+        Fl_Stats::stop(FL_STATS_FD, t0);
+      }
 #  else
       int f = fd[i].fd;
       short revents = 0;
       if (FD_ISSET(f,&fdt[0])) revents |= POLLIN;
       if (FD_ISSET(f,&fdt[1])) revents |= POLLOUT;
       if (FD_ISSET(f,&fdt[2])) revents |= POLLERR;
-      if (fd[i].events & revents) fd[i].cb(f, fd[i].arg);
+      if (fd[i].events & revents) {
+        t0 = Fl_Stats::start();
+        fd[i].cb(f, fd[i].arg);
+        Fl_Stats::stop(FL_STATS_FD, t0);
+      }
 #  endif
     }
   }
@@ -611,7 +623,9 @@ void Fl_X11_Screen_Driver::open_display_platform() {
   XSetIOErrorHandler(io_error_handler);
   XSetErrorHandler(xerror_handler);
 
+  Fl_Trace::begin("open display", "startup");
   Display *d = XOpenDisplay(0);
+  Fl_Trace::end();
   if (!d) Fl::fatal("Can't open display: %s",XDisplayName(0));
 
   fl_open_display(d);
@@ -621,50 +635,65 @@ void Fl_X11_Screen_Driver::open_display_platform() {
 }
 
 
+// Atoms used by FLTK, interned at once by fl_open_display():
+// one round trip to the server instead of one per atom.
+static const struct {
+  Atom *atom;
+  const char *name;
+} fl_atoms[] = {
+  {&WM_DELETE_WINDOW,              "WM_DELETE_WINDOW"},
+  {&WM_PROTOCOLS,                  "WM_PROTOCOLS"},
+  {&fl_MOTIF_WM_HINTS,             "_MOTIF_WM_HINTS"},
+  {&TARGETS,                       "TARGETS"},
+  {&CLIPBOARD,                     "CLIPBOARD"},
+  {&TIMESTAMP,                     "TIMESTAMP"},
+  {&PRIMARY_TIMESTAMP,             "PRIMARY_TIMESTAMP"},
+  {&CLIPBOARD_TIMESTAMP,           "CLIPBOARD_TIMESTAMP"},
+  {&fl_XdndAware,                  "XdndAware"},
+  {&fl_XdndSelection,              "XdndSelection"},
+  {&fl_XdndEnter,                  "XdndEnter"},
+  {&fl_XdndTypeList,               "XdndTypeList"},
+  {&fl_XdndPosition,               "XdndPosition"},
+  {&fl_XdndLeave,                  "XdndLeave"},
+  {&fl_XdndDrop,                   "XdndDrop"},
+  {&fl_XdndStatus,                 "XdndStatus"},
+  {&fl_XdndActionCopy,             "XdndActionCopy"},
+  {&fl_XdndFinished,               "XdndFinished"},
+//{&fl_XdndProxy,                  "XdndProxy"},
+  {&fl_XdndURIList,                "text/uri-list"},
+  {&fl_Xatextplainutf,             "text/plain;charset=UTF-8"},
+  {&fl_Xatextplainutf2,            "text/plain;charset=utf-8"}, // Firefox/Thunderbird needs this - See STR#2930
+  {&fl_Xatextplain,                "text/plain"},
+  {&fl_XaText,                     "TEXT"},
+  {&fl_XaCompoundText,             "COMPOUND_TEXT"},
+  {&fl_XaUtf8String,               "UTF8_STRING"},
+  {&fl_XaTextUriList,              "text/uri-list"},
+  {&fl_XaImageBmp,                 "image/bmp"},
+  {&fl_XaImagePNG,                 "image/png"},
+  {&fl_INCR,                       "INCR"},
+  {&fl_NET_WM_PID,                 "_NET_WM_PID"},
+  {&fl_NET_WM_NAME,                "_NET_WM_NAME"},
+  {&fl_NET_WM_ICON_NAME,           "_NET_WM_ICON_NAME"},
+  {&fl_NET_SUPPORTING_WM_CHECK,    "_NET_SUPPORTING_WM_CHECK"},
+  {&fl_NET_WM_STATE,               "_NET_WM_STATE"},
+  {&fl_NET_WM_STATE_FULLSCREEN,    "_NET_WM_STATE_FULLSCREEN"},
+  {&fl_NET_WM_FULLSCREEN_MONITORS, "_NET_WM_FULLSCREEN_MONITORS"},
+  {&fl_NET_WORKAREA,               "_NET_WORKAREA"},
+  {&fl_NET_WM_ICON,                "_NET_WM_ICON"},
+  {&fl_NET_ACTIVE_WINDOW,          "_NET_ACTIVE_WINDOW"},
+};
+
 void fl_open_display(Display* d) {
   fl_display = d;
 
-  WM_DELETE_WINDOW      = XInternAtom(d, "WM_DELETE_WINDOW",    0);
-  WM_PROTOCOLS          = XInternAtom(d, "WM_PROTOCOLS",        0);
-  fl_MOTIF_WM_HINTS     = XInternAtom(d, "_MOTIF_WM_HINTS",     0);
-  TARGETS               = XInternAtom(d, "TARGETS",             0);
-  CLIPBOARD             = XInternAtom(d, "CLIPBOARD",           0);
-  TIMESTAMP             = XInternAtom(d, "TIMESTAMP",           0);
-  PRIMARY_TIMESTAMP     = XInternAtom(d, "PRIMARY_TIMESTAMP",   0);
-  CLIPBOARD_TIMESTAMP   = XInternAtom(d, "CLIPBOARD_TIMESTAMP", 0);
-  fl_XdndAware          = XInternAtom(d, "XdndAware",           0);
-  fl_XdndSelection      = XInternAtom(d, "XdndSelection",       0);
-  fl_XdndEnter          = XInternAtom(d, "XdndEnter",           0);
-  fl_XdndTypeList       = XInternAtom(d, "XdndTypeList",        0);
-  fl_XdndPosition       = XInternAtom(d, "XdndPosition",        0);
-  fl_XdndLeave          = XInternAtom(d, "XdndLeave",           0);
-  fl_XdndDrop           = XInternAtom(d, "XdndDrop",            0);
-  fl_XdndStatus         = XInternAtom(d, "XdndStatus",          0);
-  fl_XdndActionCopy     = XInternAtom(d, "XdndActionCopy",      0);
-  fl_XdndFinished       = XInternAtom(d, "XdndFinished",        0);
-  //fl_XdndProxy        = XInternAtom(d, "XdndProxy",           0);
-  fl_XdndEnter          = XInternAtom(d, "XdndEnter",           0);
-  fl_XdndURIList        = XInternAtom(d, "text/uri-list",       0);
-  fl_Xatextplainutf     = XInternAtom(d, "text/plain;charset=UTF-8",0);
-  fl_Xatextplainutf2    = XInternAtom(d, "text/plain;charset=utf-8",0);	// Firefox/Thunderbird needs this - See STR#2930
-  fl_Xatextplain        = XInternAtom(d, "text/plain",          0);
-  fl_XaText             = XInternAtom(d, "TEXT",                0);
-  fl_XaCompoundText     = XInternAtom(d, "COMPOUND_TEXT",       0);
-  fl_XaUtf8String       = XInternAtom(d, "UTF8_STRING",         0);
-  fl_XaTextUriList      = XInternAtom(d, "text/uri-list",       0);
-  fl_XaImageBmp         = XInternAtom(d, "image/bmp",           0);
-  fl_XaImagePNG         = XInternAtom(d, "image/png",           0);
-  fl_INCR               = XInternAtom(d, "INCR",                0);
-  fl_NET_WM_PID         = XInternAtom(d, "_NET_WM_PID",         0);
-  fl_NET_WM_NAME        = XInternAtom(d, "_NET_WM_NAME",        0);
-  fl_NET_WM_ICON_NAME   = XInternAtom(d, "_NET_WM_ICON_NAME",   0);
-  fl_NET_SUPPORTING_WM_CHECK = XInternAtom(d, "_NET_SUPPORTING_WM_CHECK", 0);
-  fl_NET_WM_STATE       = XInternAtom(d, "_NET_WM_STATE",       0);
-  fl_NET_WM_STATE_FULLSCREEN = XInternAtom(d, "_NET_WM_STATE_FULLSCREEN", 0);
-  fl_NET_WM_FULLSCREEN_MONITORS = XInternAtom(d, "_NET_WM_FULLSCREEN_MONITORS", 0);
-  fl_NET_WORKAREA       = XInternAtom(d, "_NET_WORKAREA",       0);
-  fl_NET_WM_ICON        = XInternAtom(d, "_NET_WM_ICON",        0);
-  fl_NET_ACTIVE_WINDOW  = XInternAtom(d, "_NET_ACTIVE_WINDOW",  0);
+  Fl_Trace::begin("intern atoms", "startup");
+  const int n_atoms = sizeof(fl_atoms) / sizeof(fl_atoms[0]);
+  char *atom_names[n_atoms];
+  Atom atoms[n_atoms];
+  for (int i = 0; i < n_atoms; i++) atom_names[i] = (char*)fl_atoms[i].name;
+  XInternAtoms(d, atom_names, n_atoms, False, atoms);
+  for (int i = 0; i < n_atoms; i++) *fl_atoms[i].atom = atoms[i];
+  Fl_Trace::end();
 
   if (sizeof(Atom) < 4)
     atom_bits = sizeof(Atom) * 8;
@@ -676,16 +705,22 @@ void fl_open_display(Display* d) {
   fl_message_window =
     XCreateSimpleWindow(d, RootWindow(d,fl_screen), 0,0,1,1,0, 0, 0);
 
+  Fl_Trace::begin("select visual", "startup");
 // construct an XVisualInfo that matches the default Visual:
   XVisualInfo templt; int num;
   templt.visualid = XVisualIDFromVisual(DefaultVisual(d, fl_screen));
   fl_visual = XGetVisualInfo(d, VisualIDMask, &templt, &num);
   fl_colormap = DefaultColormap(d, fl_screen);
-  fl_init_xim();
-
 #if !USE_COLORMAP
   Fl::visual(FL_RGB);
 #endif
+  Fl_Trace::end();
+
+  Fl_Trace::begin("init XIM", "startup");
+  fl_init_xim();
+  Fl_Trace::end();
+
+  Fl_Trace::begin("query extensions", "startup");
 
 #if HAVE_XFIXES
   int error_base;
@@ -711,6 +746,8 @@ void fl_open_display(Display* d) {
     }
 #endif
 
+  Fl_Trace::end();
+
   // Listen for changes to _NET_WORKAREA
   XSelectInput(d, RootWindow(d, fl_screen), PropertyChangeMask);
 }
@@ -750,6 +787,16 @@ int fl_selection_length[2];
 const char * fl_selection_type[2];
 int fl_selection_buffer_length[2];
 char fl_i_own_selection[2] = {0,0};
+// PNG version of an image selection, made when first requested
+static char *fl_selection_png[2];
+static int fl_selection_png_length[2];
+static int fl_selection_image_w[2], fl_selection_image_h[2];
+
+static void free_selection_png(int clipboard) {
+  free(fl_selection_png[clipboard]);
+  fl_selection_png[clipboard] = NULL;
+  fl_selection_png_length[clipboard] = 0;
+}
 
 // Call this when a "paste" operation happens:
 void Fl_X11_System_Driver::paste(Fl_Widget &receiver, int clipboard, const char *type) {
@@ -902,6 +949,7 @@ void Fl_X11_System_Driver::copy(const char *stuff, int len, int clipboard, const
   }
   memcpy(fl_selection_buffer[clipboard], stuff, len);
   fl_selection_buffer[clipboard][len] = 0; // needed for direct paste
+  free_selection_png(clipboard);
   fl_selection_length[clipboard] = len;
   fl_i_own_selection[clipboard] = 1;
   fl_selection_type[clipboard] = Fl::clipboard_plain_text;
@@ -967,12 +1015,30 @@ static unsigned char *create_bmp(const unsigned char *data, int W, int H, int *r
   return b;
 }
 
+// Returns the image selection in PNG format, encoded from its BMP version
+// at the first call. Returns NULL if PNG encoding is not available.
+static const char *selection_png(int clipboard, int *length) {
+  if (!fl_selection_png[clipboard] && Fl_Screen_Driver::png_encoder) {
+    int W = fl_selection_image_w[clipboard], H = fl_selection_image_h[clipboard];
+    int R = (3*W+3)/4 * 4; // as in create_bmp()
+    // the BMP lines are in BGR order, from bottom to top, after a 54-byte header
+    const uchar *last_line = (const uchar*)fl_selection_buffer[clipboard] + 54 + (H - 1) * R;
+    fl_selection_png[clipboard] = (char*)Fl_Screen_Driver::png_encoder(last_line, W, H, -R, 1,
+                                                 &fl_selection_png_length[clipboard]);
+  }
+  *length = fl_selection_png_length[clipboard];
+  return fl_selection_png[clipboard];
+}
+
 // takes a raw RGB image and puts it in the copy/paste buffer
 void Fl_X11_Screen_Driver::copy_image(const unsigned char *data, int W, int H, int clipboard){
   if (!data || W <= 0 || H <= 0) return;
   delete[] fl_selection_buffer[clipboard];
   fl_selection_buffer[clipboard] = (char *) create_bmp(data,W,H,&fl_selection_length[clipboard]);
   fl_selection_buffer_length[clipboard] = fl_selection_length[clipboard];
+  free_selection_png(clipboard);
+  fl_selection_image_w[clipboard] = W;
+  fl_selection_image_h[clipboard] = H;
   fl_i_own_selection[clipboard] = 1;
   fl_selection_type[clipboard] = Fl::clipboard_image;
   Atom property = clipboard ? CLIPBOARD : XA_PRIMARY;
@@ -1212,6 +1278,127 @@ static long getIncrData(uchar* &data, const XSelectionEvent& selevent, long lowe
   return (long)total;
 }
 
+////////////////////////////////////////////////////////////////
+// Sending large selections with the INCR protocol of the ICCCM:
+// the requestor receives a property of type INCR, and each time it deletes
+// the property, the next chunk of data is written to it; an empty chunk
+// ends the transfer.
+
+struct Incr_Transfer {
+  Window requestor;
+  Atom property;
+  Atom type;
+  char *data;           // copy of the selection, which may change meanwhile
+  int length;
+  int offset;           // of the next chunk in data
+  long old_mask;        // event mask of the requestor before its transfers
+  Incr_Transfer *next;
+};
+
+static Incr_Transfer *incr_transfers = NULL;
+static const double incr_timeout = 5.0; // requestors that stall are given up
+
+// the size of chunks, and the largest selection sent at once
+static int incr_chunk_size() {
+  // XExtendedMaxRequestSize() is ignored on purpose: a single multi-megabyte
+  // request blocks the server while other clients wait.
+  long size = XMaxRequestSize(fl_display) * 4 - 100;
+  return size > 0x40000 ? 0x40000 : (int)size;
+}
+
+static void incr_end(Incr_Transfer *t);
+
+static void incr_timeout_cb(void *data) {
+  incr_end((Incr_Transfer*)data);
+}
+
+// Returns a transfer to the requestor, or NULL.
+static Incr_Transfer *incr_find(Window requestor) {
+  Incr_Transfer *t = incr_transfers;
+  while (t && t->requestor != requestor) t = t->next;
+  return t;
+}
+
+static void incr_end(Incr_Transfer *t) {
+  Fl::remove_timeout(incr_timeout_cb, t);
+  for (Incr_Transfer **p = &incr_transfers; *p; p = &(*p)->next) {
+    if (*p == t) { *p = t->next; break; }
+  }
+  // the last transfer to a requestor restores its event mask, unless the
+  // requestor was destroyed meanwhile
+  if (!incr_find(t->requestor)) {
+    XErrorHandler old_handler = XSetErrorHandler(catchXExceptions());
+    XSelectInput(fl_display, t->requestor, t->old_mask);
+    XSync(fl_display, False);
+    XSetErrorHandler(old_handler);
+  }
+  delete[] t->data;
+  delete t;
+}
+
+// Writes data to a property of the requestor of a selection, at once if it
+// is small enough, or else starts an INCR transfer.
+static void send_selection(Window requestor, Atom property, Atom type,
+                           const char *data, int length) {
+  if (length <= incr_chunk_size()) {
+    XChangeProperty(fl_display, requestor, property, type, 8, PropModeReplace,
+                    (unsigned char*)data, length);
+    return;
+  }
+  // a new request from the same requestor to the same property replaces
+  // an unfinished transfer
+  for (Incr_Transfer *t = incr_transfers; t; t = t->next) {
+    if (t->requestor == requestor && t->property == property) {
+      incr_end(t);
+      break;
+    }
+  }
+  XWindowAttributes attributes;
+  if (!XGetWindowAttributes(fl_display, requestor, &attributes)) return;
+  Incr_Transfer *t = new Incr_Transfer;
+  t->requestor = requestor;
+  t->property = property;
+  t->type = type;
+  t->data = new char[length];
+  memcpy(t->data, data, length);
+  t->length = length;
+  t->offset = 0;
+  // other transfers to the requestor may have selected PropertyChangeMask
+  Incr_Transfer *other = incr_find(requestor);
+  t->old_mask = other ? other->old_mask : attributes.your_event_mask;
+  t->next = incr_transfers;
+  incr_transfers = t;
+  // select PropertyNotify events of the requestor before it can delete
+  // the property
+  XSelectInput(fl_display, requestor, t->old_mask | PropertyChangeMask);
+  long lower_bound = length;
+  XChangeProperty(fl_display, requestor, property, fl_INCR, 32, PropModeReplace,
+                  (unsigned char*)&lower_bound, 1);
+  Fl::add_timeout(incr_timeout, incr_timeout_cb, t);
+}
+
+// Sends the next chunk of a transfer when its property was deleted.
+// Returns 1 if the event belongs to a transfer.
+static int incr_property_notify(const XPropertyEvent &e) {
+  if (e.state != PropertyDelete) return 0;
+  Incr_Transfer *t = incr_transfers;
+  while (t && (t->requestor != e.window || t->property != e.atom)) t = t->next;
+  if (!t) return 0;
+  int n = t->length - t->offset;
+  int chunk = incr_chunk_size();
+  if (n > chunk) n = chunk;
+  XChangeProperty(fl_display, t->requestor, t->property, t->type, 8,
+                  PropModeReplace, (unsigned char*)t->data + t->offset, n);
+  t->offset += n;
+  if (n == 0) { // the empty chunk was sent
+    incr_end(t);
+  } else {        // restart the timer
+    Fl::remove_timeout(incr_timeout_cb, t);
+    Fl::add_timeout(incr_timeout, incr_timeout_cb, t);
+  }
+  return 1;
+}
+
 /* Internal function to reduce "deprecated" warnings for XKeycodeToKeysym().
    This way we get only one warning. The option to use XkbKeycodeToKeysym()
    instead would not help much - see STR #2913 for more information.
@@ -1304,6 +1491,9 @@ int fl_handle(const XEvent& thisevent)
   if (xevent.type == PropertyNotify && xevent.xproperty.atom == fl_NET_WORKAREA) {
     Fl::screen_driver()->init_workarea();
   }
+
+  if (xevent.type == PropertyNotify && incr_transfers &&
+      incr_property_notify(xevent.xproperty)) return 1;
   
   switch (xevent.type) {
 
@@ -1354,13 +1544,13 @@ int fl_handle(const XEvent& thisevent)
 	*/
 	Atom t, type = XA_STRING;
 	if (Fl::e_clipboard_type == Fl::clipboard_image) { // searching for image data
-	  for (unsigned i = 0; i<count; i++) { 
+	  type = None;
+	  for (unsigned i = 0; i<count; i++) { // PNG is preferred, being much smaller
 	    t = ((Atom*)portion)[i];
-	    if (t == fl_XaImageBmp || t == fl_XaImagePNG) {
-	      type = t;
-	      goto found;
-	    }
+	    if (t == fl_XaImagePNG) type = t;
+	    else if (t == fl_XaImageBmp && type == None) type = t;
 	  }
+	  if (type != None) goto found;
 	  XFree(portion);
 	  return true;
 	}
@@ -1502,10 +1692,9 @@ int fl_handle(const XEvent& thisevent)
 	    // behave that insist on asking for XA_TEXT instead of UTF8_STRING
 	    // Does not change XA_STRING as that breaks xclipboard.
 	    if (e.target != XA_STRING) e.target = fl_XaUtf8String;
-	    XChangeProperty(fl_display, e.requestor, e.property,
-		            e.target, 8, 0,
-		            (unsigned char *)fl_selection_buffer[clipboard],
-		            fl_selection_length[clipboard]);
+	    send_selection(e.requestor, e.property, e.target,
+	                   fl_selection_buffer[clipboard],
+	                   fl_selection_length[clipboard]);
 	  }
 	} else {
 	  //    char* x = XGetAtomName(fl_display,e.target);
@@ -1516,15 +1705,21 @@ int fl_handle(const XEvent& thisevent)
       }
     } else { // image in clipboard
       if (e.target == TARGETS) {
-	Atom a[1] = {fl_XaImageBmp};
+	// PNG is offered first, but encoded only if requested
+	Atom a[2] = {fl_XaImagePNG, fl_XaImageBmp};
+	int n = Fl_Screen_Driver::png_encoder ? 2 : 1;
 	XChangeProperty(fl_display, e.requestor, e.property,
-	                XA_ATOM, atom_bits, 0, (unsigned char*)a, 1);
+	                XA_ATOM, atom_bits, 0, (unsigned char*)(a + 2 - n), n);
       } else {
+	const char *png;
+	int png_length;
 	if (e.target == fl_XaImageBmp && fl_selection_length[clipboard]) {
-	    XChangeProperty(fl_display, e.requestor, e.property,
-		            e.target, 8, 0,
-		            (unsigned char *)fl_selection_buffer[clipboard],
-		            fl_selection_length[clipboard]);
+	    send_selection(e.requestor, e.property, e.target,
+	                   fl_selection_buffer[clipboard],
+	                   fl_selection_length[clipboard]);
+	} else if (e.target == fl_XaImagePNG && fl_selection_length[clipboard] &&
+	           (png = selection_png(clipboard, &png_length)) != NULL) {
+	    send_selection(e.requestor, e.property, e.target, png, png_length);
 	} else {
 	  e.property = 0;
 	}
@@ -2933,14 +3128,6 @@ int Fl_X11_Window_Driver::set_cursor(const Fl_RGB_Image *image, int hotx, int ho
 
 ////////////////////////////////////////////////////////////////
 
-// returns pointer to the filename, or null if name ends with '/'
-const char *Fl_X11_System_Driver::filename_name(const char *name) {
-  const char *p,*q;
-  if (!name) return (0);
-  for (p=q=name; *p;) if (*p++ == '/') q = p;
-  return q;
-}
-
 void Fl_X11_Window_Driver::label(const char *name, const char *iname) {
   if (shown() && !parent()) {
     if (!name) name = "";
@@ -44,6 +44,8 @@
 # define FL_CFG_PRN_WIN32
 #elif defined(USE_X11) /* X11 */
 # define FL_CFG_PRN_PS
+#elif defined(USE_HEADLESS) /* memory framebuffers */
+# define FL_CFG_PRN_PS
 #endif
 
 #endif
@@ -72,6 +74,8 @@
 # define FL_CFG_SYS_WIN32
 #elif defined(USE_X11) /* X11 */
 # define FL_CFG_SYS_POSIX
+#elif defined(USE_HEADLESS) /* memory framebuffers */
+# define FL_CFG_SYS_POSIX
 #endif
 
 #endif
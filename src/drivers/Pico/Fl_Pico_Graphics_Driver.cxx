@@ -26,6 +26,19 @@
 static int sign(int x) { return (x>0)-(x<0); }
 
 
+Fl_Pico_Graphics_Driver::Fl_Pico_Graphics_Driver()
+{
+  antialias_ = 0;
+  px_ = py_ = pxf_ = pyf_ = 0;
+  pn_ = 0;
+}
+
+
+Fl_Pico_Graphics_Driver::~Fl_Pico_Graphics_Driver()
+{
+}
+
+
 void Fl_Pico_Graphics_Driver::point(int x, int y)
 {
   // This is the one method that *must* be overridden in the final driver
@@ -64,6 +77,7 @@ void Fl_Pico_Graphics_Driver::line(int x, int y, int x1, int y1)
   // Bresenham
   int w = x1 - x, dx = abs(w);
   int h = y1 - y, dy = abs(h);
+  if (!not_clipped(x < x1 ? x : x1, y < y1 ? y : y1, dx + 1, dy + 1)) return;
   int dx1 = sign(w), dy1 = sign(h), dx2, dy2;
   int min, max;
   if (dx < dy) {
@@ -169,9 +183,14 @@ void Fl_Pico_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y
 }
 
 
+// Like X11, the fixed size polygons are filled, then outlined.
 void Fl_Pico_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2)
 {
-  // FIXME: fill
+  rasterizer_.clear();
+  rasterizer_.add_edge(x0, y0, x1, y1);
+  rasterizer_.add_edge(x1, y1, x2, y2);
+  rasterizer_.add_edge(x2, y2, x0, y0);
+  fill_path(rasterizer_);
   line(x0, y0, x1, y1);
   line(x1, y1, x2, y2);
   line(x2, y2, x0, y0);
@@ -180,7 +199,12 @@ void Fl_Pico_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, in
 
 void Fl_Pico_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3)
 {
-  // FIXME: fill
+  rasterizer_.clear();
+  rasterizer_.add_edge(x0, y0, x1, y1);
+  rasterizer_.add_edge(x1, y1, x2, y2);
+  rasterizer_.add_edge(x2, y2, x3, y3);
+  rasterizer_.add_edge(x3, y3, x0, y0);
+  fill_path(rasterizer_);
   line(x0, y0, x1, y1);
   line(x1, y1, x2, y2);
   line(x2, y2, x3, y3);
@@ -188,6 +212,42 @@ void Fl_Pico_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, in
 }
 
 
+// Draws a span of the rasterizer.
+void Fl_Pico_Graphics_Driver::draw_span(void *data, int x, int y, int n, const uchar *alpha)
+{
+  Fl_Pico_Graphics_Driver *d = (Fl_Pico_Graphics_Driver*)data;
+  if (alpha) d->alpha_span(x, y, n, alpha);
+  else d->xyline(x, y, x + n - 1);
+}
+
+
+// Fills the path of r with the even-odd rule, in the visible box of its edges.
+void Fl_Pico_Graphics_Driver::fill_path(Fl_Coverage_Rasterizer &r)
+{
+  int x, y, w, h, X, Y, W, H;
+  if (!r.bounds(x, y, w, h)) return;
+  clip_box(x, y, w, h, X, Y, W, H);
+  if (W <= 0 || H <= 0) {
+    r.clear();
+    return;
+  }
+  r.rasterize(X, Y, W, H, antialias_, Fl_Coverage_Rasterizer::EVEN_ODD, draw_span, this);
+}
+
+
+/**
+ Draws \p n pixels of line \p y from \p x, with the current color blended
+ with \p alpha, from 0 (transparent) to 255 (opaque). This version draws
+ the pixels that are at least half covered: drivers that can blend should
+ override it.
+ */
+void Fl_Pico_Graphics_Driver::alpha_span(int x, int y, int n, const uchar *alpha)
+{
+  for (int i = 0; i < n; i++)
+    if (alpha[i] >= 128) point(x + i, y);
+}
+
+
 void Fl_Pico_Graphics_Driver::push_clip(int x, int y, int w, int h)
 {
 }
@@ -195,6 +255,7 @@ void Fl_Pico_Graphics_Driver::push_clip(int x, int y, int w, int h)
 
 int Fl_Pico_Graphics_Driver::clip_box(int x, int y, int w, int h, int &X, int &Y, int &W, int &H)
 {
+  X = x; Y = y; W = w; H = h;
   return 0;
 }
 
@@ -215,59 +276,56 @@ void Fl_Pico_Graphics_Driver::pop_clip()
 }
 
 
-static double px, py; // FIXME: aaaah!
-static double pxf, pyf;
-static int pn;
-
-
 void Fl_Pico_Graphics_Driver::begin_points()
 {
   what = POINT_;
-  pn = 0;
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::begin_complex_polygon()
 {
   what = POLYGON;
-  pn = 0;
+  pn_ = 0;
+  rasterizer_.clear();
 }
 
 
 void Fl_Pico_Graphics_Driver::begin_line()
 {
   what = LINE;
-  pn = 0;
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::begin_loop()
 {
   what = LOOP;
-  pn = 0;
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::begin_polygon()
 {
   what = POLYGON;
-  pn = 0;
+  pn_ = 0;
+  rasterizer_.clear();
 }
 
 
 void Fl_Pico_Graphics_Driver::transformed_vertex(double x, double y)
 {
-  if (pn>0) {
+  if (pn_>0) {
     switch (what) {
       case POINT_:  point(x, y); break;
-      case LINE:    line(px, py, x, y); break;
-      case LOOP:    line(px, py, x, y); break;
-      case POLYGON: line(px, py, x, y); break; // FIXME: fill!
+      case LINE:    line(px_, py_, x, y); break;
+      case LOOP:    line(px_, py_, x, y); break;
+      case POLYGON: rasterizer_.add_edge(px_, py_, x, y); break;
     }
   }
-  if (pn==0 ) { pxf = x; pyf = y; }
-  px = x; py = y;
-  pn++;
+  if (pn_==0 ) { pxf_ = x; pyf_ = y; }
+  px_ = x; py_ = y;
+  pn_++;
 }
 
 
@@ -279,106 +337,208 @@ void Fl_Pico_Graphics_Driver::vertex(double x, double y)
 
 void Fl_Pico_Graphics_Driver::end_points()
 {
-  pn = 0;
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::end_line()
 {
-  pn = 0;
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::end_loop()
 {
-  line(px, py, pxf, pyf);
-  pn = 0;
+  line(px_, py_, pxf_, pyf_);
+  pn_ = 0;
 }
 
 
 void Fl_Pico_Graphics_Driver::end_polygon()
 {
-  line(px, py, pxf, pyf);  // FIXME: fill!
-  pn = 0;
+  gap();
+  fill_path(rasterizer_);
 }
 
 
 void Fl_Pico_Graphics_Driver::end_complex_polygon()
 {
-  line(px, py, pxf, pyf);  // FIXME: fill!
-  pn = 0;
+  gap();
+  fill_path(rasterizer_);
 }
 
 
+// Closes the current part of a complex polygon.
 void Fl_Pico_Graphics_Driver::gap()
 {
-  pn = 0;
+  if (what == POLYGON && pn_ > 1) rasterizer_.add_edge(px_, py_, pxf_, pyf_);
+  pn_ = 0;
 }
 
 
+// Like X11, a circle is filled inside a polygon, and outlined otherwise. It
+// is not part of the polygon. Rotations and skews are ignored.
 void Fl_Pico_Graphics_Driver::circle(double x, double y, double r)
 {
-  begin_loop();
-  double X = r;
-  double Y = 0;
-  fl_vertex(x+X,y+Y);
-
-  double rx = fabs(transform_dx(r, r));
-  double ry = fabs(transform_dy(r, r));
-
-  double circ = M_PI*0.5*(rx+ry);
-  int segs = circ * 360 / 1000;  // every line is about three pixels long
-  if (segs<16) segs = 16;
-
-  double A = 2*M_PI;
-  int i = segs;
-
-  if (i) {
-    double epsilon = A/i;			// Arc length for equal-size steps
-    double cos_e = cos(epsilon);	// Rotation coefficients
-    double sin_e = sin(epsilon);
-    do {
-      double Xnew =  cos_e*X + sin_e*Y;
-      Y = -sin_e*X + cos_e*Y;
-      fl_vertex(x + (X=Xnew), y + Y);
-    } while (--i);
+  double xt = transform_x(x, y);
+  double yt = transform_y(x, y);
+  double rx = r * (m.c ? sqrt(m.a*m.a+m.c*m.c) : fabs(m.a));
+  double ry = r * (m.b ? sqrt(m.b*m.b+m.d*m.d) : fabs(m.d));
+  int llx = (int)rint(xt-rx);
+  int w = (int)rint(xt+rx)-llx;
+  int lly = (int)rint(yt-ry);
+  int h = (int)rint(yt+ry)-lly;
+  ellipse(llx, lly, w + 1, h + 1, 0, 360, what == POLYGON);
+}
+
+
+/*
+ Computes the first and last pixel of each line of the ellipse inscribed
+ in a w x h box whose center is inside the ellipse, relative to the box.
+ Empty lines get left > right.
+
+ With u = 2*x+1-w and v = 2*y+1-h, the center of pixel x, y is inside if
+ h*h*u*u + w*w*v*v <= w*w*h*h. Like the midpoint algorithm, this walks
+ the lines from the top to the middle, where the last u only increases,
+ and mirrors them below. Integers are exact in doubles for boxes up to
+ several thousands of pixels.
+ */
+static void ellipse_extents(int w, int h, int *left, int *right)
+{
+  double w2 = double(w) * w, h2 = double(h) * h, limit = w2 * h2;
+  int u = (w & 1) ? -2 : -1; // largest u that is inside, or less than 0
+  for (int y = 0; y <= (h - 1) / 2; y++) {
+    double v = 2 * y + 1 - h;
+    double rest = limit - w2 * v * v;
+    while (u + 2 <= w - 1 && h2 * (u + 2) * (u + 2) <= rest) u += 2;
+    int l = u < 0 ? 1 : (w - 1 - u) / 2;
+    int r = u < 0 ? 0 : (w - 1 + u) / 2;
+    left[y] = left[h - 1 - y] = l;
+    right[y] = right[h - 1 - y] = r;
   }
-  end_loop();
 }
 
 
-void Fl_Pico_Graphics_Driver::arc(int xi, int yi, int w, int h, double a1, double a2)
+// Returns non-zero if u, v (as in ellipse_extents()) is between the angles
+// of sector: the size of the box, and the cosine and sine of both angles.
+static int in_sector(const double *sector, int u, int v)
 {
-  if (a2<=a1) return;
+  double qx = u * sector[1], qy = -v * sector[0];
+  double c1 = sector[2] * qy - sector[3] * qx;  // > 0 if after angle 1
+  double c2 = qx * sector[5] - qy * sector[4];  // > 0 if before angle 2
+  if (sector[6] <= 180) return c1 >= 0 && c2 >= 0;
+  return !(c1 < 0 && c2 < 0);
+}
 
-  double rx = w/2.0;
-  double ry = h/2.0;
-  double x = xi + rx;
-  double y = yi + ry;
-  double circ = M_PI*0.5*(rx+ry);
-  int i, segs = circ * (a2-a1) / 1000;  // every line is about three pixels long
-  if (segs<3) segs = 3;
 
-  int px, py;
-  a1 = a1/180*M_PI;
-  a2 = a2/180*M_PI;
-  double step = (a2-a1)/segs;
+// Draws pixels x to x1 of line y of an ellipse whose box is at cx, cy, with
+// only the pixels that are inside sector if it is not NULL.
+void Fl_Pico_Graphics_Driver::span(int x, int y, int x1, int cx, int cy, const double *sector)
+{
+  if (!sector) {
+    xyline(x, y, x1);
+    return;
+  }
+  int w = (int)sector[0], h = (int)sector[1];
+  int v = 2 * (y - cy) + 1 - h;
+  int start = -1;
+  for (int i = x; i <= x1; i++) {
+    if (in_sector(sector, 2 * (i - cx) + 1 - w, v)) {
+      if (start < 0) start = i;
+    } else if (start >= 0) {
+      xyline(start, y, i - 1);
+      start = -1;
+    }
+  }
+  if (start >= 0) xyline(start, y, x1);
+}
+
 
-  int nx = x + sin(a1)*rx;
-  int ny = y - cos(a1)*ry;
-  for (i=segs; i>0; i--) {
-    a1+=step;
-    px = nx; py = ny;
-    nx = x + sin(a1)*rx;
-    ny = y - cos(a1)*ry;
-    line(px, py, nx, ny);
+/*
+ Draws the part of an ellipse from angle a1 to a2, in degrees counter
+ clockwise from 3 o'clock, filled with its center or outlined. The outline
+ is made of the pixels of the filled ellipse that have a neighbor outside.
+ With antialiasing, filled ellipses are drawn as fine polygons.
+ */
+void Fl_Pico_Graphics_Driver::ellipse(int x, int y, int w, int h, double a1, double a2, int fill)
+{
+  if (w <= 0 || h <= 0 || a2 <= a1 || !not_clipped(x, y, w + 1, h + 1)) return;
+  int full = (a2 - a1 >= 360);
+  if (fill && antialias_) {
+    double rx = w / 2.0, ry = h / 2.0, cx = x + rx, cy = y + ry;
+    int segs = int((rx + ry) * (a2 - a1) / 90) + 8;
+    double a = a1 * M_PI / 180, step = (a2 - a1) * M_PI / 180 / segs;
+    double x0 = cx + cos(a) * rx, y0 = cy - sin(a) * ry, xs = x0, ys = y0;
+    Fl_Coverage_Rasterizer r;  // circles may be drawn inside polygons
+    for (int i = 1; i <= segs; i++) {
+      double x1 = cx + cos(a + i * step) * rx, y1 = cy - sin(a + i * step) * ry;
+      r.add_edge(x0, y0, x1, y1);
+      x0 = x1; y0 = y1;
+    }
+    if (!full) {
+      r.add_edge(x0, y0, cx, cy);
+      r.add_edge(cx, cy, xs, ys);
+    } else {
+      r.add_edge(x0, y0, xs, ys);
+    }
+    fill_path(r);
+    return;
   }
+  double sector[7];
+  if (!full) {
+    sector[0] = w;
+    sector[1] = h;
+    sector[2] = cos(a1 * M_PI / 180);
+    sector[3] = sin(a1 * M_PI / 180);
+    sector[4] = cos(a2 * M_PI / 180);
+    sector[5] = sin(a2 * M_PI / 180);
+    sector[6] = a2 - a1;
+    // right angles must give exact axes, or their pixels would be random
+    for (int i = 2; i < 6; i++) if (fabs(sector[i]) < 1e-12) sector[i] = 0;
+  }
+  const double *s = full ? 0 : sector;
+  int X, Y, W, H;
+  clip_box(x, y, w, h, X, Y, W, H);
+  if (W <= 0 || H <= 0) return;
+  int *left = new int[2 * h], *right = left + h;
+  ellipse_extents(w, h, left, right);
+  for (int r = Y - y; r < Y - y + H; r++) {
+    int l = left[r], rr = right[r];
+    if (l > rr) continue;
+    if (fill) {
+      span(x + l, y + r, x + rr, x, y, s);
+      continue;
+    }
+    // the pixels that are inside, with both vertical neighbors inside
+    int a = l + 1, b = rr - 1;
+    if (r == 0 || r == h - 1) {
+      b = a - 1;
+    } else {
+      if (left[r - 1] > a) a = left[r - 1];
+      if (left[r + 1] > a) a = left[r + 1];
+      if (right[r - 1] < b) b = right[r - 1];
+      if (right[r + 1] < b) b = right[r + 1];
+    }
+    if (a > b) {
+      span(x + l, y + r, x + rr, x, y, s);
+    } else {
+      if (l < a) span(x + l, y + r, x + a - 1, x, y, s);
+      if (b < rr) span(x + b + 1, y + r, x + rr, x, y, s);
+    }
+  }
+  delete[] left;
+}
+
+
+void Fl_Pico_Graphics_Driver::arc(int x, int y, int w, int h, double a1, double a2)
+{
+  ellipse(x, y, w, h, a1, a2, 0);
 }
 
 
 void Fl_Pico_Graphics_Driver::pie(int x, int y, int w, int h, double a1, double a2)
 {
-  // FIXME: implement this
+  ellipse(x, y, w, h, a1, a2, 1);
 }
 
 
@@ -472,6 +632,7 @@ int Fl_Pico_Graphics_Driver::height() {
 
 void Fl_Pico_Graphics_Driver::draw(const char *str, int n, int x, int y)
 {
+  if (!not_clipped(x - 1, y - size_ - 1, (n + 2) * size_ / 2 + 2, 2 * size_ + 2)) return;
   int i;
   for (i=0; i<n; i++) {
     char c = str[i] & 0x7f;
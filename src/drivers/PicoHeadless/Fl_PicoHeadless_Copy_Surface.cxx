@@ -0,0 +1,61 @@
+//
+// "$Id$"
+//
+// Copy-to-clipboard code of the headless backend for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_Graphics_Driver.H"
+#include <FL/Fl_Copy_Surface.H>
+
+// The clipboard of the headless backend only holds text: drawings go to a
+// buffer that is dropped with the surface.
+class Fl_PicoHeadless_Copy_Surface_Driver : public Fl_Copy_Surface_Driver {
+  Fl_PicoHeadless_Buffer *buffer;
+public:
+  Fl_PicoHeadless_Copy_Surface_Driver(int w, int h);
+  ~Fl_PicoHeadless_Copy_Surface_Driver();
+  void translate(int x, int y);
+  void untranslate();
+};
+
+Fl_Copy_Surface_Driver *Fl_Copy_Surface_Driver::newCopySurfaceDriver(int w, int h)
+{
+  return new Fl_PicoHeadless_Copy_Surface_Driver(w, h);
+}
+
+Fl_PicoHeadless_Copy_Surface_Driver::Fl_PicoHeadless_Copy_Surface_Driver(int w, int h) : Fl_Copy_Surface_Driver(w, h) {
+  buffer = new Fl_PicoHeadless_Buffer(w, h);
+  Fl_PicoHeadless_Graphics_Driver *d = new Fl_PicoHeadless_Graphics_Driver();
+  d->buffer(buffer);
+  driver(d);
+}
+
+Fl_PicoHeadless_Copy_Surface_Driver::~Fl_PicoHeadless_Copy_Surface_Driver() {
+  delete driver();
+  delete buffer;
+}
+
+void Fl_PicoHeadless_Copy_Surface_Driver::translate(int x, int y) {
+  ((Fl_PicoHeadless_Graphics_Driver*)driver())->translate_all(x, y);
+}
+
+void Fl_PicoHeadless_Copy_Surface_Driver::untranslate() {
+  ((Fl_PicoHeadless_Graphics_Driver*)driver())->untranslate_all();
+}
+
+//
+// End of "$Id$".
+//
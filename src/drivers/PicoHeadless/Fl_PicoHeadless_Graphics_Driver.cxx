@@ -0,0 +1,636 @@
+//
+// "$Id$"
+//
+// Pico headless graphics driver for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_Graphics_Driver.H"
+#include "../../Fl_Display_List.H"
+
+#include <FL/Fl.H>
+#include <FL/platform.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Bitmap.H>
+#include <FL/Fl_Pixmap.H>
+#include <FL/headless.H>
+#include <FL/fl_draw.H>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+
+#if defined(USE_HEADLESS)
+/*
+ By linking this module, the following static method will instantiate the
+ PicoHeadless Graphics driver as the main display driver.
+ */
+Fl_Graphics_Driver *Fl_Graphics_Driver::newMainGraphicsDriver()
+{
+  return new Fl_PicoHeadless_Graphics_Driver();
+}
+#endif // USE_HEADLESS
+
+
+/** Creates an opaque black buffer. */
+Fl_PicoHeadless_Buffer::Fl_PicoHeadless_Buffer(int W, int H)
+{
+  pixels = 0;
+  w = h = 0;
+  resize(W, H);
+}
+
+
+Fl_PicoHeadless_Buffer::~Fl_PicoHeadless_Buffer()
+{
+  free(pixels);
+}
+
+
+/** Changes the size of the buffer, keeping the pixels that remain visible. */
+void Fl_PicoHeadless_Buffer::resize(int W, int H)
+{
+  if (W < 1) W = 1;
+  if (H < 1) H = 1;
+  if (W == w && H == h) return;
+  uchar *p = (uchar*)calloc((size_t)W * H, 4);
+  for (size_t i = 3; i < (size_t)W * H * 4; i += 4) p[i] = 0xff;
+  int cw = W < w ? W : w, ch = H < h ? H : h;
+  for (int y = 0; y < ch; y++)
+    memcpy(p + (size_t)y * W * 4, pixel(0, y), cw * 4);
+  free(pixels);
+  pixels = p;
+  w = W;
+  h = H;
+}
+
+
+int Fl_PicoHeadless_Graphics_Driver::antialias_default = 0;
+
+
+Fl_PicoHeadless_Graphics_Driver::Fl_PicoHeadless_Graphics_Driver()
+{
+  antialias(antialias_default);
+  buffer_ = 0;
+  offset_x_ = offset_y_ = 0;
+  depth_ = 0;
+  clip_n_ = 0;
+  rgba_[0] = rgba_[1] = rgba_[2] = 0;
+  rgba_[3] = 0xff;
+}
+
+
+/** Makes the driver draw into \p b, and resets the clip stack. */
+void Fl_PicoHeadless_Graphics_Driver::buffer(Fl_PicoHeadless_Buffer *b)
+{
+  buffer_ = b;
+  clip_n_ = 0;
+  limit_.set(0, 0, b ? b->w : 0, b ? b->h : 0);
+  clip_[0] = limit_;
+}
+
+
+/**
+ Keeps all drawing inside the box \p x, \p y, \p w, \p h of the buffer, even
+ without clip, until the next call of buffer(), and resets the clip stack.
+ Drivers that share a buffer can so draw separate parts of it in parallel.
+ */
+void Fl_PicoHeadless_Graphics_Driver::limit(int x, int y, int w, int h)
+{
+  limit_.set(0, 0, buffer_ ? buffer_->w : 0, buffer_ ? buffer_->h : 0);
+  limit_.intersect(x, y, w, h);
+  clip_n_ = 0;
+  clip_[0] = limit_;
+}
+
+
+// Fills n pixels from p with the current color. Long spans copy their start
+// to the rest in doubling blocks, so that memcpy() does most of the work
+// with the widest stores of the processor.
+void Fl_PicoHeadless_Graphics_Driver::fill_span(uchar *p, size_t n)
+{
+  size_t size = n * 4;
+  size_t done = size < 64 ? size : 32;
+  for (size_t i = 0; i < done; i += 4) memcpy(p + i, rgba_, 4);
+  while (done < size) {
+    size_t block = done < size - done ? done : size - done;
+    memcpy(p + done, p, block);
+    done += block;
+  }
+}
+
+
+// Blends the current color with n pixels of line y, with the opacity of alpha.
+void Fl_PicoHeadless_Graphics_Driver::alpha_span(int x, int y, int n, const uchar *alpha)
+{
+  x += offset_x_;
+  y += offset_y_;
+  const int *edges;
+  int spans = clip_[clip_n_].spans(y, edges);
+  for (int k = 0; k < spans; k++, edges += 2) {
+    int i = edges[0] > x ? edges[0] - x : 0;
+    int end = edges[1] < x + n ? edges[1] - x : n;
+    if (i < end) Fl_Coverage_Rasterizer::blend(buffer_->pixel(x + i, y), end - i, alpha + i, rgba_);
+  }
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::point(int x, int y)
+{
+  x += offset_x_;
+  y += offset_y_;
+  if (!clip_[clip_n_].contains(x, y)) return;
+  memcpy(buffer_->pixel(x, y), rgba_, 4);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::rectf(int x, int y, int w, int h)
+{
+  x += offset_x_;
+  y += offset_y_;
+  Fl_Banded_Region::Iterator it(clip_[clip_n_], x, y, w, h);
+  int X, Y, W, H;
+  while (it.next(X, Y, W, H)) {
+    if (W == buffer_->w) {  // whole lines are a single span
+      fill_span(buffer_->pixel(0, Y), (size_t)W * H);
+      continue;
+    }
+    for (int i = 0; i < H; i++) fill_span(buffer_->pixel(X, Y + i), W);
+  }
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::xyline(int x, int y, int x1)
+{
+  if (x1 < x) { int t = x; x = x1; x1 = t; }
+  rectf(x, y, x1 - x + 1, 1);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::yxline(int x, int y, int y1)
+{
+  if (y1 < y) { int t = y; y = y1; y1 = t; }
+  rectf(x, y, 1, y1 - y + 1);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::color(Fl_Color c)
+{
+  Fl_Graphics_Driver::color(c);
+  Fl::get_color(c, rgba_[0], rgba_[1], rgba_[2]);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::color(uchar r, uchar g, uchar b)
+{
+  Fl_Graphics_Driver::color(fl_rgb_color(r, g, b));
+  rgba_[0] = r;
+  rgba_[1] = g;
+  rgba_[2] = b;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::push_clip(int x, int y, int w, int h)
+{
+  if (clip_n_ >= FL_REGION_STACK_SIZE - 1) {
+    Fl::warning("Fl_PicoHeadless_Graphics_Driver::push_clip: clip stack overflow!\n");
+    return;
+  }
+  clip_[clip_n_ + 1] = clip_[clip_n_];
+  clip_[++clip_n_].intersect(x + offset_x_, y + offset_y_, w, h);
+  if (rstackptr < region_stack_max) rstack[++rstackptr] = 0;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::push_no_clip()
+{
+  if (clip_n_ >= FL_REGION_STACK_SIZE - 1) {
+    Fl::warning("Fl_PicoHeadless_Graphics_Driver::push_no_clip: clip stack overflow!\n");
+    return;
+  }
+  clip_[++clip_n_] = limit_;
+  if (rstackptr < region_stack_max) rstack[++rstackptr] = 0;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::pop_clip()
+{
+  if (clip_n_ > 0) clip_n_--;
+  if (rstackptr > 0) {
+    if (rstack[rstackptr]) XDestroyRegion(rstack[rstackptr]);
+    rstackptr--;
+  }
+}
+
+
+/**
+ Replaces the current clip with \p r, which the driver keeps, or with the
+ whole buffer if \p r is NULL, inside the limit(). Fl_Window::flush() calls
+ this with the damaged region of the window.
+ */
+void Fl_PicoHeadless_Graphics_Driver::clip_region(Fl_Region r)
+{
+  Fl_Graphics_Driver::clip_region(r);
+  Fl_Banded_Region &c = clip_[clip_n_];
+  c = limit_;
+  if (r) {
+    Fl_Banded_Region region(*(Fl_Banded_Region*)r);
+    region.translate(offset_x_, offset_y_);
+    c.intersect(region);
+  }
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::add_rectangle_to_region(Fl_Region r, int x, int y, int w, int h)
+{
+  ((Fl_Banded_Region*)r)->unite(x, y, w, h);
+}
+
+
+Fl_Region Fl_PicoHeadless_Graphics_Driver::XRectangleRegion(int x, int y, int w, int h)
+{
+  return (Fl_Region)new Fl_Banded_Region(x, y, w, h);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::XDestroyRegion(Fl_Region r)
+{
+  delete (Fl_Banded_Region*)r;
+}
+
+
+// Like clip_box(), in the coordinates of the buffer.
+int Fl_PicoHeadless_Graphics_Driver::clip_device(int x, int y, int w, int h,
+                                                 int &X, int &Y, int &W, int &H)
+{
+  const Fl_Banded_Region &c = clip_[clip_n_];
+  int cx, cy, cw, ch;
+  c.extents(cx, cy, cw, ch);
+  int r = x + w, b = y + h;
+  X = x > cx ? x : cx;
+  Y = y > cy ? y : cy;
+  W = (r < cx + cw ? r : cx + cw) - X;
+  H = (b < cy + ch ? b : cy + ch) - Y;
+  int in = (W > 0 && H > 0) ? (c.is_rect() ? 1 : c.rect_in(x, y, w, h)) : 0;
+  if (!in) {
+    W = H = 0;
+    return 1;
+  }
+  return X != x || Y != y || W != w || H != h || in == 2;
+}
+
+
+int Fl_PicoHeadless_Graphics_Driver::clip_box(int x, int y, int w, int h,
+                                              int &X, int &Y, int &W, int &H)
+{
+  int ret = clip_device(x + offset_x_, y + offset_y_, w, h, X, Y, W, H);
+  X -= offset_x_;
+  Y -= offset_y_;
+  return ret;
+}
+
+
+int Fl_PicoHeadless_Graphics_Driver::not_clipped(int x, int y, int w, int h)
+{
+  int X, Y, W, H;
+  if (!clip_box(x, y, w, h, X, Y, W, H)) return 1; // entirely visible
+  return W > 0 ? 2 : 0;
+}
+
+
+// Draws w pixels that are delta bytes apart, gray if mono is set,
+// and blended with their last byte if alpha is set.
+void Fl_PicoHeadless_Graphics_Driver::draw_line(const uchar *from, int delta, int mono,
+                                                int alpha, uchar *to, int w)
+{
+  for (; w > 0; w--, from += delta, to += 4) {
+    uchar r = from[0], g = mono ? r : from[1], b = mono ? r : from[2];
+    if (alpha) {
+      unsigned a = from[delta - 1];
+      if (a == 0) continue;
+      if (a != 255) {
+        r = uchar((r * a + to[0] * (255 - a) + 127) / 255);
+        g = uchar((g * a + to[1] * (255 - a) + 127) / 255);
+        b = uchar((b * a + to[2] * (255 - a) + 127) / 255);
+      }
+    }
+    to[0] = r;
+    to[1] = g;
+    to[2] = b;
+  }
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_pixels(const uchar *buf, int X, int Y, int W, int H,
+                                                  int D, int L, int mono, int alpha)
+{
+  if (!L) L = W * D;
+  X += offset_x_;
+  Y += offset_y_;
+  Fl_Banded_Region::Iterator it(clip_[clip_n_], X, Y, W, H);
+  int cx, cy, cw, ch;
+  while (it.next(cx, cy, cw, ch)) {
+    const uchar *from = buf + (cy - Y) * L + (cx - X) * D;
+    for (int y = 0; y < ch; y++, from += L)
+      draw_line(from, D, mono, alpha, buffer_->pixel(cx, cy + y), cw);
+  }
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_image(const uchar* buf, int X, int Y, int W, int H,
+                                                 int D, int L)
+{
+  draw_pixels(buf, X, Y, W, H, D, L, abs(D) < 3, 0);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_image_mono(const uchar* buf, int X, int Y, int W, int H,
+                                                      int D, int L)
+{
+  draw_pixels(buf, X, Y, W, H, D, L, 1, 0);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_image(Fl_Draw_Image_Cb cb, void* data,
+                                                 int X, int Y, int W, int H, int D)
+{
+  uchar *line = new uchar[W * D];
+  for (int y = 0; y < H; y++) {
+    cb(data, 0, y, W, line);
+    draw_pixels(line, X, Y + y, W, 1, D, 0, D < 3, 0);
+  }
+  delete[] line;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_image_mono(Fl_Draw_Image_Cb cb, void* data,
+                                                      int X, int Y, int W, int H, int D)
+{
+  uchar *line = new uchar[W * D];
+  for (int y = 0; y < H; y++) {
+    cb(data, 0, y, W, line);
+    draw_pixels(line, X, Y + y, W, 1, D, 0, 1, 0);
+  }
+  delete[] line;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_rgb(Fl_RGB_Image *img, int XP, int YP, int WP, int HP,
+                                               int cx, int cy)
+{
+  if (!img->d() || !img->array) {
+    Fl_Graphics_Driver::draw_empty(img, XP, YP);
+    return;
+  }
+  if (img->data_w() != img->w() || img->data_h() != img->h()) {
+    Fl_RGB_Image *scaled = (Fl_RGB_Image*)img->copy(img->w(), img->h());
+    draw_rgb(scaled, XP, YP, WP, HP, cx, cy);
+    delete scaled;
+    return;
+  }
+  int X, Y, W, H;
+  if (start_image(img, XP, YP, WP, HP, cx, cy, X, Y, W, H)) return;
+  int d = img->d(), ld = img->ld() ? img->ld() : img->w() * d;
+  draw_pixels(img->array + cy * ld + cx * d, X, Y, W, H, d, ld, d < 3, !(d & 1));
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_pixmap(Fl_Pixmap *pxm, int XP, int YP, int WP, int HP,
+                                                  int cx, int cy)
+{
+  Fl_RGB_Image rgb(pxm);
+  draw_rgb(&rgb, XP, YP, WP, HP, cx, cy);
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::draw_bitmap(Fl_Bitmap *bm, int XP, int YP, int WP, int HP,
+                                                  int cx, int cy)
+{
+  if (bm->data_w() != bm->w() || bm->data_h() != bm->h()) {
+    Fl_Bitmap *scaled = (Fl_Bitmap*)bm->copy(bm->w(), bm->h());
+    draw_bitmap(scaled, XP, YP, WP, HP, cx, cy);
+    delete scaled;
+    return;
+  }
+  int X, Y, W, H;
+  if (start_image(bm, XP, YP, WP, HP, cx, cy, X, Y, W, H)) return;
+  int bytes_per_line = (bm->w() + 7) / 8;
+  for (int y = 0; y < H; y++) {
+    const uchar *line = bm->array + (cy + y) * bytes_per_line;
+    for (int x = 0; x < W; x++) {
+      int bx = cx + x;
+      if (line[bx >> 3] & (1 << (bx & 7))) point(X + x, Y + y);
+    }
+  }
+}
+
+
+/** Adds \p dx, \p dy to the offset between the coordinates of the buffer
+ and those of drawing; untranslate_all() restores the previous offset. */
+void Fl_PicoHeadless_Graphics_Driver::translate_all(int dx, int dy)
+{
+  if (depth_ < FL_PICOHEADLESS_TRANSLATION_STACK_SIZE) {
+    stack_x_[depth_] = offset_x_;
+    stack_y_[depth_] = offset_y_;
+    depth_++;
+  } else {
+    Fl::warning("%s: translate stack overflow!", "Fl_PicoHeadless_Graphics_Driver");
+  }
+  offset_x_ += dx;
+  offset_y_ += dy;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::untranslate_all()
+{
+  if (depth_ > 0) depth_--;
+  offset_x_ = stack_x_[depth_];
+  offset_y_ = stack_y_[depth_];
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::copy_offscreen(int x, int y, int w, int h,
+                                                     Fl_Offscreen pixmap, int srcx, int srcy)
+{
+  Fl_PicoHeadless_Buffer *src = (Fl_PicoHeadless_Buffer*)pixmap;
+  if (!src) return;
+  // the part of the source that exists
+  if (srcx < 0) { x -= srcx; w += srcx; srcx = 0; }
+  if (srcy < 0) { y -= srcy; h += srcy; srcy = 0; }
+  if (srcx + w > src->w) w = src->w - srcx;
+  if (srcy + h > src->h) h = src->h - srcy;
+  x += offset_x_;
+  y += offset_y_;
+  Fl_Banded_Region::Iterator it(clip_[clip_n_], x, y, w, h);
+  int X, Y, W, H;
+  while (it.next(X, Y, W, H)) {
+    for (int i = 0; i < H; i++)
+      memmove(buffer_->pixel(X, Y + i), src->pixel(srcx + X - x, srcy + Y - y + i), W * 4);
+  }
+}
+
+
+// the tiles that the threads share
+struct Tile_Job {
+  const Fl_Display_List *list;
+  Fl_PicoHeadless_Buffer *buffer;
+  int size, columns, count;
+  int next;             // the first tile that no thread has taken
+  int antialias;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t mutex;
+#endif
+};
+
+// Draws tiles until none is left.
+static void *draw_tiles_cb(void *data) {
+  Tile_Job *job = (Tile_Job*)data;
+  for (;;) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&job->mutex);
+#endif
+    int tile = job->next++;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&job->mutex);
+#endif
+    if (tile >= job->count) break;
+    // a driver of its own, so that the state of other tiles doesn't leak in
+    Fl_PicoHeadless_Graphics_Driver *d = new Fl_PicoHeadless_Graphics_Driver();
+    d->antialias(job->antialias);
+    d->buffer(job->buffer);
+    d->limit((tile % job->columns) * job->size, (tile / job->columns) * job->size,
+             job->size, job->size);
+    job->list->replay(d);
+    delete d;
+  }
+  return 0;
+}
+
+
+/**
+ Replays \p list into the buffer of the driver, in tiles of \p tile_size
+ pixels that \p threads threads take in turn, or as many threads as there
+ are processors if \p threads is 0. The calling thread draws tiles too.
+ The tiles are drawn with the antialiasing of this driver.
+ */
+void Fl_PicoHeadless_Graphics_Driver::draw_tiles(const Fl_Display_List *list,
+                                                 int tile_size, int threads)
+{
+  if (!buffer_ || !list->calls()) return;
+  Tile_Job job;
+  job.list = list;
+  job.buffer = buffer_;
+  job.next = 0;
+  job.antialias = antialias();
+  int n = 1;
+#ifdef HAVE_PTHREAD
+  n = threads;
+#  ifdef _SC_NPROCESSORS_ONLN
+  if (n <= 0) n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#  endif
+#endif
+  // each tile replays all the drawing, so that a single thread draws
+  // everything at once
+  job.size = n > 1 ? tile_size : (buffer_->w > buffer_->h ? buffer_->w : buffer_->h);
+  if (job.size < 1) job.size = 1;
+  job.columns = (buffer_->w + job.size - 1) / job.size;
+  job.count = job.columns * ((buffer_->h + job.size - 1) / job.size);
+#ifdef HAVE_PTHREAD
+  if (n > job.count) n = job.count;
+  pthread_mutex_init(&job.mutex, 0);
+  pthread_t *tids = n > 1 ? new pthread_t[n - 1] : 0;
+  int started = 0;
+  for (int i = 1; i < n; i++) {
+    if (!pthread_create(tids + started, 0, draw_tiles_cb, &job)) started++;
+  }
+  draw_tiles_cb(&job);
+  for (int i = 0; i < started; i++) pthread_join(tids[i], 0);
+  delete[] tids;
+  pthread_mutex_destroy(&job.mutex);
+#else
+  draw_tiles_cb(&job);
+#endif
+}
+
+
+#if defined(USE_HEADLESS)
+
+// The Pico driver draws all text with its own stroke font, so these names
+// only name the fonts. They are those of the Xft built-in fonts.
+static Fl_Fontdesc built_in_table[] = {
+  {" sans"},
+  {"Bsans"},
+  {"Isans"},
+  {"Psans"},
+  {" mono"},
+  {"Bmono"},
+  {"Imono"},
+  {"Pmono"},
+  {" serif"},
+  {"Bserif"},
+  {"Iserif"},
+  {"Pserif"},
+  {" symbol"},
+  {" screen"},
+  {"Bscreen"},
+  {" zapf dingbats"},
+};
+
+Fl_Fontdesc* fl_fonts = built_in_table;
+
+
+const char *Fl_PicoHeadless_Graphics_Driver::font_name(int num)
+{
+  return fl_fonts[num].name;
+}
+
+
+void Fl_PicoHeadless_Graphics_Driver::font_name(int num, const char *name)
+{
+  Fl_Fontdesc *s = fl_fonts + num;
+  s->name = name;
+  s->fontname[0] = 0;
+  s->first = 0;
+}
+
+
+void fl_rectf(int x, int y, int w, int h, uchar r, uchar g, uchar b)
+{
+  fl_color(r, g, b);
+  fl_rectf(x, y, w, h);
+}
+
+
+/**
+ Turns antialiasing of filled polygons, pies and circles on or off, for
+ windows and for the offscreens and image surfaces created after this call.
+ It is off by default, so that the pixels are the same as those of X11.
+ */
+void fl_headless_antialias(int on)
+{
+  Fl_PicoHeadless_Graphics_Driver::antialias_default = on;
+  ((Fl_PicoHeadless_Graphics_Driver*)&Fl_Graphics_Driver::default_driver())->antialias(on);
+}
+
+#endif // USE_HEADLESS
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,121 @@
+//
+// "$Id$"
+//
+// Draw-to-image code of the headless backend for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_Graphics_Driver.H"
+#include "../../Fl_Display_List.H"
+#include <FL/Fl_Image_Surface.H>
+#include <FL/platform.H>
+#include "../../Fl_Screen_Driver.H"
+
+// The offscreen of the surface is a Fl_PicoHeadless_Buffer. In tiled mode,
+// the surface records the drawing, and draws it in tiles with several
+// threads when image() is called or the surface stops being current.
+class Fl_PicoHeadless_Image_Surface_Driver : public Fl_Image_Surface_Driver {
+  virtual void end_current_();
+  Fl_PicoHeadless_Graphics_Driver *pixels_;  // draws into the offscreen
+  Fl_Display_List *list_;                    // the drawing of the tiled mode
+  int tile_size_, threads_;
+  void draw_tiles();
+public:
+  Window pre_window;
+  Fl_PicoHeadless_Image_Surface_Driver(int w, int h, int high_res, Fl_Offscreen off);
+  ~Fl_PicoHeadless_Image_Surface_Driver();
+  void set_current();
+  void translate(int x, int y);
+  void untranslate();
+  Fl_RGB_Image *image();
+  int tiled(int tile_size, int threads);
+};
+
+Fl_Image_Surface_Driver *Fl_Image_Surface_Driver::newImageSurfaceDriver(int w, int h, int high_res, Fl_Offscreen off)
+{
+  return new Fl_PicoHeadless_Image_Surface_Driver(w, h, high_res, off);
+}
+
+Fl_PicoHeadless_Image_Surface_Driver::Fl_PicoHeadless_Image_Surface_Driver(int w, int h, int high_res, Fl_Offscreen off) : Fl_Image_Surface_Driver(w, h, high_res, off) {
+  if (!off) offscreen = (Fl_Offscreen)new Fl_PicoHeadless_Buffer(w, h);
+  pixels_ = new Fl_PicoHeadless_Graphics_Driver();
+  pixels_->buffer((Fl_PicoHeadless_Buffer*)offscreen);
+  driver(pixels_);
+  list_ = 0;
+  tile_size_ = threads_ = 0;
+}
+
+Fl_PicoHeadless_Image_Surface_Driver::~Fl_PicoHeadless_Image_Surface_Driver() {
+  if (offscreen && !external_offscreen) delete (Fl_PicoHeadless_Buffer*)offscreen;
+  if (list_) {
+    delete driver();
+    delete list_;
+  }
+  delete pixels_;
+}
+
+void Fl_PicoHeadless_Image_Surface_Driver::set_current() {
+  Fl_Surface_Device::set_current();
+  pre_window = fl_window;
+  fl_window = offscreen;
+}
+
+void Fl_PicoHeadless_Image_Surface_Driver::translate(int x, int y) {
+  if (list_) ((Fl_Display_List_Driver*)driver())->translate_all(x, y);
+  else pixels_->translate_all(x, y);
+}
+
+void Fl_PicoHeadless_Image_Surface_Driver::untranslate() {
+  if (list_) ((Fl_Display_List_Driver*)driver())->untranslate_all();
+  else pixels_->untranslate_all();
+}
+
+int Fl_PicoHeadless_Image_Surface_Driver::tiled(int tile_size, int threads) {
+  if (!offscreen) return 0;
+  if (!list_) {
+    list_ = new Fl_Display_List();
+    driver(new Fl_Display_List_Driver(list_, pixels_));
+  }
+  tile_size_ = tile_size > 0 ? tile_size : 256;
+  threads_ = threads;
+  return 1;
+}
+
+// Draws the recorded drawing into the offscreen, and forgets it.
+void Fl_PicoHeadless_Image_Surface_Driver::draw_tiles() {
+  if (!list_) return;
+  pixels_->draw_tiles(list_, tile_size_, threads_);
+  list_->clear();
+}
+
+Fl_RGB_Image* Fl_PicoHeadless_Image_Surface_Driver::image()
+{
+  draw_tiles();
+  Window save = fl_window;
+  fl_window = offscreen;
+  Fl_RGB_Image *image = Fl::screen_driver()->read_win_rectangle(0, 0, width, height);
+  fl_window = save;
+  return image;
+}
+
+void Fl_PicoHeadless_Image_Surface_Driver::end_current_()
+{
+  draw_tiles();
+  fl_window = pre_window;
+}
+
+//
+// End of "$Id$".
+//
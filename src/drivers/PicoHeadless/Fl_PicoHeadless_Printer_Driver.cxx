@@ -0,0 +1,40 @@
+//
+// "$Id$"
+//
+// Printing support for the Pico headless driver of the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems to:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "../../config_lib.h"
+
+#if defined(FL_CFG_PRN_PS) && !defined(FL_NO_PRINT_SUPPORT)
+
+#include <FL/Fl_PostScript.H>
+#include <FL/Fl_Printer.H>
+
+/*
+ There is no printer dialog without a display: Fl_Printer::begin_job() of
+ this driver returns 1, as if the user had cancelled the job. Headless
+ programs produce PostScript with Fl_PostScript_File_Device::begin_job(FILE*).
+ */
+Fl_Paged_Device* Fl_Printer::newPrinterDriver(void)
+{
+  return new Fl_PostScript_File_Device();
+}
+
+#endif // defined(FL_CFG_PRN_PS) && !defined(FL_NO_PRINT_SUPPORT)
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,357 @@
+//
+// "$Id$"
+//
+// Screen and event loop of the headless backend for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_Screen_Driver.H"
+#include "Fl_PicoHeadless_System_Driver.H"
+#include "Fl_PicoHeadless_Graphics_Driver.H"
+
+#include <FL/Fl.H>
+#include <FL/platform.H>
+#include <FL/Fl_Window.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Trace.H>
+#include <FL/headless.H>
+#include <sys/time.h>
+#include <string.h>
+
+
+Window fl_window;
+
+int Fl_PicoHeadless_Screen_Driver::screen_w = 1024;
+int Fl_PicoHeadless_Screen_Driver::screen_h = 768;
+int Fl_PicoHeadless_Screen_Driver::mouse_x = 0;
+int Fl_PicoHeadless_Screen_Driver::mouse_y = 0;
+
+
+Fl_Screen_Driver* Fl_Screen_Driver::newScreenDriver()
+{
+  return new Fl_PicoHeadless_Screen_Driver();
+}
+
+
+Fl_PicoHeadless_Screen_Driver::Fl_PicoHeadless_Screen_Driver()
+{
+}
+
+
+Fl_PicoHeadless_Screen_Driver::~Fl_PicoHeadless_Screen_Driver()
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Timeouts are stored in a sorted list (*first_timeout), so only the
+// first one needs to be checked to see if any should be called.
+// Allocated, but unused (free) Timeout structs are stored in another
+// linked list (*free_timeout).
+
+struct Timeout {
+  double time;
+  void (*cb)(void*);
+  void* arg;
+  Timeout* next;
+};
+static Timeout* first_timeout, *free_timeout;
+
+// I avoid the overhead of getting the current time when we have no
+// timeouts by setting this flag instead of getting the time.
+// In this case calling elapse_timeouts() does nothing, but records
+// the current time, and the next call will actually elapse time.
+static char reset_clock = 1;
+
+static void elapse_timeouts() {
+  static struct timeval prevclock;
+  struct timeval newclock;
+  gettimeofday(&newclock, NULL);
+  double elapsed = newclock.tv_sec - prevclock.tv_sec +
+    (newclock.tv_usec - prevclock.tv_usec)/1000000.0;
+  prevclock.tv_sec = newclock.tv_sec;
+  prevclock.tv_usec = newclock.tv_usec;
+  if (reset_clock) {
+    reset_clock = 0;
+  } else if (elapsed > 0) {
+    for (Timeout* t = first_timeout; t; t = t->next) t->time -= elapsed;
+  }
+}
+
+// Continuously-adjusted error value, this is a number <= 0 for how late
+// we were at calling the last timeout.
+static double missed_timeout_by;
+
+
+double Fl_PicoHeadless_Screen_Driver::wait(double time_to_wait)
+{
+  static char in_idle;
+
+  if (first_timeout) {
+    elapse_timeouts();
+    Timeout *t;
+    while ((t = first_timeout)) {
+      if (t->time > 0) break;
+      // The first timeout in the array has expired.
+      missed_timeout_by = t->time;
+      // We must remove timeout from array before doing the callback:
+      void (*cb)(void*) = t->cb;
+      void *argp = t->arg;
+      first_timeout = t->next;
+      t->next = free_timeout;
+      free_timeout = t;
+      // Now it is safe for the callback to do add_timeout:
+      double t0 = Fl_Stats::start();
+      Fl_Trace::begin("timeout", "timer");
+      cb(argp);
+      Fl_Trace::end();
+      Fl_Stats::stop(FL_STATS_TIMEOUT, t0);
+    }
+  } else {
+    reset_clock = 1; // we are not going to check the clock
+  }
+  Fl::run_checks();
+  if (Fl::idle) {
+    if (!in_idle) {
+      in_idle = 1;
+      Fl::idle();
+      in_idle = 0;
+    }
+    // the idle function may turn off idle, we can then wait:
+    if (Fl::idle) time_to_wait = 0.0;
+  }
+  if (first_timeout && first_timeout->time < time_to_wait)
+    time_to_wait = first_timeout->time;
+  // windows are always redrawn before waiting, so that the program
+  // reads up to date pixels after Fl::check() or Fl::wait()
+  Fl::flush();
+  if (time_to_wait < 0.0) time_to_wait = 0.0;
+  if (Fl::idle && !in_idle) // 'idle' may have been set within flush()
+    time_to_wait = 0.0;
+  return Fl_PicoHeadless_System_Driver::poll_with_delay(time_to_wait);
+}
+
+
+int Fl_PicoHeadless_Screen_Driver::ready()
+{
+  if (first_timeout) {
+    elapse_timeouts();
+    if (first_timeout->time <= 0) return 1;
+  } else {
+    reset_clock = 1;
+  }
+  return 0;
+}
+
+
+void Fl_PicoHeadless_Screen_Driver::add_timeout(double time, Fl_Timeout_Handler cb, void *argp)
+{
+  elapse_timeouts();
+  repeat_timeout(time, cb, argp);
+}
+
+
+void Fl_PicoHeadless_Screen_Driver::repeat_timeout(double time, Fl_Timeout_Handler cb, void *argp)
+{
+  time += missed_timeout_by; if (time < -.05) time = 0;
+  Timeout* t = free_timeout;
+  if (t) {
+    free_timeout = t->next;
+  } else {
+    t = new Timeout;
+  }
+  t->time = time;
+  t->cb = cb;
+  t->arg = argp;
+  // insert-sort the new timeout:
+  Timeout** p = &first_timeout;
+  while (*p && (*p)->time <= time) p = &((*p)->next);
+  t->next = *p;
+  *p = t;
+}
+
+
+int Fl_PicoHeadless_Screen_Driver::has_timeout(Fl_Timeout_Handler cb, void *argp)
+{
+  for (Timeout* t = first_timeout; t; t = t->next)
+    if (t->cb == cb && t->arg == argp) return 1;
+  return 0;
+}
+
+
+void Fl_PicoHeadless_Screen_Driver::remove_timeout(Fl_Timeout_Handler cb, void *argp)
+{
+  for (Timeout** p = &first_timeout; *p;) {
+    Timeout* t = *p;
+    if (t->cb == cb && (t->arg == argp || !argp)) {
+      *p = t->next;
+      t->next = free_timeout;
+      free_timeout = t;
+    } else {
+      p = &(t->next);
+    }
+  }
+}
+
+
+int Fl_PicoHeadless_Screen_Driver::compose(int& del)
+{
+  unsigned char ascii = (unsigned char)Fl::e_text[0];
+  int condition = (Fl::e_state & (FL_ALT | FL_META | FL_CTRL)) && !(ascii & 128) ;
+  if (condition) { del = 0; return 0;} // this stuff is to be treated as a function key
+  del = Fl::compose_state;
+  Fl::compose_state = 0;
+  // Only insert non-control characters:
+  if (!(ascii & ~31 && ascii!=127)) { return 0; }
+  return 1;
+}
+
+
+int Fl_PicoHeadless_Screen_Driver::get_mouse(int &x, int &y)
+{
+  x = mouse_x;
+  y = mouse_y;
+  return 0;
+}
+
+
+// Reads the current window or offscreen buffer as RGB.
+Fl_RGB_Image *Fl_PicoHeadless_Screen_Driver::read_win_rectangle(int X, int Y, int w, int h)
+{
+  Fl_PicoHeadless_Buffer *buffer = (Fl_PicoHeadless_Buffer*)fl_window;
+  if (w < 0) w = -w;
+  if (!buffer || w <= 0 || h <= 0) return NULL;
+  uchar *array = new uchar[w * h * 3];
+  memset(array, 0, w * h * 3);
+  for (int y = 0; y < h; y++) {
+    if (Y + y < 0 || Y + y >= buffer->h) continue;
+    uchar *to = array + y * w * 3;
+    for (int x = 0; x < w; x++, to += 3) {
+      if (X + x < 0 || X + x >= buffer->w) continue;
+      memcpy(to, buffer->pixel(X + x, Y + y), 3);
+    }
+  }
+  Fl_RGB_Image *image = new Fl_RGB_Image(array, w, h, 3);
+  image->alloc_array = 1;
+  return image;
+}
+
+
+void Fl_PicoHeadless_Screen_Driver::offscreen_size(Fl_Offscreen off, int &width, int &height)
+{
+  Fl_PicoHeadless_Buffer *buffer = (Fl_PicoHeadless_Buffer*)off;
+  width = buffer->w;
+  height = buffer->h;
+}
+
+
+// There is no input method, so there is no status area to place.
+void fl_set_status(int x, int y, int w, int h)
+{
+}
+
+
+////////////////////////////////////////////////////////////////
+// public functions of FL/headless.H that feed events
+
+/**
+ Sets the size of the screen, 1024 x 768 by default. This is best
+ called before the first window is shown.
+ */
+void fl_headless_screen(int w, int h)
+{
+  Fl_PicoHeadless_Screen_Driver::screen_w = w;
+  Fl_PicoHeadless_Screen_Driver::screen_h = h;
+}
+
+
+static const int button_bits[] = { FL_BUTTON1, FL_BUTTON2, FL_BUTTON3 };
+
+/**
+ Sends a mouse event to a window.
+ \p event is FL_PUSH, FL_RELEASE, FL_MOVE or FL_DRAG, at \p x, \p y relative
+ to \p win. FL_PUSH and FL_RELEASE press and release \p button, from
+ FL_LEFT_MOUSE to FL_RIGHT_MOUSE. \p clicks is the value of Fl::event_clicks()
+ for FL_PUSH, non-zero for double clicks.
+ \return the value returned by Fl::handle(), non-zero if a widget used the event.
+ */
+int fl_headless_mouse(Fl_Window *win, int event, int x, int y, int button, int clicks)
+{
+  if (!win || !win->shown()) return 0;
+  Fl::e_x = x;
+  Fl::e_y = y;
+  Fl::e_x_root = Fl_PicoHeadless_Screen_Driver::mouse_x = x + win->x();
+  Fl::e_y_root = Fl_PicoHeadless_Screen_Driver::mouse_y = y + win->y();
+  int bit = (button >= 1 && button <= 3) ? button_bits[button - 1] : 0;
+  if (event == FL_PUSH) {
+    Fl::e_keysym = FL_Button + button;
+    Fl::e_state |= bit;
+    Fl::e_clicks = clicks;
+    Fl::e_is_click = 1;
+  } else if (event == FL_RELEASE) {
+    Fl::e_keysym = FL_Button + button;
+    Fl::e_state &= ~bit;
+  } else {
+    Fl::e_is_click = 0;
+  }
+  return Fl::handle(event, win);
+}
+
+
+/**
+ Sends a FL_MOUSEWHEEL event at \p x, \p y relative to \p win.
+ \p dy is positive to scroll down, \p dx to scroll right.
+ \return the value returned by Fl::handle()
+ */
+int fl_headless_wheel(Fl_Window *win, int x, int y, int dx, int dy)
+{
+  if (!win || !win->shown()) return 0;
+  Fl::e_x = x;
+  Fl::e_y = y;
+  Fl::e_x_root = Fl_PicoHeadless_Screen_Driver::mouse_x = x + win->x();
+  Fl::e_y_root = Fl_PicoHeadless_Screen_Driver::mouse_y = y + win->y();
+  Fl::e_dx = dx;
+  Fl::e_dy = dy;
+  return Fl::handle(FL_MOUSEWHEEL, win);
+}
+
+
+/**
+ Sends a FL_KEYDOWN or FL_KEYUP event to \p win.
+ \p keysym is the value of Fl::event_key(), and \p text the UTF-8 text
+ that the key produces, if any. \p state holds the modifiers that are down,
+ such as FL_SHIFT or FL_CTRL. Keys stay pressed for Fl::event_key(int)
+ and Fl::get_key() between FL_KEYDOWN and FL_KEYUP.
+ \return the value returned by Fl::handle()
+ */
+int fl_headless_key(Fl_Window *win, int event, int keysym, const char *text, int state)
+{
+  if (!win || !win->shown()) return 0;
+  Fl_PicoHeadless_System_Driver::key_state(keysym, event == FL_KEYDOWN);
+  Fl::e_keysym = Fl::e_original_keysym = keysym;
+  Fl::e_state = (Fl::e_state & FL_BUTTONS) | (state & ~FL_BUTTONS);
+  static char empty[1];
+  Fl::e_text = (event == FL_KEYDOWN && text) ? (char*)text : empty;
+  Fl::e_length = (int)strlen(Fl::e_text);
+  Fl::e_is_click = 0;
+  return Fl::handle(event, win);
+}
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,222 @@
+//
+// "$Id$"
+//
+// System routines of the headless backend for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_System_Driver.H"
+#include <FL/Fl.H>
+#include <FL/Fl_Widget.H>
+#include <FL/Fl_Native_File_Chooser.H>
+#include <FL/Fl_Stats.H>
+#include <poll.h>
+#include <string.h>
+
+
+/*
+ By linking this module, the following static method will instantiate the
+ PicoHeadless System driver as the main system driver.
+ */
+Fl_System_Driver *Fl_System_Driver::newSystemDriver()
+{
+  return new Fl_PicoHeadless_System_Driver();
+}
+
+
+// these pointers are set by the Fl::lock() function:
+static void nothing() {}
+void (*fl_lock_function)() = nothing;
+void (*fl_unlock_function)() = nothing;
+
+
+////////////////////////////////////////////////////////////////
+// file descriptors, watched with poll()
+
+static pollfd *pollfds = 0;
+static int nfds = 0;
+static int fd_array_size = 0;
+struct FD {
+  void (*cb)(int, void*);
+  void* arg;
+};
+static FD *fd = 0;
+
+
+void Fl_PicoHeadless_System_Driver::add_fd(int n, int events, void (*cb)(int, void*), void *v)
+{
+  remove_fd(n, events);
+  int i = nfds++;
+  if (i >= fd_array_size) {
+    fd_array_size = 2 * fd_array_size + 1;
+    fd = (FD*)realloc(fd, fd_array_size * sizeof(FD));
+    pollfds = (pollfd*)realloc(pollfds, fd_array_size * sizeof(pollfd));
+  }
+  fd[i].cb = cb;
+  fd[i].arg = v;
+  pollfds[i].fd = n;
+  pollfds[i].events = events;
+}
+
+
+void Fl_PicoHeadless_System_Driver::add_fd(int n, void (*cb)(int, void*), void* v)
+{
+  add_fd(n, POLLIN, cb, v);
+}
+
+
+void Fl_PicoHeadless_System_Driver::remove_fd(int n, int events)
+{
+  int i, j;
+  for (i = j = 0; i < nfds; i++) {
+    if (pollfds[i].fd == n) {
+      int e = pollfds[i].events & ~events;
+      if (!e) continue; // if no events left, delete this fd
+      pollfds[i].events = e;
+    }
+    // move it down in the array if necessary:
+    if (j < i) {
+      fd[j] = fd[i];
+      pollfds[j] = pollfds[i];
+    }
+    j++;
+  }
+  nfds = j;
+}
+
+
+void Fl_PicoHeadless_System_Driver::remove_fd(int n)
+{
+  remove_fd(n, -1);
+}
+
+
+/**
+ Waits at most \p time_to_wait seconds for one of the file descriptors to be
+ ready, and calls its callback. With no file descriptor, this sleeps.
+ \return negative on error, 0 if nothing happened before the delay,
+ and >0 if any callbacks were done.
+ */
+int Fl_PicoHeadless_System_Driver::poll_with_delay(double time_to_wait)
+{
+  int timeout = time_to_wait < 2147483.648 ? int(time_to_wait * 1000 + .5) : -1;
+  double t0 = Fl_Stats::start();
+  fl_unlock_function();
+  int n = ::poll(pollfds, nfds, timeout);
+  fl_lock_function();
+  Fl_Stats::stop(FL_STATS_WAIT, t0);
+  if (n > 0) {
+    for (int i = 0; i < nfds; i++) {
+      if (pollfds[i].revents) {
+        t0 = Fl_Stats::start();
+        fd[i].cb(pollfds[i].fd, fd[i].arg);
+        Fl_Stats::stop(FL_STATS_FD, t0);
+      }
+    }
+  }
+  return n;
+}
+
+
+////////////////////////////////////////////////////////////////
+// keyboard state
+
+static int pressed_keys[32];  // keysyms of the keys that are down
+static int n_pressed = 0;
+
+
+/** Records that the key \p keysym was pressed or released. */
+void Fl_PicoHeadless_System_Driver::key_state(int keysym, int pressed)
+{
+  int i;
+  for (i = 0; i < n_pressed; i++) if (pressed_keys[i] == keysym) break;
+  if (pressed) {
+    if (i == n_pressed && n_pressed < int(sizeof(pressed_keys) / sizeof(int)))
+      pressed_keys[n_pressed++] = keysym;
+  } else if (i < n_pressed) {
+    pressed_keys[i] = pressed_keys[--n_pressed];
+  }
+}
+
+
+int Fl_PicoHeadless_System_Driver::event_key(int k)
+{
+  if (k > FL_Button && k <= FL_Button+8)
+    return Fl::event_state(8<<(k-FL_Button));
+  for (int i = 0; i < n_pressed; i++) if (pressed_keys[i] == k) return 1;
+  return 0;
+}
+
+
+int Fl_PicoHeadless_System_Driver::get_key(int k)
+{
+  return event_key(k);
+}
+
+
+////////////////////////////////////////////////////////////////
+// the selection (0) and the clipboard (1) only hold text, for this process
+
+static char *selection_buffer[2];
+static int selection_length[2];
+static int selection_buffer_length[2];
+
+
+void Fl_PicoHeadless_System_Driver::copy(const char *stuff, int len, int clipboard, const char *type)
+{
+  if (!stuff || len < 0) return;
+  if (clipboard >= 2) {
+    copy(stuff, len, 0, type);
+    copy(stuff, len, 1, type);
+    return;
+  }
+  if (len+1 > selection_buffer_length[clipboard]) {
+    delete[] selection_buffer[clipboard];
+    selection_buffer[clipboard] = new char[len+100];
+    selection_buffer_length[clipboard] = len+100;
+  }
+  memcpy(selection_buffer[clipboard], stuff, len);
+  selection_buffer[clipboard][len] = 0;
+  selection_length[clipboard] = len;
+}
+
+
+void Fl_PicoHeadless_System_Driver::paste(Fl_Widget &receiver, int clipboard, const char *type)
+{
+  if (strcmp(type, Fl::clipboard_plain_text)) return;
+  Fl::e_text = selection_buffer[clipboard] ? selection_buffer[clipboard] : (char *)"";
+  Fl::e_length = selection_length[clipboard];
+  Fl::e_clipboard_type = Fl::clipboard_plain_text;
+  receiver.handle(FL_PASTE);
+}
+
+
+int Fl_PicoHeadless_System_Driver::clipboard_contains(const char *type)
+{
+  return !strcmp(type, Fl::clipboard_plain_text) && selection_length[1] > 0;
+}
+
+
+// Without a desktop, the native file chooser is the FLTK one.
+Fl_Native_File_Chooser::Fl_Native_File_Chooser(int val)
+{
+  platform_fnfc = new Fl_Native_File_Chooser_FLTK_Driver(val);
+}
+
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,254 @@
+//
+// "$Id$"
+//
+// Windows of the headless backend for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2010-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include "../../config_lib.h"
+#include "Fl_PicoHeadless_Window_Driver.H"
+#include "Fl_PicoHeadless_Graphics_Driver.H"
+
+#include <FL/platform.H>
+#include <FL/Fl.H>
+#include <FL/Fl_Window.H>
+#include <FL/headless.H>
+#include <FL/fl_utf8.h>
+#include <stdio.h>
+#include <string.h>
+
+
+Fl_Window_Driver *Fl_Window_Driver::newWindowDriver(Fl_Window *win)
+{
+  return new Fl_PicoHeadless_Window_Driver(win);
+}
+
+
+void Fl_Window_Driver::default_icons(Fl_RGB_Image const**, int) {
+}
+
+
+Fl_PicoHeadless_Window_Driver::Fl_PicoHeadless_Window_Driver(Fl_Window *win)
+: Fl_Pico_Window_Driver(win)
+{
+}
+
+
+Fl_PicoHeadless_Window_Driver::~Fl_PicoHeadless_Window_Driver()
+{
+}
+
+
+Fl_PicoHeadless_Buffer *Fl_PicoHeadless_Window_Driver::buffer(const Fl_Window *win)
+{
+  Fl_X *i = Fl_X::i(win);
+  return i ? (Fl_PicoHeadless_Buffer*)i->xid : 0;
+}
+
+
+Fl_X *Fl_PicoHeadless_Window_Driver::makeWindow()
+{
+  Fl_Group::current(0);
+  if (parent() && !Fl_X::i(pWindow->window())) {
+    pWindow->set_visible();
+    return 0L;
+  }
+  Fl_X *x = new Fl_X;
+  other_xid = 0;
+  x->w = pWindow;
+  x->region = 0;
+  x->xid = (Window)new Fl_PicoHeadless_Buffer(w(), h());
+  x->next = Fl_X::first;
+  wait_for_expose_value = 0;
+  i(x);
+  Fl_X::first = x;
+
+  pWindow->set_visible();
+  pWindow->redraw();
+  int old_event = Fl::e_number;
+  pWindow->handle(Fl::e_number = FL_SHOW);
+  Fl::e_number = old_event;
+
+  return x;
+}
+
+
+void Fl_PicoHeadless_Window_Driver::show()
+{
+  if (!shown()) {
+    fl_open_display();
+    makeWindow();
+  }
+}
+
+
+void Fl_PicoHeadless_Window_Driver::make_current()
+{
+  fl_window = fl_xid(pWindow);
+  // the display driver may be wrapped by Fl_Draw_Profiler
+  Fl_PicoHeadless_Graphics_Driver *driver =
+    (Fl_PicoHeadless_Graphics_Driver*)&Fl_Graphics_Driver::default_driver();
+  driver->buffer((Fl_PicoHeadless_Buffer*)fl_window);
+  driver->clip_region(0);
+}
+
+
+void Fl_PicoHeadless_Window_Driver::hide()
+{
+  Fl_X* ip = Fl_X::i(pWindow);
+  if (hide_common()) return;
+  Fl_PicoHeadless_Buffer *b = (Fl_PicoHeadless_Buffer*)ip->xid;
+  if (fl_window == ip->xid) {
+    fl_window = 0;
+    ((Fl_PicoHeadless_Graphics_Driver*)&Fl_Graphics_Driver::default_driver())->buffer(0);
+  }
+  delete b;
+  delete ip;
+}
+
+
+void Fl_PicoHeadless_Window_Driver::resize(int X, int Y, int W, int H)
+{
+  int is_a_resize = (W != w() || H != h());
+  if (X != x() || Y != y()) {
+    force_position(1);
+  } else if (!is_a_resize) {
+    return;
+  }
+  if (is_a_resize) {
+    pWindow->Fl_Group::resize(X, Y, W, H);
+    if (shown()) buffer(pWindow)->resize(W, H);
+    if (visible_r()) pWindow->redraw();
+  } else {
+    x(X);
+    y(Y);
+  }
+}
+
+
+// Moves pixels inside the window. The area is inside the window, and
+// the caller redraws the uncovered parts.
+int Fl_PicoHeadless_Window_Driver::scroll(int src_x, int src_y, int src_w, int src_h,
+                                          int dest_x, int dest_y,
+                                          void (*draw_area)(void*, int,int,int,int), void* data)
+{
+  Fl_PicoHeadless_Buffer *b = buffer(pWindow);
+  if (!b) return 1;
+  if (src_x < 0 || src_y < 0 || dest_x < 0 || dest_y < 0 ||
+      src_x + src_w > b->w || src_y + src_h > b->h ||
+      dest_x + src_w > b->w || dest_y + src_h > b->h) return 1;
+  if (dest_y > src_y) {  // copy from the bottom so that lines aren't overwritten
+    for (int y = src_h - 1; y >= 0; y--)
+      memmove(b->pixel(dest_x, dest_y + y), b->pixel(src_x, src_y + y), src_w * 4);
+  } else {
+    for (int y = 0; y < src_h; y++)
+      memmove(b->pixel(dest_x, dest_y + y), b->pixel(src_x, src_y + y), src_w * 4);
+  }
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////
+// public functions of FL/headless.H that read windows
+
+/**
+ Returns the pixels of a shown window, as 4 bytes per pixel, red, green,
+ blue and alpha, with lines of win->w() pixels. Subwindows have their own
+ pixels. The result remains valid until the window is resized or hidden.
+ \return NULL if the window isn't shown
+ */
+const uchar *fl_headless_pixels(Fl_Window *win)
+{
+  Fl_PicoHeadless_Buffer *b = Fl_PicoHeadless_Window_Driver::buffer(win);
+  return b ? b->pixels : 0;
+}
+
+
+// Copies the buffers of the shown subwindows of g into b, which shows g at x, y.
+static void composite(Fl_Group *g, Fl_PicoHeadless_Buffer *b, int x, int y)
+{
+  for (int n = 0; n < g->children(); n++) {
+    Fl_Widget *o = g->child(n);
+    Fl_Group *sub = o->as_group();
+    if (!sub || !o->visible()) continue;
+    Fl_Window *win = o->as_window();
+    if (!win) {
+      composite(sub, b, x, y);
+      continue;
+    }
+    Fl_PicoHeadless_Buffer *sb = Fl_PicoHeadless_Window_Driver::buffer(win);
+    if (!sb) continue;
+    int X = x + win->x(), Y = y + win->y();
+    int x0 = X < 0 ? -X : 0, y0 = Y < 0 ? -Y : 0;
+    int x1 = X + sb->w > b->w ? b->w - X : sb->w;
+    int y1 = Y + sb->h > b->h ? b->h - Y : sb->h;
+    for (int i = y0; i < y1 && x0 < x1; i++)
+      memcpy(b->pixel(X + x0, Y + i), sb->pixel(x0, i), (x1 - x0) * 4);
+    composite(win, b, X, Y);
+  }
+}
+
+
+/**
+ Writes the pixels of a shown window, with those of its subwindows, to a file.
+ If \p filename ends with ".pam", it gets all 4 channels in the PAM format,
+ otherwise it gets red, green and blue in the binary PPM format. Both are
+ uncompressed, so that writing costs little more than a copy: convert them
+ to other formats with tools such as netpbm or ImageMagick.
+ \return 0 on success, -1 on error
+ */
+int fl_headless_write(Fl_Window *win, const char *filename)
+{
+  Fl_PicoHeadless_Buffer *b = Fl_PicoHeadless_Window_Driver::buffer(win);
+  if (!b) return -1;
+  Fl_PicoHeadless_Buffer *out = b, *copy = 0;
+  for (int n = 0; n < win->children(); n++) {
+    if (win->child(n)->as_group()) {
+      copy = out = new Fl_PicoHeadless_Buffer(b->w, b->h);
+      memcpy(out->pixels, b->pixels, (size_t)b->w * b->h * 4);
+      composite(win, out, 0, 0);
+      break;
+    }
+  }
+  int ret = -1;
+  FILE *f = fl_fopen(filename, "wb");
+  if (f) {
+    size_t l = strlen(filename);
+    size_t size = (size_t)out->w * out->h;
+    if (l > 4 && !strcmp(filename + l - 4, ".pam")) {
+      fprintf(f, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+              out->w, out->h);
+      if (fwrite(out->pixels, 4, size, f) == size) ret = 0;
+    } else {
+      fprintf(f, "P6\n%d %d\n255\n", out->w, out->h);
+      uchar *line = new uchar[out->w * 3];
+      ret = 0;
+      for (int y = 0; y < out->h && !ret; y++) {
+        const uchar *from = out->pixel(0, y);
+        for (int x = 0; x < out->w; x++, from += 4) memcpy(line + x * 3, from, 3);
+        if (fwrite(line, 3, out->w, f) != (size_t)out->w) ret = -1;
+      }
+      delete[] line;
+    }
+    if (fclose(f)) ret = -1;
+  }
+  delete copy;
+  return ret;
+}
+
+
+//
+// End of "$Id$".
+//
@@ -196,10 +196,16 @@ char *Fl_WinAPI_System_Driver::getenv(const char *var) {
   return wchar_to_utf8(ret, buf);
 }
 
+// open() and fopen() convert into their own buffers, because the image
+// loaders of Fl_Shared_Image::get_async() call them from several threads.
 int Fl_WinAPI_System_Driver::open(const char *fnam, int oflags, int pmode) {
-  utf8_to_wchar(fnam, wbuf);
-  if (pmode == -1) return _wopen(wbuf, oflags);
-  else return _wopen(wbuf, oflags, pmode);
+  wchar_t *wname = NULL;
+  utf8_to_wchar(fnam, wname);
+  int fd;
+  if (pmode == -1) fd = _wopen(wname, oflags);
+  else fd = _wopen(wname, oflags, pmode);
+  free(wname);
+  return fd;
 }
 
 int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags, int pmode) {
@@ -209,9 +215,13 @@ int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags,
 }
 
 FILE *Fl_WinAPI_System_Driver::fopen(const char *fnam, const char *mode) {
-  utf8_to_wchar(fnam, wbuf);
-  utf8_to_wchar(mode, wbuf1);
-  return _wfopen(wbuf, wbuf1);
+  wchar_t *wname = NULL, *wmode = NULL;
+  utf8_to_wchar(fnam, wname);
+  utf8_to_wchar(mode, wmode);
+  FILE *f = _wfopen(wname, wmode);
+  free(wname);
+  free(wmode);
+  return f;
 }
 
 int Fl_WinAPI_System_Driver::system(const char *cmd) {
@@ -22,12 +22,15 @@
 #include "../Xlib/Fl_Font.H"
 #include "Fl_X11_Window_Driver.H"
 #include "../Xlib/Fl_Xlib_Graphics_Driver.H"
+#include "../Xlib/Fl_Xlib_Shm.H"
 #include <FL/Fl.H>
 #include <FL/platform.H>
 #include <FL/fl_ask.H>
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Image_Surface.H>
 #include <FL/Fl_Tooltip.H>
+#include <FL/Fl_Stats.H>
+#include <FL/Fl_Trace.H>
 
 #include <sys/time.h>
 
@@ -437,6 +440,7 @@ void Fl_X11_Screen_Driver::beep(int type)
 
 void Fl_X11_Screen_Driver::flush()
 {
+  Fl_Xlib_Graphics_Driver::flush_batch();
   if (fl_display)
     XFlush(fl_display);
 }
@@ -460,7 +464,11 @@ double Fl_X11_Screen_Driver::wait(double time_to_wait)
       t->next = free_timeout;
       free_timeout = t;
       // Now it is safe for the callback to do add_timeout:
+      double t0 = Fl_Stats::start();
+      Fl_Trace::begin("timeout", "timer");
       cb(argp);
+      Fl_Trace::end();
+      Fl_Stats::stop(FL_STATS_TIMEOUT, t0);
     }
   } else {
     reset_clock = 1; // we are not going to check the clock
@@ -775,7 +783,9 @@ Fl_RGB_Image *Fl_X11_Screen_Driver::read_win_rectangle(int X, int Y, int w, int
   // us...
   //
   int allow_outside = w < 0;    // negative w allows negative X or Y, that is, window frame
+  int shm_image = 0;            // the image belongs to Fl_Xlib_Shm
   if (w < 0) w = - w;
+  Fl_Xlib_Graphics_Driver::flush_batch();
   
 #  ifdef __sgi
   if (XReadDisplayQueryExtension(fl_display, &i, &i)) {
@@ -815,9 +825,19 @@ Fl_RGB_Image *Fl_X11_Screen_Driver::read_win_rectangle(int X, int Y, int w, int
       // the image is fully contained, we can use the traditional method
       // however, if the window is obscured etc. the function will still fail. Make sure we
       // catch the error and continue, otherwise an exception will be thrown.
+#if HAVE_XSHM
+      if (ws * hs * 4 >= Fl_Xlib_Shm::threshold) {
+        image = Fl_Xlib_Shm::get(fl_window, int(X*s), int(Y*s), ws, hs);
+        shm_image = (image != 0);
+      }
+      if (!image) {
+#endif
       XErrorHandler old_handler = XSetErrorHandler(xgetimageerrhandler);
       image = XGetImage(fl_display, fl_window, int(X*s), int(Y*s), ws, hs, AllPlanes, ZPixmap);
       XSetErrorHandler(old_handler);
+#if HAVE_XSHM
+      }
+#endif
     } else {
       // image is crossing borders, determine visible region
       int nw, nh, noffx, noffy;
@@ -1172,7 +1192,7 @@ Fl_RGB_Image *Fl_X11_Screen_Driver::read_win_rectangle(int X, int Y, int w, int
   }
   
   // Destroy the X image we've read and return the RGB(A) image...
-  XDestroyImage(image);
+  if (!shm_image) XDestroyImage(image);
   
   Fl_RGB_Image *rgb = new Fl_RGB_Image(p, w, h, d);
   if (!oldp) rgb->alloc_array = 1;
@@ -98,6 +98,7 @@ void Fl_X11_Window_Driver::flush_double_dbe(int erase_overlay)
     fl_window = i->xid;
   }
   // Copy contents of back buffer to window...
+  Fl_Xlib_Graphics_Driver::flush_batch();
   XdbeSwapInfo s;
   s.swap_window = fl_xid(pWindow);
   s.swap_action = XdbeCopied;
@@ -472,6 +473,7 @@ void Fl_X11_Window_Driver::hide() {
   Fl_Xlib_Graphics_Driver::destroy_xft_draw(ip->xid);
   screen_num_ = -1;
 # endif
+  Fl_Xlib_Graphics_Driver::flush_batch();
   // this test makes sure ip->xid has not been destroyed already
   if (ip->xid) XDestroyWindow(fl_display, ip->xid);
   delete ip;
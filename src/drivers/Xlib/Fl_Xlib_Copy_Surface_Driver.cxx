@@ -83,6 +83,7 @@ void Fl_Xlib_Copy_Surface_Driver::set_current() {
 }
 
 void Fl_Xlib_Copy_Surface_Driver::end_current_() {
+  Fl_Xlib_Graphics_Driver::flush_batch();
   fl_window = oldwindow;
 }
 
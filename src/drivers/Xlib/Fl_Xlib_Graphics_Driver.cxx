@@ -71,6 +71,7 @@ Fl_Xlib_Graphics_Driver::~Fl_Xlib_Graphics_Driver() {
 
 
 void Fl_Xlib_Graphics_Driver::gc(void *value) {
+  if (value != gc_) flush_batch();
   gc_ = (GC)value;
   fl_gc = gc_;
 }
@@ -98,6 +99,7 @@ void Fl_Xlib_Graphics_Driver::scale(float f) {
 }
 
 void Fl_Xlib_Graphics_Driver::copy_offscreen(int x, int y, int w, int h, Fl_Offscreen pixmap, int srcx, int srcy) {
+  flush_batch();
   XCopyArea(fl_display, pixmap, fl_window, gc_, srcx*scale(), srcy*scale(), w*scale(), h*scale(), (x+offset_x_)*scale(), (y+offset_y_)*scale());
 
 }
@@ -227,8 +229,10 @@ void Fl_Xlib_Graphics_Driver::font_name(int num, const char *name) {
 #if !USE_XFT
     if (s->xlist && s->n >= 0) XFreeFontNames(s->xlist);
 #endif
+    // ~Fl_Font_Descriptor() is not virtual: delete through the derived type,
+    // whose destructor also removes the descriptor from the font cache
     for (Fl_Font_Descriptor* f = s->first; f;) {
-      Fl_Font_Descriptor* n = f->next; delete f; f = n;
+      Fl_Font_Descriptor* n = f->next; delete (Fl_Xlib_Font_Descriptor*)f; f = n;
     }
     s->first = 0;
   }
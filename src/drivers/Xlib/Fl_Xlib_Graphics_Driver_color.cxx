@@ -117,14 +117,24 @@ void Fl_Xlib_Graphics_Driver::color(Fl_Color i) {
   } else {
     Fl_Graphics_Driver::color(i);
     if(!gc_) return; // don't get a default gc if current window is not yet created/valid
-    XSetForeground(fl_display, gc_, fl_xpixel(i));
+    foreground(fl_xpixel(i));
   }
 }
 
 void Fl_Xlib_Graphics_Driver::color(uchar r,uchar g,uchar b) {
   Fl_Graphics_Driver::color( fl_rgb_color(r, g, b) );
   if(!gc_) return; // don't get a default gc if current window is not yet created/valid
-  XSetForeground(fl_display, gc_, fl_xpixel(r,g,b));
+  foreground(fl_xpixel(r,g,b));
+}
+
+// Queued primitives keep their color if the pixel value doesn't change.
+// XGetGCValues() reads the copy of the GC kept by Xlib, without a round trip.
+void Fl_Xlib_Graphics_Driver::foreground(unsigned long pixel) {
+  XGCValues values;
+  if (!XGetGCValues(fl_display, gc_, GCForeground, &values) || values.foreground != pixel) {
+    flush_batch();
+    XSetForeground(fl_display, gc_, pixel);
+  }
 }
 
 /** \addtogroup  fl_attributes
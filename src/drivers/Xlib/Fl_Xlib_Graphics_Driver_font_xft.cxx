@@ -22,12 +22,16 @@
 #include "Fl_Xlib_Graphics_Driver.H"
 #include <FL/Fl.H>
 #include <FL/fl_draw.H>
+#include <FL/Fl_Trace.H>
 #include <FL/platform.H>
 #include "Fl_Font.H"
 
+#include <FL/filename.H>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <X11/Xft/Xft.h>
 #include <X11/Xft/XftCompat.h>
@@ -321,6 +325,88 @@ STYLE_DONE:
 
 static int fl_free_font = FL_FREE_FONT;
 
+// The list of fonts made by set_fonts() is saved in a cache file, and read
+// back while fontconfig's configuration and fonts are unchanged. This avoids
+// listing and sorting all system fonts at each program start.
+
+#define FONT_CACHE_MAGIC "FLTK Xft font list 1"
+
+// Adds the name and modification time of each file of a fontconfig list.
+static unsigned long long hash_files(unsigned long long h, FcStrList *list) {
+  if (!list) return h;
+  FcChar8 *file;
+  while ((file = FcStrListNext(list)) != NULL) {
+    struct stat st;
+    unsigned long long t = stat((const char*)file, &st) ? 0 : (unsigned long long)st.st_mtime;
+    for (const FcChar8 *p = file; *p; p++) { h ^= *p; h *= 0x100000001b3ULL; }
+    for (int i = 0; i < 8; i++) { h ^= (t >> (8 * i)) & 0xff; h *= 0x100000001b3ULL; }
+  }
+  FcStrListDone(list);
+  return h;
+}
+
+// Returns a value that changes when fonts are added or removed, or when the
+// configuration of fontconfig changes: it depends on the version of fontconfig
+// and on the modification times of all font directories (subdirectories
+// included), cache directories and configuration files.
+static unsigned long long font_cache_key() {
+  unsigned long long h = 0xcbf29ce484222325ULL ^ (unsigned long long)FcGetVersion();
+  h = hash_files(h, FcConfigGetFontDirs(NULL));
+  h = hash_files(h, FcConfigGetCacheDirs(NULL));
+  h = hash_files(h, FcConfigGetConfigFiles(NULL));
+  return h;
+}
+
+// Returns the name of the cache file, in the directory of the user's preferences.
+static const char *font_cache_file() {
+  static char path[FL_PATH_MAX];
+  const char *home = getenv("HOME");
+  if (!home || !*home) return NULL;
+  snprintf(path, sizeof(path), "%s%s.fltk", home, home[strlen(home)-1] == '/' ? "" : "/");
+  mkdir(path, 0700);
+  strlcat(path, "/xft-fonts.cache", sizeof(path));
+  return path;
+}
+
+// Adds the fonts listed in the cache file, if it matches key.
+// Returns 0 if there is no usable cache.
+static int read_font_cache(const char *path, unsigned long long key) {
+  FILE *in = fopen(path, "r");
+  if (!in) return 0;
+  char line[1024];
+  char expected[64];
+  snprintf(expected, sizeof(expected), FONT_CACHE_MAGIC " %llx\n", key);
+  if (!fgets(line, sizeof(line), in) || strcmp(line, expected)) {
+    fclose(in);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), in)) {
+    char *nl = strchr(line, '\n');
+    if (nl) *nl = 0;
+    if (!*line) continue;
+    Fl::set_font((Fl_Font)fl_free_font, strdup(line));
+    fl_free_font++;
+  }
+  fclose(in);
+  return 1;
+}
+
+// Saves the font names in fl_fonts from FL_FREE_FONT on. The file is
+// replaced at once, so that other programs never read a partial list.
+static void write_font_cache(const char *path, unsigned long long key) {
+  char tmp[FL_PATH_MAX];
+  snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+  FILE *out = fopen(tmp, "w");
+  if (!out) return;
+  int ok = fprintf(out, FONT_CACHE_MAGIC " %llx\n", key) > 0;
+  for (int i = FL_FREE_FONT; ok && i < fl_free_font; i++) {
+    const char *name = fl_fonts[i].name;
+    if (strchr(name, '\n') || strlen(name) >= 1000) ok = 0;
+    else ok = fprintf(out, "%s\n", name) > 0;
+  }
+  if (fclose(out) || !ok || rename(tmp, path)) unlink(tmp);
+}
+
 // Uses the fontconfig lib to construct a list of all installed fonts.
 // I tried using XftListFonts for this, but the API is tricky - and when
 // I looked at the XftList* code, it calls the Fc* functions anyway, so...
@@ -351,6 +437,14 @@ Fl_Font Fl_Xlib_Graphics_Driver::set_fonts(const char* pattern_name)
     return FL_FREE_FONT;
   }
 
+  unsigned long long cache_key = font_cache_key();
+  const char *cache_file = font_cache_file();
+  Fl_Trace::begin("read font cache", "font");
+  int cached = cache_file && read_font_cache(cache_file, cache_key);
+  Fl_Trace::end();
+  if (cached) return (Fl_Font)fl_free_font;
+  Fl_Trace::begin("list fonts", "font");
+
   // Create a search pattern that will match every font name - I think this
   // does the Right Thing, but am not certain...
   //
@@ -457,7 +551,9 @@ Fl_Font Fl_Xlib_Graphics_Driver::set_fonts(const char* pattern_name)
     }
     // Now we are done with the list, release it fully
     free(full_list);
+    if (cache_file) write_font_cache(cache_file, cache_key);
   }
+  Fl_Trace::end();
   return (Fl_Font)fl_free_font;
 } // ::set_fonts
 
@@ -695,10 +791,92 @@ puts("Font Opened"); fflush(stdout);
   }
 } // end of fontopen
 
+// At most max_open_fonts XftFont objects are kept open: each one holds a glyph
+// cache, and programs that draw rotated or scaled text create many descriptors.
+// When there are more, the font of the descriptor selected least recently is
+// closed, and reopened by xftfont() when needed again. The descriptors of the
+// open fonts are in a list, from the least to the most recently selected.
+static const int max_open_fonts = 64;
+static int open_fonts = 0;
+static Fl_Xlib_Font_Descriptor *lru_first = NULL, *lru_last = NULL;
+
+static void lru_append(Fl_Xlib_Font_Descriptor *f) {
+  f->lru_prev = lru_last;
+  f->lru_next = NULL;
+  if (lru_last) lru_last->lru_next = f;
+  else lru_first = f;
+  lru_last = f;
+  open_fonts++;
+}
+
+static void lru_remove(Fl_Xlib_Font_Descriptor *f) {
+  if (f->lru_prev) f->lru_prev->lru_next = f->lru_next;
+  else lru_first = f->lru_next;
+  if (f->lru_next) f->lru_next->lru_prev = f->lru_prev;
+  else lru_last = f->lru_prev;
+  f->lru_prev = f->lru_next = NULL;
+  open_fonts--;
+}
+
+static void close_unused_fonts(Fl_Xlib_Font_Descriptor *keep);
+
 Fl_Xlib_Font_Descriptor::Fl_Xlib_Font_Descriptor(const char* name, Fl_Fontsize fsize, int fangle) : Fl_Font_Descriptor(name, fsize) {
 //  encoding = fl_encoding_;
   angle = fangle;
+  fnum = -1;
+  hash_next = NULL;
+  lru_prev = lru_next = NULL;
+  Fl_Trace::begin("open font", "font", name);
   font = fontopen(name, fsize, false, angle);
+  Fl_Trace::end();
+  if (font) lru_append(this);
+  for (int i = 0; i < 256; i++) advance_[i] = ADVANCE_UNKNOWN;
+  advance_hash_ = NULL;
+  advance_hash_size_ = advance_hash_count_ = 0;
+}
+
+void Fl_Xlib_Font_Descriptor::reopen() {
+  Fl_Trace::begin("open font", "font", fl_fonts[fnum].name);
+  font = fontopen(fl_fonts[fnum].name, size, false, angle);
+  Fl_Trace::end();
+  if (font) lru_append(this);
+  close_unused_fonts(this);
+}
+
+/* Returns the advance of one character, asking Xft only the first time.
+ Characters below 256 are kept in a table, others in a hash table that
+ grows as needed.
+ */
+int Fl_Xlib_Font_Descriptor::measure_advance(unsigned ucs)
+{
+  XGlyphInfo gi;
+  FcChar32 c = ucs;
+  if (ucs < 256) {
+    XftTextExtents32(fl_display, xftfont(), &c, 1, &gi);
+    return advance_[ucs] = gi.xOff;
+  }
+  if (2 * (advance_hash_count_ + 1) > advance_hash_size_) {
+    Advance_Entry *old = advance_hash_;
+    unsigned old_size = advance_hash_size_;
+    advance_hash_size_ = old_size ? 2 * old_size : 64;
+    advance_hash_ = (Advance_Entry*)calloc(advance_hash_size_, sizeof(Advance_Entry));
+    for (unsigned i = 0; i < old_size; i++) {
+      if (!old[i].ucs) continue;
+      unsigned j = (old[i].ucs * 0x9E3779B1U) & (advance_hash_size_ - 1);
+      while (advance_hash_[j].ucs) j = (j + 1) & (advance_hash_size_ - 1);
+      advance_hash_[j] = old[i];
+    }
+    free(old);
+  }
+  unsigned i = (ucs * 0x9E3779B1U) & (advance_hash_size_ - 1);
+  while (advance_hash_[i].ucs && advance_hash_[i].ucs != ucs) i = (i + 1) & (advance_hash_size_ - 1);
+  if (!advance_hash_[i].ucs) {
+    XftTextExtents32(fl_display, xftfont(), &c, 1, &gi);
+    advance_hash_[i].ucs = ucs;
+    advance_hash_[i].advance = gi.xOff;
+    advance_hash_count_++;
+  }
+  return advance_hash_[i].advance;
 }
 
 
@@ -730,39 +908,53 @@ static void utf8extents(Fl_Xlib_Font_Descriptor *desc, const char *str, int n, X
   memset(extents, 0, sizeof(XGlyphInfo));
   const wchar_t *buffer = utf8reformat(str, n);
 #ifdef __CYGWIN__
-    XftTextExtents16(fl_display, desc->font, (XftChar16 *)buffer, n, extents);
+    XftTextExtents16(fl_display, desc->xftfont(), (XftChar16 *)buffer, n, extents);
 #else
-    XftTextExtents32(fl_display, desc->font, (XftChar32 *)buffer, n, extents);
+    XftTextExtents32(fl_display, desc->xftfont(), (XftChar32 *)buffer, n, extents);
 #endif
 }
 
 int Fl_Xlib_Graphics_Driver::height_unscaled() {
-  if (font_descriptor()) return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font->ascent + ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font->descent;
+  if (font_descriptor()) return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont()->ascent + ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont()->descent;
   else return -1;
 }
 
 int Fl_Xlib_Graphics_Driver::descent_unscaled() {
-  if (font_descriptor()) return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font->descent;
+  if (font_descriptor()) return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont()->descent;
   else return -1;
 }
 
+// Xft doesn't kern: the advance of a string is the sum of the advances of its
+// characters, which are cached by the font descriptor. text_extents() still
+// asks Xft, because the ink box of a string is not the sum of those of its glyphs.
 double Fl_Xlib_Graphics_Driver::width_unscaled(const char* str, int n) {
-  if (!font_descriptor()) return -1.0;
-  XGlyphInfo i;
-  utf8extents((Fl_Xlib_Font_Descriptor*)font_descriptor(), str, n, &i);
-  return i.xOff;
+  Fl_Xlib_Font_Descriptor *desc = (Fl_Xlib_Font_Descriptor*)font_descriptor();
+  if (!desc) return -1.0;
+  const char *end = str + n;
+  int w = 0;
+  while (str < end) {
+    unsigned ucs;
+    if (!(*str & 0x80)) ucs = (uchar)*str++;
+    else {
+      int len;
+      ucs = fl_utf8decode(str, end, &len);
+      str += len;
+    }
+    w += desc->advance(ucs);
+  }
+  return w;
 }
 
 static double fl_xft_width(Fl_Font_Descriptor *desc, FcChar32 *str, int n) {
   if (!desc) return -1.0;
   XGlyphInfo i;
-  XftTextExtents32(fl_display, ((Fl_Xlib_Font_Descriptor*)desc)->font, str, n, &i);
+  XftTextExtents32(fl_display, ((Fl_Xlib_Font_Descriptor*)desc)->xftfont(), str, n, &i);
   return i.xOff;
 }
 
 double Fl_Xlib_Graphics_Driver::width_unscaled(unsigned int c) {
   if (!font_descriptor()) return -1.0;
-  return fl_xft_width(font_descriptor(), (FcChar32 *)(&c), 1);
+  return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->advance(c);
 }
 
 void Fl_Xlib_Graphics_Driver::text_extents_unscaled(const char *c, int n, int &dx, int &dy, int &w, int &h) {
@@ -782,6 +974,7 @@ void Fl_Xlib_Graphics_Driver::text_extents_unscaled(const char *c, int n, int &d
 }
 
 void Fl_Xlib_Graphics_Driver::draw_unscaled(const char *str, int n, int x, int y) {
+  flush_batch();
 #if USE_OVERLAY
   XftDraw*& draw_ = fl_overlay ? draw_overlay : ::draw_;
   if (fl_overlay) {
@@ -814,9 +1007,9 @@ void Fl_Xlib_Graphics_Driver::draw_unscaled(const char *str, int n, int x, int y
     
     const wchar_t *buffer = utf8reformat(str, n);
 #ifdef __CYGWIN__
-    XftDrawString16(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font, x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (XftChar16 *)buffer, n);
+    XftDrawString16(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont(), x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (XftChar16 *)buffer, n);
 #else
-    XftDrawString32(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font, x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (XftChar32 *)buffer, n);
+    XftDrawString32(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont(), x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (XftChar32 *)buffer, n);
 #endif
   }
 }
@@ -828,6 +1021,7 @@ void Fl_Xlib_Graphics_Driver::draw_unscaled(int angle, const char *str, int n, i
 }
 
 void Fl_Xlib_Graphics_Driver::drawUCS4(const void *str, int n, int x, int y) {
+  flush_batch();
 #if USE_OVERLAY
   XftDraw*& draw_ = fl_overlay ? draw_overlay : ::draw_;
   if (fl_overlay) {
@@ -858,7 +1052,7 @@ void Fl_Xlib_Graphics_Driver::drawUCS4(const void *str, int n, int x, int y) {
   color.color.blue  = ((int)b)*0x101;
   color.color.alpha = 0xffff;
 
-  XftDrawString32(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font, x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (FcChar32 *)str, n);
+  XftDrawString32(draw_, &color, ((Fl_Xlib_Font_Descriptor*)font_descriptor())->xftfont(), x+offset_x_*scale()+line_delta_, y+offset_y_*scale()+line_delta_, (FcChar32 *)str, n);
 }
 
 
@@ -994,9 +1188,80 @@ float Fl_Xlib_Graphics_Driver::scale_bitmap_for_PostScript() {
   return 2;
 }
 
+// All descriptors, hashed by font number, size and angle. They are also in the
+// list of sizes of their font (fl_fonts[fnum].first), which other parts of the
+// library walk and delete from: descriptors leave the table in their destructor.
+static Fl_Xlib_Font_Descriptor **desc_table = NULL;
+static unsigned desc_table_size = 0; // a power of 2, or 0
+static unsigned desc_count = 0;
+
+static unsigned desc_hash(Fl_Font fnum, Fl_Fontsize size, int angle) {
+  unsigned h = ((unsigned)fnum * 31 + (unsigned)size) * 31 + (unsigned)angle;
+  return (h * 0x9E3779B1U) >> 8;
+}
+
+static Fl_Xlib_Font_Descriptor *find_descriptor(Fl_Font fnum, Fl_Fontsize size, int angle) {
+  if (!desc_count) return NULL;
+  Fl_Xlib_Font_Descriptor *f = desc_table[desc_hash(fnum, size, angle) & (desc_table_size - 1)];
+  while (f && (f->fnum != fnum || f->size != size || f->angle != angle)) f = f->hash_next;
+  return f;
+}
+
+static void add_descriptor(Fl_Xlib_Font_Descriptor *f) {
+  if (desc_count >= desc_table_size) {
+    unsigned size = desc_table_size ? 2 * desc_table_size : 64;
+    Fl_Xlib_Font_Descriptor **table = (Fl_Xlib_Font_Descriptor**)calloc(size, sizeof(*table));
+    for (unsigned i = 0; i < desc_table_size; i++) {
+      for (Fl_Xlib_Font_Descriptor *d = desc_table[i], *next; d; d = next) {
+        next = d->hash_next;
+        unsigned j = desc_hash(d->fnum, d->size, d->angle) & (size - 1);
+        d->hash_next = table[j];
+        table[j] = d;
+      }
+    }
+    free(desc_table);
+    desc_table = table;
+    desc_table_size = size;
+  }
+  unsigned i = desc_hash(f->fnum, f->size, f->angle) & (desc_table_size - 1);
+  f->hash_next = desc_table[i];
+  desc_table[i] = f;
+  desc_count++;
+}
+
+static void remove_descriptor(Fl_Xlib_Font_Descriptor *f) {
+  if (f->fnum < 0 || !desc_count) return;
+  Fl_Xlib_Font_Descriptor **p = desc_table + (desc_hash(f->fnum, f->size, f->angle) & (desc_table_size - 1));
+  while (*p && *p != f) p = &(*p)->hash_next;
+  if (*p) { *p = f->hash_next; desc_count--; }
+}
+
+#if ! USE_PANGO
+// Closes the fonts selected least recently while more than max_open_fonts are
+// open. The descriptors stay, with their cached advances.
+static void close_unused_fonts(Fl_Xlib_Font_Descriptor *keep) {
+  Fl_Font_Descriptor *current = fl_graphics_driver ? fl_graphics_driver->font_descriptor() : NULL;
+  Fl_Xlib_Font_Descriptor *oldest = lru_first;
+  while (open_fonts > max_open_fonts && oldest) {
+    Fl_Xlib_Font_Descriptor *next = oldest->lru_next;
+    if (oldest != keep && oldest != current) {
+      lru_remove(oldest);
+      XftFontClose(fl_display, oldest->font);
+      oldest->font = NULL;
+    }
+    oldest = next;
+  }
+}
+#endif // ! USE_PANGO
+
 Fl_Xlib_Font_Descriptor::~Fl_Xlib_Font_Descriptor() {
   if (this == fl_graphics_driver->font_descriptor()) fl_graphics_driver->font_descriptor(NULL);
+  remove_descriptor(this);
   //  XftFontClose(fl_display, font);
+#if ! USE_PANGO
+  if (font) lru_remove(this);
+  free(advance_hash_);
+#endif
 }
 
 
@@ -1019,17 +1284,24 @@ static void fl_xft_font(Fl_Xlib_Graphics_Driver *driver, Fl_Font fnum, Fl_Fontsi
   if (fnum == driver->Fl_Graphics_Driver::font() && size == driver->size_unscaled() && f && f->angle == angle)
     return;
   driver->Fl_Graphics_Driver::font(fnum, size);
-  Fl_Fontdesc *font = fl_fonts + fnum;
   // search the fontsizes we have generated already
-  for (f = (Fl_Xlib_Font_Descriptor*)font->first; f; f = (Fl_Xlib_Font_Descriptor*)f->next) {
-    if (f->size == size && f->angle == angle)// && !strcasecmp(f->encoding, fl_encoding_))
-      break;
-  }
+  f = find_descriptor(fnum, size, angle);
   if (!f) {
+    Fl_Fontdesc *font = fl_fonts + fnum;
     f = new Fl_Xlib_Font_Descriptor(font->name, size, angle);
+    f->fnum = fnum;
+    add_descriptor(f);
     f->next = font->first;
     font->first = f;
   }
+#if ! USE_PANGO
+  else if (!f->font) f->reopen();
+  else if (f != lru_last) { // now the most recently selected
+    lru_remove(f);
+    lru_append(f);
+  }
+  close_unused_fonts(f);
+#endif
   driver->font_descriptor(f);
 #if XFT_MAJOR < 2 && ! USE_PANGO
   fl_xfont    = f->font->u.core.font;
@@ -1169,7 +1441,7 @@ static XFontStruct* fl_xxfont(Fl_Graphics_Driver *driver) {
 }
 
 XFontStruct* Fl_XFont_On_Demand::value() {
-  if (!ptr) ptr = fl_xxfont(fl_graphics_driver);
+  if (!ptr) ptr = fl_xxfont(&Fl_Graphics_Driver::default_driver());
   return ptr;
 }
 
@@ -1262,6 +1534,7 @@ static void fl_pango_layout_get_pixel_extents(PangoLayout *layout, int &dx, int
 }
 
 void Fl_Xlib_Graphics_Driver::do_draw(int from_right, const char *str, int n, int x, int y) {
+  flush_batch();
   if (!fl_display || n == 0) return;
   Region region = clip_region();
   if (region && XEmptyRegion(region)) return;
@@ -1433,6 +1706,8 @@ int Fl_Xlib_Graphics_Driver::get_font_sizes(Fl_Font fnum, int*& sizep) {
 Fl_Xlib_Font_Descriptor::Fl_Xlib_Font_Descriptor(const char* name, Fl_Fontsize fsize, int fangle) : Fl_Font_Descriptor(name, fsize) {
   fl_open_display();
   angle = fangle;
+  fnum = -1;
+  hash_next = NULL;
   height_ = 0;
   descent_ = 0;
 }
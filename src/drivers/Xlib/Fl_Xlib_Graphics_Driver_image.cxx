@@ -47,12 +47,15 @@
 
 #include <config.h>
 #include "Fl_Xlib_Graphics_Driver.H"
+#include "Fl_Xlib_Shm.H"
+#include "Fl_Xlib_Simd.H"
 #include "../X11/Fl_X11_Screen_Driver.H"
 #include "../X11/Fl_X11_Window_Driver.H"
 #  include <FL/Fl.H>
 #  include <FL/fl_draw.H>
 #  include <FL/platform.H>
 #  include <FL/Fl_Image_Surface.H>
+#  include <FL/Fl_Trace.H>
 #  include "../../Fl_Screen_Driver.H"
 #  include "../../Fl_XColor.H"
 #  include "../../flstring.h"
@@ -358,6 +361,37 @@ mono32_converter(const uchar *from,uchar *to,int w, int delta) {
     (*from << fl_redshift)+(*from << fl_greenshift)+(*from << fl_blueshift));
 }
 
+////////////////////////////////////////////////////////////////
+// Versions of the above converters that convert most of the line with
+// SIMD instructions, when the processor has them, and the rest with
+// the scalar converter. See Fl_Xlib_Simd.
+
+#  define Z Fl_Xlib_Simd::ZERO
+#  define SIMD_SHUFFLE(conv, bpp, p0, p1, p2, p3) \
+static void conv##_simd(const uchar *from, uchar *to, int w, int delta) { \
+  static const uchar pattern[4] = {p0, p1, p2, p3}; \
+  int n = Fl_Xlib_Simd::shuffle(from, to, w, delta, bpp, pattern); \
+  if (n < w) conv(from + n*delta, to + n*bpp, w - n, delta); \
+}
+
+SIMD_SHUFFLE(rgb_converter, 3, 0, 1, 2, Z)
+SIMD_SHUFFLE(bgr_converter, 3, 2, 1, 0, Z)
+SIMD_SHUFFLE(rrr_converter, 3, 0, 0, 0, Z)
+SIMD_SHUFFLE(rgbx_converter, 4, Z, 2, 1, 0)
+SIMD_SHUFFLE(xbgr_converter, 4, 0, 1, 2, Z)
+SIMD_SHUFFLE(xrgb_converter, 4, 2, 1, 0, Z)
+SIMD_SHUFFLE(bgrx_converter, 4, Z, 0, 1, 2)
+SIMD_SHUFFLE(rrrx_converter, 4, Z, 0, 0, 0)
+SIMD_SHUFFLE(xrrr_converter, 4, 0, 0, 0, Z)
+
+#  undef SIMD_SHUFFLE
+#  undef Z
+
+static void argb_premul_converter_simd(const uchar *from, uchar *to, int w, int delta) {
+  int n = Fl_Xlib_Simd::premul(from, to, w, delta);
+  if (n < w) argb_premul_converter(from + n*delta, to + n*4, w - n, delta);
+}
+
 ////////////////////////////////////////////////////////////////
 
 static void figure_out_visual() {
@@ -427,11 +461,11 @@ static void figure_out_visual() {
   case 3:
     if (xi.byte_order) {rs = 16-rs; gs = 16-gs; bs = 16-bs;}
     if (rs == 0 && gs == 8 && bs == 16) {
-      converter = rgb_converter;
-      mono_converter = rrr_converter;
+      converter = rgb_converter_simd;
+      mono_converter = rrr_converter_simd;
     } else if (rs == 16 && gs == 8 && bs == 0) {
-      converter = bgr_converter;
-      mono_converter = rrr_converter;
+      converter = bgr_converter_simd;
+      mono_converter = rrr_converter_simd;
     } else {
       Fl::fatal("Can't do arbitrary 24bit color");
     }
@@ -441,17 +475,17 @@ static void figure_out_visual() {
     if ((xi.byte_order!=0) != WORDS_BIGENDIAN)
       {rs = 24-rs; gs = 24-gs; bs = 24-bs;}
     if (rs == 0 && gs == 8 && bs == 16) {
-      converter = xbgr_converter;
-      mono_converter = xrrr_converter;
+      converter = xbgr_converter_simd;
+      mono_converter = xrrr_converter_simd;
     } else if (rs == 24 && gs == 16 && bs == 8) {
-      converter = rgbx_converter;
-      mono_converter = rrrx_converter;
+      converter = rgbx_converter_simd;
+      mono_converter = rrrx_converter_simd;
     } else if (rs == 8 && gs == 16 && bs == 24) {
-      converter = bgrx_converter;
-      mono_converter = rrrx_converter;
+      converter = bgrx_converter_simd;
+      mono_converter = rrrx_converter_simd;
     } else if (rs == 16 && gs == 8 && bs == 0) {
-      converter = xrgb_converter;
-      mono_converter = xrrr_converter;
+      converter = xrgb_converter_simd;
+      mono_converter = xrrr_converter_simd;
     } else {
       xi.byte_order = WORDS_BIGENDIAN;
       converter = color32_converter;
@@ -467,11 +501,42 @@ static void figure_out_visual() {
 
 #  define MAXBUFFER 0x40000 // 256k
 
+#if HAVE_XSHM
+// Converts the whole image into a shared memory segment and sends it with
+// XShmPutImage(). Returns 0 if the image must be sent with XPutImage() instead.
+static int shm_innards(const uchar *buf, int X, int Y, int W, int dx, int dy, int w, int h,
+                       int delta, int linedelta,
+                       void (*conv)(const uchar *from, uchar *to, int w, int delta),
+                       Fl_Draw_Image_Cb cb, void* userdata, GC gc)
+{
+  int linesize = (w*bytes_per_pixel+scanline_add)&scanline_mask;
+  if (linesize*h < Fl_Xlib_Shm::threshold) return 0;
+  XImage *image = Fl_Xlib_Shm::put_image(&xi, linesize, h);
+  if (!image) return 0;
+  uchar *to = (uchar*)image->data;
+  if (buf) {
+    buf += delta*dx+linedelta*dy;
+    for (int j=0; j<h; j++, buf += linedelta, to += linesize)
+      conv(buf, to, w, delta);
+  } else {
+    STORETYPE* linebuf = new STORETYPE[(W*delta+(sizeof(STORETYPE)-1))/sizeof(STORETYPE)];
+    for (int j=0; j<h; j++, to += linesize) {
+      cb(userdata, dx, dy+j, w, (uchar*)linebuf);
+      conv((uchar*)linebuf, to, w, delta);
+    }
+    delete[] linebuf;
+  }
+  Fl_Xlib_Shm::put(fl_window, gc, image, X+dx, Y+dy, w, h);
+  return 1;
+}
+#endif // HAVE_XSHM
+
 static void innards(const uchar *buf, int X, int Y, int W, int H,
 		    int delta, int linedelta, int mono,
 		    Fl_Draw_Image_Cb cb, void* userdata,
 		    const bool alpha, GC gc)
 {
+  Fl_Xlib_Graphics_Driver::flush_batch();
   if (!linedelta) linedelta = W*abs(delta);
 
   int dx, dy, w, h;
@@ -479,6 +544,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
   if (w<=0 || h<=0) return;
   dx -= X;
   dy -= Y;
+  Fl_Trace::begin("XPutImage", "image");
   if (!bytes_per_pixel) figure_out_visual();
   const unsigned oldbpp = bytes_per_pixel;
   static GC gc32 = None;
@@ -490,7 +556,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
   if (alpha) {
     // This flag states the destination format is ARGB32 (big-endian), pre-multiplied.
     bytes_per_pixel = 4;
-    conv = (mono ? depth2_to_argb_premul_converter : argb_premul_converter);
+    conv = (mono ? depth2_to_argb_premul_converter : argb_premul_converter_simd);
     xi.depth = 32;
     xi.bits_per_pixel = 32;
 
@@ -502,6 +568,11 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
     }
   }
 
+#if HAVE_XSHM
+  // Large images are sent through shared memory when possible:
+  if (shm_innards(buf, X, Y, W, dx, dy, w, h, delta, linedelta, conv, cb, userdata, gc)) {
+  } else
+#endif
   // See if the data is already in the right format.  Unfortunately
   // some 32-bit x servers (XFree86) care about the unknown 8 bits
   // and they must be zero.  I can't confirm this for user-supplied
@@ -518,7 +589,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
 #    endif
       ||
 #  endif
-      conv == rgb_converter && delta==3
+      conv == rgb_converter_simd && delta==3
       ) && !(linedelta&scanline_add)) {
     xi.data = (char *)(buf+delta*dx+linedelta*dy);
     xi.bytes_per_line = linedelta;
@@ -574,6 +645,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
     xi.depth = fl_visual->depth;
     xi.bits_per_pixel = oldbpp * 8;
   }
+  Fl_Trace::end();
 }
 
 void Fl_Xlib_Graphics_Driver::draw_image_unscaled(const uchar* buf, int x, int y, int w, int h, int d, int l){
@@ -625,6 +697,7 @@ void Fl_Xlib_Graphics_Driver::delete_bitmask(Fl_Bitmask bm) {
 }
 
 void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_Bitmap *bm, int X, int Y, int W, int H, int cx, int cy) {
+  flush_batch();
   X = (X+offset_x_)*scale();
   Y = (Y+offset_y_)*scale();
   cache_size(bm, W, H);
@@ -709,9 +782,11 @@ void Fl_Xlib_Graphics_Driver::cache(Fl_RGB_Image *img) {
     *Fl_Graphics_Driver::id(img) = 0;
     return;
   }
+  Fl_Trace::begin("cache Fl_RGB_Image", "image");
   Fl_Surface_Device::push_current(surface);
   fl_draw_image(img->array, 0, 0, img->data_w(), img->data_h(), depth, img->ld());
   Fl_Surface_Device::pop_current();
+  Fl_Trace::end();
   Fl_Offscreen off = Fl_Graphics_Driver::get_offscreen_and_delete_image_surface(surface);
   int *pw, *ph;
   cache_w_h(img, pw, ph);
@@ -722,6 +797,7 @@ void Fl_Xlib_Graphics_Driver::cache(Fl_RGB_Image *img) {
 
 
 void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_RGB_Image *img, int X, int Y, int W, int H, int cx, int cy) {
+  flush_batch();
   X = (X+offset_x_)*scale();
   Y = (Y+offset_y_)*scale();
   cache_size(img, W, H);
@@ -730,6 +806,15 @@ void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_RGB_Image *img, int X, int Y, int W,
     XCopyArea(fl_display, *Fl_Graphics_Driver::id(img), fl_window, gc_, cx, cy, W, H, X, Y);
     return;
   }
+#if HAVE_XRENDER
+  // The cache of an image with alpha is a premultiplied ARGB pixmap:
+  // let the server composite it.
+  if (*Fl_Graphics_Driver::id(img)) {
+    fl_uintptr_t *pict = Fl_Graphics_Driver::mask(img);
+    if (!*pict) *pict = picture_for_pixmap(*Fl_Graphics_Driver::id(img), img->d());
+    if (render_picture(*pict, img->d(), 1, 1, cx, cy, X, Y, W, H)) return;
+  }
+#endif
   // Composite image with alpha manually each time...
   float s = scale();
   Fl_Graphics_Driver::scale(1);
@@ -762,24 +847,52 @@ void Fl_Xlib_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP
     cache(rgb);
   }
   cache_size(rgb, W, H);
-  scale_and_render_pixmap( *Fl_Graphics_Driver::id(rgb), rgb->d(),
-                                 rgb->data_w() / double(rgb->w()*scale()), rgb->data_h() / double(rgb->h()*scale()),
-                          cx*scale(), cy*scale(), (X + offset_x_)*scale(), (Y + offset_y_)*scale(), W, H);
+  // The Picture of the cached pixmap is kept in the mask of the image
+  fl_uintptr_t *pict = Fl_Graphics_Driver::mask(rgb);
+  if (!*pict) *pict = picture_for_pixmap(*Fl_Graphics_Driver::id(rgb), rgb->d());
+  render_picture(*pict, rgb->d(),
+                 rgb->data_w() / double(rgb->w()*scale()), rgb->data_h() / double(rgb->h()*scale()),
+                 cx*scale(), cy*scale(), (X + offset_x_)*scale(), (Y + offset_y_)*scale(), W, H);
+}
+
+/* Returns an XRender Picture of an Fl_Offscreen holding an image of depth
+ \p depth: premultiplied ARGB if depth is 2 or 4, RGB otherwise.
+ */
+fl_uintptr_t Fl_Xlib_Graphics_Driver::picture_for_pixmap(Fl_Offscreen pixmap, int depth) {
+  static XRenderPictFormat *fmt24 = XRenderFindStandardFormat(fl_display, PictStandardRGB24);
+  static XRenderPictFormat *fmt32 = XRenderFindStandardFormat(fl_display, PictStandardARGB32);
+  bool has_alpha = (depth == 2 || depth == 4);
+  XRenderPictureAttributes srcattr;
+  memset(&srcattr, 0, sizeof(XRenderPictureAttributes));
+  return XRenderCreatePicture(fl_display, pixmap, has_alpha ? fmt32 : fmt24, 0, &srcattr);
 }
 
 /* Draws with Xrender an Fl_Offscreen with optional scaling and accounting for transparency if necessary.
  XP,YP,WP,HP are in drawing units
  */
 int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int depth, double scale_x, double scale_y, int srcx, int srcy, int XP, int YP, int WP, int HP) {
+  Picture src = picture_for_pixmap(pixmap, depth);
+  int ret = render_picture(src, depth, scale_x, scale_y, srcx, srcy, XP, YP, WP, HP);
+  if (src) XRenderFreePicture(fl_display, src);
+  return ret;
+}
+
+/* Composites an XRender Picture made by picture_for_pixmap() on the
+ current drawable, with optional scaling. The transform and filter
+ of the Picture are set for each call, so it can be kept with the image.
+ */
+int Fl_Xlib_Graphics_Driver::render_picture(fl_uintptr_t picture, int depth, double scale_x, double scale_y, int srcx, int srcy, int XP, int YP, int WP, int HP) {
+  flush_batch();
   bool has_alpha = (depth == 2 || depth == 4);
-  XRenderPictureAttributes srcattr;
-  memset(&srcattr, 0, sizeof(XRenderPictureAttributes));
-  static XRenderPictFormat *fmt24 = XRenderFindStandardFormat(fl_display, PictStandardRGB24);
-  static XRenderPictFormat *fmt32 = XRenderFindStandardFormat(fl_display, PictStandardARGB32);
-  Picture src = XRenderCreatePicture(fl_display, pixmap, has_alpha ?fmt32:fmt24, 0, &srcattr);
-  Picture dst = XRenderCreatePicture(fl_display, fl_window, fmt24, 0, &srcattr);
+  Picture src = (Picture)picture;
+  // the format of windows and of offscreens made for them
+  static XRenderPictFormat *dst_fmt = XRenderFindVisualFormat(fl_display, fl_visual->visual);
+  XRenderPictureAttributes dstattr;
+  memset(&dstattr, 0, sizeof(XRenderPictureAttributes));
+  Picture dst = dst_fmt ? XRenderCreatePicture(fl_display, fl_window, dst_fmt, 0, &dstattr) : 0;
   if (!src || !dst) {
     fprintf(stderr, "Failed to create Render pictures (%lu %lu)\n", src, dst);
+    if (dst) XRenderFreePicture(fl_display, dst);
     return 0;
   }
   Fl_Region r = scale_clip(scale());
@@ -787,17 +900,17 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
   if (clipr)
     XRenderSetPictureClipRegion(fl_display, dst, clipr);
   unscale_clip(r);
-  if (scale_x != 1 || scale_y != 1) {
-    XTransform mat = {{
-      { XDoubleToFixed( scale_x ), XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ) },
-      { XDoubleToFixed( 0 ),       XDoubleToFixed( scale_y ), XDoubleToFixed( 0 ) },
-      { XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ),       XDoubleToFixed( 1 ) }
-    }};
-    XRenderSetPictureTransform(fl_display, src, &mat);
-  }
+  XTransform mat = {{
+    { XDoubleToFixed( scale_x ), XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ) },
+    { XDoubleToFixed( 0 ),       XDoubleToFixed( scale_y ), XDoubleToFixed( 0 ) },
+    { XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ),       XDoubleToFixed( 1 ) }
+  }};
+  XRenderSetPictureTransform(fl_display, src, &mat);
+  bool smooth = (scale_x != 1 || scale_y != 1) &&
+    Fl_Image::scaling_algorithm() == FL_RGB_SCALING_BILINEAR;
+  XRenderSetPictureFilter(fl_display, src, smooth ? FilterBilinear : FilterNearest, 0, 0);
   XRenderComposite(fl_display, (has_alpha ? PictOpOver : PictOpSrc), src, None, dst, srcx, srcy, 0, 0,
                    XP, YP, WP, HP);
-  XRenderFreePicture(fl_display, src);
   XRenderFreePicture(fl_display, dst);
   return 1;
 }
@@ -806,6 +919,12 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
 
 void Fl_Xlib_Graphics_Driver::uncache(Fl_RGB_Image*, fl_uintptr_t &id_, fl_uintptr_t &mask_)
 {
+#if HAVE_XRENDER
+  if (mask_) { // the Picture of id_
+    XRenderFreePicture(fl_display, (Picture)mask_);
+    mask_ = 0;
+  }
+#endif
   if (id_) {
     XFreePixmap(fl_display, (Fl_Offscreen)id_);
     id_ = 0;
@@ -821,6 +940,7 @@ void Fl_Xlib_Graphics_Driver::cache(Fl_Bitmap *bm) {
 }
 
 void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_Pixmap *pxm, int X, int Y, int W, int H, int cx, int cy) {
+  flush_batch();
   X = (X+offset_x_)*scale();
   Y = (Y+offset_y_)*scale();
   cache_size(pxm, W, H);
@@ -887,6 +1007,7 @@ void Fl_Xlib_Graphics_Driver::cache(Fl_Pixmap *pxm) {
 }
 
 void Fl_Xlib_Graphics_Driver::uncache_pixmap(fl_uintptr_t offscreen) {
+  flush_batch();
   XFreePixmap(fl_display, (Fl_Offscreen)offscreen);
 }
 
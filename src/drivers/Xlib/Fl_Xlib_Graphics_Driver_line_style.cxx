@@ -55,6 +55,7 @@ void Fl_Xlib_Graphics_Driver::line_style_unscaled(int style, float width, char*
     ndashes = p-buf;
 if (*dashes == 0) ndashes = 0;//against error with very small scaling
   }
+  flush_batch();
   static int Cap[4] = {CapButt, CapButt, CapRound, CapProjecting};
   static int Join[4] = {JoinMiter, JoinMiter, JoinRound, JoinBevel};
   XSetLineAttributes(fl_display, gc_,
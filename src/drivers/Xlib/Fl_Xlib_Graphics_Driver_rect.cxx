@@ -28,6 +28,7 @@
 #include <FL/platform.H>
 
 #include "Fl_Xlib_Graphics_Driver.H"
+#include <FL/Fl_Stats.H>
 
 // Arbitrary line clipping: clip line end points to 16-bit coordinate range.
 
@@ -213,6 +214,7 @@ void Fl_Xlib_Graphics_Driver::XDestroyRegion(Fl_Region r) {
 // called only when scale_ has integer value
 void Fl_Xlib_Graphics_Driver::rect_unscaled(float fx, float fy, float fw, float fh) {
   if (fw<=0 || fh<=0) return;
+  flush_batch();
   int deltaf = scale() >= 2 ? scale()-1 : 0;
   fx += offset_x_*scale(); fy += offset_y_*scale();
   int x = fx; int y = fy;
@@ -231,7 +233,7 @@ void Fl_Xlib_Graphics_Driver::rectf_unscaled(float fx, float fy, float fw, float
   int w = int(int(fx/scale()+fw/scale()+0.5)*scale()) - int(fx);
   int h = int(int(fy/scale()+fh/scale()+0.5)*scale()) - int(fy);
   if (!clip_rect(x, y, w, h))
-    XFillRectangle(fl_display, fl_window, gc_, x+line_delta_, y+line_delta_, w, h);
+    batch_rect(x+line_delta_, y+line_delta_, w, h);
 }
 
 void Fl_Xlib_Graphics_Driver::point_unscaled(float fx, float fy) {
@@ -240,7 +242,8 @@ void Fl_Xlib_Graphics_Driver::point_unscaled(float fx, float fy) {
   int y = fy+offset_y_*scale()-deltaf;
   int width = scale() >= 1 ? scale() : 1;
   // *FIXME* This needs X coordinate clipping:
-  XFillRectangle(fl_display, fl_window, gc_, x+line_delta_, y+line_delta_, width, width);
+  if (width == 1) batch_point(x+line_delta_, y+line_delta_);
+  else batch_rect(x+line_delta_, y+line_delta_, width, width);
 }
 
 void Fl_Xlib_Graphics_Driver::line_unscaled(float x, float y, float x1, float y1) {
@@ -251,6 +254,7 @@ void Fl_Xlib_Graphics_Driver::line_unscaled(float x, float y, float x1, float y1
 
 void Fl_Xlib_Graphics_Driver::line_unscaled(float x, float y, float x1, float y1, float x2, float y2) {
   XPoint p[3];
+  flush_batch();
   p[0].x = x+offset_x_*scale()+line_delta_;  p[0].y = y+offset_y_*scale()+line_delta_;
   p[1].x = x1+offset_x_*scale()+line_delta_; p[1].y = y1+offset_y_*scale()+line_delta_;
   p[2].x = x2+offset_x_*scale()+line_delta_; p[2].y = y2+offset_y_*scale()+line_delta_;
@@ -290,6 +294,7 @@ void Fl_Xlib_Graphics_Driver::yxline_unscaled(float x, float y, float y1) {
 
 void Fl_Xlib_Graphics_Driver::loop_unscaled(float x, float y, float x1, float y1, float x2, float y2) {
   XPoint p[4];
+  flush_batch();
   p[0].x = x +offset_x_*scale()+line_delta_;  p[0].y = y +offset_y_*scale()+line_delta_;
   p[1].x = x1 +offset_x_*scale()+line_delta_; p[1].y = y1 +offset_y_*scale()+line_delta_;
   p[2].x = x2 +offset_x_*scale()+line_delta_; p[2].y = y2 +offset_y_*scale()+line_delta_;
@@ -300,6 +305,7 @@ void Fl_Xlib_Graphics_Driver::loop_unscaled(float x, float y, float x1, float y1
 
 void Fl_Xlib_Graphics_Driver::loop_unscaled(float x, float y, float x1, float y1, float x2, float y2, float x3, float y3) {
   XPoint p[5];
+  flush_batch();
   p[0].x = x+offset_x_*scale()+line_delta_;  p[0].y = y+offset_y_*scale()+line_delta_;
   p[1].x = x1 +offset_x_*scale()+line_delta_; p[1].y = y1+offset_y_*scale()+line_delta_;
   p[2].x = x2+offset_x_*scale()+line_delta_; p[2].y = y2+offset_y_*scale()+line_delta_;
@@ -311,6 +317,7 @@ void Fl_Xlib_Graphics_Driver::loop_unscaled(float x, float y, float x1, float y1
 
 void Fl_Xlib_Graphics_Driver::polygon_unscaled(float x, float y, float x1, float y1, float x2, float y2) {
   XPoint p[4];
+  flush_batch();
   p[0].x = x+offset_x_*scale()+line_delta_;  p[0].y = y+offset_y_*scale()+line_delta_;
   p[1].x = x1+offset_x_*scale()+line_delta_; p[1].y = y1+offset_y_*scale()+line_delta_;
   p[2].x = x2+offset_x_*scale()+line_delta_; p[2].y = y2+offset_y_*scale()+line_delta_;
@@ -322,6 +329,7 @@ void Fl_Xlib_Graphics_Driver::polygon_unscaled(float x, float y, float x1, float
 
 void Fl_Xlib_Graphics_Driver::polygon_unscaled(float x, float y, float x1, float y1, float x2, float y2, float x3, float y3) {
   XPoint p[5];
+  flush_batch();
   p[0].x = x+offset_x_*scale()+line_delta_;  p[0].y = y+offset_y_*scale()+line_delta_;
   p[1].x = x1+offset_x_*scale()+line_delta_; p[1].y = y1+offset_y_*scale()+line_delta_;
   p[2].x = x2+offset_x_*scale()+line_delta_; p[2].y = y2+offset_y_*scale()+line_delta_;
@@ -339,7 +347,117 @@ void Fl_Xlib_Graphics_Driver::polygon_unscaled(float x, float y, float x1, float
 
 void Fl_Xlib_Graphics_Driver::draw_clipped_line(int x1, int y1, int x2, int y2) {
   if (!clip_line(x1, y1, x2, y2))
+    batch_segment(x1, y1, x2, y2);
+}
+
+// --- batching of simple primitives
+
+// Consecutive XFillRectangle() or XDrawLine() calls are already merged by
+// Xlib into one request, but any other request in between, such as a line
+// between two rectangles, starts a new one. The queues below keep rectangles,
+// lines and points apart, so that a widget drawing all of them in one color
+// costs at most three requests. This is correct because the queued primitives
+// are drawn with the same GC: their order doesn't change the result, with
+// GXcopy as with GXxor. Anything that changes the GC or draws otherwise
+// calls flush_batch() first.
+// Programs may draw with fl_gc and change it between FLTK calls, so the
+// queues are only used when fl_x11_batch_primitives() enabled them.
+
+int Fl_Xlib_Graphics_Driver::batch_ = 0;
+Drawable Fl_Xlib_Graphics_Driver::batch_window_ = 0;
+int Fl_Xlib_Graphics_Driver::batch_rects_n_ = 0;
+int Fl_Xlib_Graphics_Driver::batch_segs_n_ = 0;
+int Fl_Xlib_Graphics_Driver::batch_points_n_ = 0;
+XRectangle Fl_Xlib_Graphics_Driver::batch_rects_[BATCH_SIZE];
+XSegment Fl_Xlib_Graphics_Driver::batch_segs_[BATCH_SIZE];
+XPoint Fl_Xlib_Graphics_Driver::batch_points_[BATCH_SIZE];
+
+void Fl_Xlib_Graphics_Driver::flush_batch_() {
+  int requests = 0;
+  if (gc_ && batch_window_) {
+    if (batch_rects_n_) {
+      XFillRectangles(fl_display, batch_window_, gc_, batch_rects_, batch_rects_n_);
+      requests++;
+    }
+    if (batch_segs_n_) {
+      XDrawSegments(fl_display, batch_window_, gc_, batch_segs_, batch_segs_n_);
+      requests++;
+    }
+    if (batch_points_n_) {
+      XDrawPoints(fl_display, batch_window_, gc_, batch_points_, batch_points_n_, CoordModeOrigin);
+      requests++;
+    }
+  }
+  Fl_Stats::count(FL_STATS_REQUESTS, requests);
+  batch_rects_n_ = batch_segs_n_ = batch_points_n_ = 0;
+}
+
+void Fl_Xlib_Graphics_Driver::batch_rect(int x, int y, int w, int h) {
+  if (!batch_) {
+    XFillRectangle(fl_display, fl_window, gc_, x, y, w, h);
+    return;
+  }
+  if (fl_window != batch_window_ || batch_rects_n_ == BATCH_SIZE) {
+    flush_batch();
+    batch_window_ = fl_window;
+  }
+  XRectangle *r = batch_rects_ + batch_rects_n_++;
+  r->x = x; r->y = y; r->width = w; r->height = h;
+  Fl_Stats::count(FL_STATS_PRIMITIVES);
+}
+
+void Fl_Xlib_Graphics_Driver::batch_segment(int x1, int y1, int x2, int y2) {
+  if (!batch_) {
     XDrawLine(fl_display, fl_window, gc_, x1, y1, x2, y2);
+    return;
+  }
+  if (fl_window != batch_window_ || batch_segs_n_ == BATCH_SIZE) {
+    flush_batch();
+    batch_window_ = fl_window;
+  }
+  XSegment *s = batch_segs_ + batch_segs_n_++;
+  s->x1 = x1; s->y1 = y1; s->x2 = x2; s->y2 = y2;
+  Fl_Stats::count(FL_STATS_PRIMITIVES);
+}
+
+void Fl_Xlib_Graphics_Driver::batch_point(int x, int y) {
+  if (!batch_) {
+    XDrawPoint(fl_display, fl_window, gc_, x, y);
+    return;
+  }
+  if (fl_window != batch_window_ || batch_points_n_ == BATCH_SIZE) {
+    flush_batch();
+    batch_window_ = fl_window;
+  }
+  XPoint *p = batch_points_ + batch_points_n_++;
+  p->x = x; p->y = y;
+  Fl_Stats::count(FL_STATS_PRIMITIVES);
+}
+
+/**
+ Makes FLTK queue the filled rectangles, lines and points it draws on X11,
+ and send each kind in a single request. This is off by default.
+
+ Queued shapes are sent later with the GC of FLTK, so a program that turns
+ this on must call fl_graphics_driver->gc() before it draws with \c fl_gc
+ or \c fl_window, and before it changes \c fl_gc, for instance with
+ XSetForeground(), XSetFunction() or XSetClipMask(). See "Drawing using
+ Xlib" in the chapter on platform specific issues.
+ \param on non-zero to queue shapes, 0 to draw them at once
+ \version 1.4.0
+ */
+void fl_x11_batch_primitives(int on) {
+  Fl_Xlib_Graphics_Driver::batch(on);
+}
+
+/** Returns non-zero if FLTK queues shapes, see fl_x11_batch_primitives(int). */
+int fl_x11_batch_primitives() {
+  return Fl_Xlib_Graphics_Driver::batch();
+}
+
+void Fl_Xlib_Graphics_Driver::batch(int on) {
+  if (!on) flush_batch();
+  batch_ = (on != 0);
 }
 
 // --- clipping
@@ -414,6 +532,7 @@ void Fl_Xlib_Graphics_Driver::pop_clip() {
 
 void Fl_Xlib_Graphics_Driver::restore_clip() {
   fl_clip_state_number++;
+  flush_batch();
   if (gc_) {
     Region r = rstack[rstackptr];
     if (r) {
@@ -17,11 +17,22 @@
 //
 
 #include "Fl_Xlib_Graphics_Driver.H"
+#include "../PicoHeadless/Fl_PicoHeadless_Graphics_Driver.H"
+#include "../../Fl_Display_List.H"
 #include <FL/Fl_Image_Surface.H>
 #include "../../Fl_Screen_Driver.H"
 
+// In tiled mode, the surface records the drawing, and draws it in memory
+// with the software driver of the headless platform, in tiles with several
+// threads, when image() is called or the surface stops being current.
+// image() then copies the memory, without asking the pixels to the X server.
 class Fl_Xlib_Image_Surface_Driver : public Fl_Image_Surface_Driver {
   virtual void end_current_();
+  Fl_Graphics_Driver *xlib_;                  // draws into the offscreen
+  Fl_PicoHeadless_Graphics_Driver *pixels_;  // draws the tiled mode in memory
+  Fl_Display_List *list_;                    // the drawing of the tiled mode
+  int tile_size_, threads_, scaled_;
+  void draw_tiles();
 public:
   Window pre_window;
   Fl_Xlib_Image_Surface_Driver(int w, int h, int high_res, Fl_Offscreen off);
@@ -30,6 +41,7 @@ public:
   void translate(int x, int y);
   void untranslate();
   Fl_RGB_Image *image();
+  int tiled(int tile_size, int threads);
 };
 
 Fl_Image_Surface_Driver *Fl_Image_Surface_Driver::newImageSurfaceDriver(int w, int h, int high_res, Fl_Offscreen off)
@@ -48,13 +60,25 @@ Fl_Xlib_Image_Surface_Driver::Fl_Xlib_Image_Surface_Driver(int w, int h, int hig
     }
     offscreen = XCreatePixmap(fl_display, RootWindow(fl_display, fl_screen), w, h, fl_visual->depth);
   }
-  driver(new Fl_Xlib_Graphics_Driver());
-  if (d != 1 && high_res) ((Fl_Xlib_Graphics_Driver*)driver())->scale(d);
+  xlib_ = new Fl_Xlib_Graphics_Driver();
+  driver(xlib_);
+  scaled_ = (d != 1 && high_res);
+  if (scaled_) ((Fl_Xlib_Graphics_Driver*)xlib_)->scale(d);
+  pixels_ = 0;
+  list_ = 0;
+  tile_size_ = threads_ = 0;
 }
 
 Fl_Xlib_Image_Surface_Driver::~Fl_Xlib_Image_Surface_Driver() {
+  Fl_Xlib_Graphics_Driver::flush_batch();
   if (offscreen && !external_offscreen) XFreePixmap(fl_display, offscreen);
-  delete driver();
+  if (list_) {
+    delete driver();
+    delete list_;
+    delete pixels_->buffer();
+    delete pixels_;
+  }
+  delete xlib_;
 }
 
 void Fl_Xlib_Image_Surface_Driver::set_current() {
@@ -64,21 +88,60 @@ void Fl_Xlib_Image_Surface_Driver::set_current() {
 }
 
 void Fl_Xlib_Image_Surface_Driver::translate(int x, int y) {
-  ((Fl_Xlib_Graphics_Driver*)driver())->translate_all(x, y);
+  if (list_) ((Fl_Display_List_Driver*)driver())->translate_all(x, y);
+  else ((Fl_Xlib_Graphics_Driver*)driver())->translate_all(x, y);
 }
 
 void Fl_Xlib_Image_Surface_Driver::untranslate() {
-  ((Fl_Xlib_Graphics_Driver*)driver())->untranslate_all();
+  if (list_) ((Fl_Display_List_Driver*)driver())->untranslate_all();
+  else ((Fl_Xlib_Graphics_Driver*)driver())->untranslate_all();
+}
+
+// The memory of the tiled mode has the size of the surface in pixels, so a
+// surface that the GUI scale factor enlarges keeps drawing with Xlib, as does
+// a surface that draws into an offscreen of the caller.
+int Fl_Xlib_Image_Surface_Driver::tiled(int tile_size, int threads) {
+  if (!offscreen || external_offscreen || scaled_) return 0;
+  if (!list_) {
+    pixels_ = new Fl_PicoHeadless_Graphics_Driver();
+    pixels_->buffer(new Fl_PicoHeadless_Buffer(width, height));
+    list_ = new Fl_Display_List();
+    driver(new Fl_Display_List_Driver(list_, pixels_));
+  }
+  tile_size_ = tile_size > 0 ? tile_size : 256;
+  threads_ = threads;
+  return 1;
+}
+
+// Draws the recorded drawing into the memory of the tiled mode, and forgets it.
+void Fl_Xlib_Image_Surface_Driver::draw_tiles() {
+  if (!list_) return;
+  pixels_->draw_tiles(list_, tile_size_, threads_);
+  list_->clear();
 }
 
 Fl_RGB_Image* Fl_Xlib_Image_Surface_Driver::image()
 {
-  Fl_RGB_Image *image = Fl::screen_driver()->read_win_rectangle(0, 0, width, height);
+  if (!list_) return Fl::screen_driver()->read_win_rectangle(0, 0, width, height);
+  draw_tiles();
+  Fl_PicoHeadless_Buffer *buffer = pixels_->buffer();
+  uchar *array = new uchar[buffer->w * buffer->h * 3];
+  const uchar *from = buffer->pixels;
+  uchar *to = array;
+  for (int i = buffer->w * buffer->h; i > 0; i--, from += 4, to += 3) {
+    to[0] = from[0];
+    to[1] = from[1];
+    to[2] = from[2];
+  }
+  Fl_RGB_Image *image = new Fl_RGB_Image(array, buffer->w, buffer->h, 3);
+  image->alloc_array = 1;
   return image;
 }
 
 void Fl_Xlib_Image_Surface_Driver::end_current_()
 {
+  if (list_) draw_tiles();
+  else Fl_Xlib_Graphics_Driver::flush_batch();
   fl_window = pre_window;
 }
 
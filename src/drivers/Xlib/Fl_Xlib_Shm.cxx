@@ -0,0 +1,202 @@
+//
+// "$Id$"
+//
+// MIT-SHM image transfer for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Xlib_Shm.H"
+
+#if HAVE_XSHM
+
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Shm_Segment {
+  XShmSegmentInfo info;
+  size_t size;
+  int pending;          // a XShmPutImage() from this segment may not be complete
+  XImage image;         // describes the segment to XShmPutImage()
+};
+
+static int shm_state = -1;      // -1: not checked, 0: unusable, 1: usable
+static int completion_type;     // type of the ShmCompletion events
+static Shm_Segment put_segment[2];
+static int next_put = 0;
+static Shm_Segment get_segment;
+static XImage *get_image = NULL;
+
+static int shm_error;
+extern "C" {
+  static int shm_error_handler(Display *, XErrorEvent *) {
+    shm_error = 1;
+    return 0;
+  }
+}
+
+static void free_segment(Shm_Segment *seg) {
+  if (!seg->size) return;
+  XShmDetach(fl_display, &seg->info);
+  shmdt(seg->info.shmaddr);
+  seg->size = 0;
+  seg->pending = 0;
+}
+
+// Makes sure seg has at least size bytes. Returns 0 if shared memory can't be used.
+static int make_segment(Shm_Segment *seg, size_t size) {
+  if (seg->size >= size) return 1;
+  free_segment(seg);
+  size = (size + 0xffff) & ~(size_t)0xffff;
+  seg->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (seg->info.shmid < 0) return 0;
+  seg->info.shmaddr = (char*)shmat(seg->info.shmid, NULL, 0);
+  if (seg->info.shmaddr == (char*)-1) {
+    shmctl(seg->info.shmid, IPC_RMID, NULL);
+    return 0;
+  }
+  seg->info.readOnly = False;
+  // The server refuses to attach if it runs on another machine or in
+  // another IPC namespace: find it out synchronously.
+  shm_error = 0;
+  XErrorHandler old_handler = XSetErrorHandler(shm_error_handler);
+  Status ok = XShmAttach(fl_display, &seg->info);
+  XSync(fl_display, False);
+  XSetErrorHandler(old_handler);
+  // the segment disappears when both sides detached it, even after a crash
+  shmctl(seg->info.shmid, IPC_RMID, NULL);
+  if (!ok || shm_error) {
+    shmdt(seg->info.shmaddr);
+    return 0;
+  }
+  seg->size = size;
+  return 1;
+}
+
+static Bool is_completion(Display *, XEvent *e, XPointer arg) {
+  return e->type == completion_type &&
+         ((XShmCompletionEvent*)e)->shmseg == ((Shm_Segment*)arg)->info.shmseg;
+}
+
+// Waits until the server no longer reads the segment.
+static void wait_completion(Shm_Segment *seg) {
+  if (!seg->pending) return;
+  XEvent e;
+  if (!XCheckIfEvent(fl_display, &e, is_completion, (XPointer)seg)) {
+    // After XSync() the server has processed the request, whether or not its
+    // completion event was already consumed by the event loop, or lost
+    // because of an error.
+    XSync(fl_display, False);
+    XCheckIfEvent(fl_display, &e, is_completion, (XPointer)seg);
+  }
+  seg->pending = 0;
+}
+
+/**
+ Returns non-zero if images can be transferred with shared memory.
+ */
+int Fl_Xlib_Shm::available() {
+  if (shm_state >= 0) return shm_state;
+  shm_state = 0;
+  if (getenv("FLTK_NO_XSHM")) return 0;
+  if (!XShmQueryExtension(fl_display)) return 0;
+  // don't even try if the display is reached through the network
+  const char *name = DisplayString(fl_display);
+  const char *colon = strrchr(name, ':');
+  if (colon && colon > name && *name != '/' && strncmp(name, "unix:", 5)) return 0;
+  if (!make_segment(put_segment, threshold)) return 0;
+  completion_type = XShmGetEventBase(fl_display) + ShmCompletion;
+  shm_state = 1;
+  return 1;
+}
+
+/**
+ Returns an image in a shared memory segment, ready to be filled with
+ \p h lines of \p bytes_per_line bytes in the format of \p model, and
+ to be sent by put(). Returns NULL if the format can't be sent through
+ shared memory, in which case the caller must use XPutImage().
+ */
+XImage *Fl_Xlib_Shm::put_image(const XImage *model, int bytes_per_line, int h) {
+  if (!available()) return NULL;
+  // The server computes the length of lines from the image width and its
+  // own padding: the width must cover the whole line, and the image
+  // must be in the byte order of the server.
+  int bits = model->bits_per_pixel;
+  if ((bytes_per_line * 8) % bits) return NULL;
+  if (model->byte_order != ImageByteOrder(fl_display)) return NULL;
+  Shm_Segment *seg = put_segment + next_put;
+  wait_completion(seg);
+  if (!make_segment(seg, (size_t)bytes_per_line * h)) return NULL;
+  XImage *image = &seg->image;
+  *image = *model;
+  image->width = bytes_per_line * 8 / bits;
+  image->height = h;
+  image->bytes_per_line = bytes_per_line;
+  image->data = seg->info.shmaddr;
+  image->obdata = (char*)&seg->info;
+  return image;
+}
+
+/**
+ Sends the top-left \p W x \p H pixels of an image obtained from put_image()
+ to \p d at \p X, \p Y. The segment is not reused before the server
+ has finished with it.
+ */
+void Fl_Xlib_Shm::put(Drawable d, GC gc, XImage *image, int X, int Y, int W, int H) {
+  Shm_Segment *seg = put_segment + next_put;
+  XShmPutImage(fl_display, d, gc, image, 0, 0, X, Y, W, H, True);
+  seg->pending = 1;
+  next_put = !next_put;
+}
+
+/**
+ Reads a rectangle of \p d into a shared memory image, like XGetImage().
+ The image belongs to this class and remains valid until the next call;
+ don't destroy it.
+ \return NULL if shared memory can't be used or the server refused the request.
+ */
+XImage *Fl_Xlib_Shm::get(Drawable d, int X, int Y, int W, int H) {
+  if (!available()) return NULL;
+  if (get_image) {
+    get_image->data = NULL;
+    get_image->obdata = NULL;
+    XDestroyImage(get_image);
+    get_image = NULL;
+  }
+  XImage *image = XShmCreateImage(fl_display, fl_visual->visual, fl_visual->depth,
+                                  ZPixmap, NULL, &get_segment.info, W, H);
+  if (!image) return NULL;
+  if (!make_segment(&get_segment, (size_t)image->bytes_per_line * H)) {
+    image->obdata = NULL;
+    XDestroyImage(image);
+    return NULL;
+  }
+  image->data = get_segment.info.shmaddr;
+  shm_error = 0;
+  XErrorHandler old_handler = XSetErrorHandler(shm_error_handler);
+  Status ok = XShmGetImage(fl_display, d, image, X, Y, AllPlanes);
+  XSetErrorHandler(old_handler);
+  get_image = image;
+  if (!ok || shm_error) return NULL;
+  return image;
+}
+
+#endif // HAVE_XSHM
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,270 @@
+//
+// "$Id$"
+//
+// Vectorized pixel converters for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <config.h>
+#include "Fl_Xlib_Simd.H"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !WORDS_BIGENDIAN
+#  define SIMD_X86 1
+#  include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !WORDS_BIGENDIAN
+#  define SIMD_NEON 1
+#  include <arm_neon.h>
+#endif
+
+// Instruction sets, in increasing order
+enum { SCALAR, SSE2, SSSE3, AVX2, NEON };
+static const char *level_names[] = { "scalar", "SSE2", "SSSE3", "AVX2", "NEON" };
+
+static int level_ = -1;   // -1: not selected yet
+
+static int best_level() {
+#if SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return AVX2;
+  if (__builtin_cpu_supports("ssse3")) return SSSE3;
+  if (__builtin_cpu_supports("sse2")) return SSE2;
+#elif SIMD_NEON
+  return NEON;
+#endif
+  return SCALAR;
+}
+
+// Builds the byte shuffle of 4 pixels: output byte k of pixel i is input byte
+// pattern[k] of pixel i, or 0.
+static void make_mask(uchar *mask, int delta, int out_bpp, const uchar *pattern) {
+  int n = 0;
+  for (int i = 0; i < 4; i++)
+    for (int k = 0; k < out_bpp; k++)
+      mask[n++] = pattern[k] == Fl_Xlib_Simd::ZERO ? 0x80 : uchar(i * delta + pattern[k]);
+  while (n < 16) mask[n++] = 0x80;
+}
+
+#if SIMD_X86
+
+__attribute__((target("ssse3")))
+static int shuffle_ssse3(const uchar *from, uchar *to, int w, int delta,
+                         int out_bpp, const uchar *m) {
+  __m128i mask = _mm_loadu_si128((const __m128i*)m);
+  int i = 0;
+  // each step reads and writes 16 bytes, and advances by 4 pixels
+  for (; (w - i) * delta >= 16 && (w - i) * out_bpp >= 16; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(from + i * delta));
+    _mm_storeu_si128((__m128i*)(to + i * out_bpp), _mm_shuffle_epi8(v, mask));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int shuffle_avx2(const uchar *from, uchar *to, int w, int delta,
+                        int out_bpp, const uchar *m) {
+  if (out_bpp != 4) return shuffle_ssse3(from, to, w, delta, out_bpp, m);
+  __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m));
+  int i = 0;
+  // each step reads 16 bytes at 2 places, writes 32 bytes, and advances by 8 pixels
+  for (; (w - i) * delta >= 4 * delta + 16 && w - i >= 8; i += 8) {
+    const uchar *f = from + i * delta;
+    __m256i v = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)f)),
+      _mm_loadu_si128((const __m128i*)(f + 4 * delta)), 1);
+    _mm256_storeu_si256((__m256i*)(to + i * 4), _mm256_shuffle_epi8(v, mask));
+  }
+  return i + shuffle_ssse3(from + i * delta, to + i * 4, w - i, delta, 4, m);
+}
+
+// x * y / 255 for 16-bit lanes, exact for x, y <= 255
+#define DIV255(x) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), one), _mm_srli_epi16((x), 8)), 8)
+
+// RGBA to premultiplied ARGB, in the byte order of a little-endian 32-bit int
+__attribute__((target("sse2")))
+static int premul_sse2(const uchar *from, uchar *to, int w) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+  const __m128i green = _mm_set1_epi32(0x0000ff00);
+  const __m128i low = _mm_set1_epi32(0x000000ff);
+  int i = 0;
+  for (; w - i >= 4; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(from + 4 * i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+    __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+    lo = _mm_mullo_epi16(lo, alo);
+    hi = _mm_mullo_epi16(hi, ahi);
+    __m128i p = _mm_packus_epi16(DIV255(lo), DIV255(hi));
+    // keep the original alpha, and swap red and blue
+    p = _mm_or_si128(_mm_andnot_si128(alpha, p), _mm_and_si128(alpha, v));
+    p = _mm_or_si128(_mm_or_si128(_mm_and_si128(p, _mm_or_si128(alpha, green)),
+                                  _mm_slli_epi32(_mm_and_si128(p, low), 16)),
+                     _mm_and_si128(_mm_srli_epi32(p, 16), low));
+    _mm_storeu_si128((__m128i*)(to + 4 * i), p);
+  }
+  return i;
+}
+
+#undef DIV255
+#define DIV255(x) _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16((x), one), _mm256_srli_epi16((x), 8)), 8)
+
+__attribute__((target("avx2")))
+static int premul_avx2(const uchar *from, uchar *to, int w) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi16(1);
+  const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+  // per lane: alpha of each pixel to its 4 channels, and red <-> blue
+  const __m256i spread = _mm256_setr_epi8(
+    3,3,3,3, 7,7,7,7, 11,11,11,11, 15,15,15,15,
+    3,3,3,3, 7,7,7,7, 11,11,11,11, 15,15,15,15);
+  const __m256i swap = _mm256_setr_epi8(
+    2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+    2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+  int i = 0;
+  for (; w - i >= 8; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(from + 4 * i));
+    __m256i a = _mm256_shuffle_epi8(v, spread);
+    __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_unpacklo_epi8(a, zero));
+    __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), _mm256_unpackhi_epi8(a, zero));
+    __m256i p = _mm256_packus_epi16(DIV255(lo), DIV255(hi));
+    p = _mm256_or_si256(_mm256_andnot_si256(alpha, p), _mm256_and_si256(alpha, v));
+    _mm256_storeu_si256((__m256i*)(to + 4 * i), _mm256_shuffle_epi8(p, swap));
+  }
+  return i + premul_sse2(from + 4 * i, to + 4 * i, w - i);
+}
+
+#undef DIV255
+
+#endif // SIMD_X86
+
+#if SIMD_NEON
+
+static int shuffle_neon(const uchar *from, uchar *to, int w, int delta,
+                        int out_bpp, const uchar *m) {
+  uint8x16_t mask = vld1q_u8(m); // indexes >= 16 give 0
+  int i = 0;
+  for (; (w - i) * delta >= 16 && (w - i) * out_bpp >= 16; i += 4) {
+    uint8x16_t v = vld1q_u8(from + i * delta);
+    vst1q_u8(to + i * out_bpp, vqtbl1q_u8(v, mask));
+  }
+  return i;
+}
+
+static inline uint8x8_t div255_neon(uint16x8_t x) {
+  return vshrn_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+static inline uint8x16_t mul255_neon(uint8x16_t c, uint8x16_t a) {
+  return vcombine_u8(div255_neon(vmull_u8(vget_low_u8(c), vget_low_u8(a))),
+                     div255_neon(vmull_u8(vget_high_u8(c), vget_high_u8(a))));
+}
+
+static int premul_neon(const uchar *from, uchar *to, int w) {
+  int i = 0;
+  for (; w - i >= 16; i += 16) {
+    uint8x16x4_t v = vld4q_u8(from + 4 * i);
+    uint8x16x4_t p;
+    p.val[0] = mul255_neon(v.val[2], v.val[3]);
+    p.val[1] = mul255_neon(v.val[1], v.val[3]);
+    p.val[2] = mul255_neon(v.val[0], v.val[3]);
+    p.val[3] = v.val[3];
+    vst4q_u8(to + 4 * i, p);
+  }
+  return i;
+}
+
+#endif // SIMD_NEON
+
+/**
+ Forces the instruction set used, for tests and benchmarks: 0 for none,
+ then 1 to 4 for SSE2, SSSE3, AVX2 and NEON. A level of another processor
+ architecture selects none, a level above the best one the processor
+ supports is lowered to it, and -1 selects the best one.
+ */
+void Fl_Xlib_Simd::level(int l) {
+  int best = best_level();
+  if (l < 0) level_ = best;
+#if SIMD_X86
+  else if (l >= SSE2 && l <= AVX2) level_ = l > best ? best : l;
+#elif SIMD_NEON
+  else if (l == NEON) level_ = best;
+#endif
+  else level_ = SCALAR;
+}
+
+/** Returns the name of the instruction set in use. */
+const char *Fl_Xlib_Simd::name() {
+  if (level_ < 0) level(-1);
+  return level_names[level_];
+}
+
+/**
+ Reorders bytes of pixels: output byte \p k of each pixel is byte \p pattern[k]
+ of the input pixel, or 0 if \p pattern[k] is ZERO. Input pixels are \p delta
+ bytes apart (1 to 4), output pixels have \p out_bpp bytes (3 or 4).
+ This covers all 24 and 32 bit TrueColor converters, color or mono.
+ \return the number of converted pixels
+ */
+int Fl_Xlib_Simd::shuffle(const uchar *from, uchar *to, int w, int delta,
+                          int out_bpp, const uchar *pattern) {
+  if (level_ < 0) level(-1);
+  if (delta < 1 || delta > 4 || (out_bpp != 3 && out_bpp != 4)) return 0;
+  uchar mask[16];
+  switch (level_) {
+#if SIMD_X86
+    case AVX2:
+      make_mask(mask, delta, out_bpp, pattern);
+      return shuffle_avx2(from, to, w, delta, out_bpp, mask);
+    case SSSE3:
+      make_mask(mask, delta, out_bpp, pattern);
+      return shuffle_ssse3(from, to, w, delta, out_bpp, mask);
+#elif SIMD_NEON
+    case NEON:
+      make_mask(mask, delta, out_bpp, pattern);
+      return shuffle_neon(from, to, w, delta, out_bpp, mask);
+#endif
+    default:
+      return 0;
+  }
+}
+
+/**
+ Converts RGBA pixels (\p delta must be 4) to premultiplied ARGB 32-bit
+ integers in the byte order of the processor.
+ \return the number of converted pixels
+ */
+int Fl_Xlib_Simd::premul(const uchar *from, uchar *to, int w, int delta) {
+  if (level_ < 0) level(-1);
+  if (delta != 4) return 0;
+  switch (level_) {
+#if SIMD_X86
+    case AVX2:
+      return premul_avx2(from, to, w);
+    case SSSE3:
+    case SSE2:
+      return premul_sse2(from, to, w);
+#elif SIMD_NEON
+    case NEON:
+      return premul_neon(from, to, w);
+#endif
+    default:
+      return 0;
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -19,6 +19,7 @@
 //
 //   fl_register_images() - Register the image formats.
 //   fl_check_images()    - Check for a supported image format.
+//   fl_check_sized_images() - Check for a format that can be loaded reduced.
 //
 
 //
@@ -33,6 +34,7 @@
 #include <FL/Fl_PNM_Image.H>
 #include <FL/Fl_SVG_Image.H>
 #include <FL/fl_utf8.h>
+#include "Fl_Screen_Driver.H"
 #include <stdio.h>
 #include <stdlib.h>
 #include "flstring.h"
@@ -46,6 +48,12 @@
 //
 
 static Fl_Image	*fl_check_images(const char *name, uchar *header, int headerlen);
+static Fl_Image	*fl_check_sized_images(const char *name, uchar *header, int headerlen,
+                                       int W, int H);
+
+#if defined(HAVE_LIBPNG) && defined(HAVE_LIBZ)
+extern uchar *fl_png_encode(const uchar *pixels, int w, int h, int ld, int bgr, int *size);
+#endif
 
 
 /**
@@ -53,10 +61,17 @@ static Fl_Image	*fl_check_images(const char *name, uchar *header, int headerlen)
 
  This function is provided in the fltk_images library and 
  registers all of the "extra" image file formats that are not part
- of the core FLTK library.
+ of the core FLTK library. On the X11 platform, it also allows
+ images copied to the clipboard by Fl_Copy_Surface to be offered
+ in PNG format.
 */
 void fl_register_images() {
   Fl_Shared_Image::add_handler(fl_check_images);
+  Fl_Shared_Image::add_handler(fl_check_sized_images);
+#if defined(HAVE_LIBPNG) && defined(HAVE_LIBZ)
+  // allows to copy images to the clipboard in PNG format
+  Fl_Screen_Driver::png_encoder = fl_png_encode;
+#endif
 }
 
 
@@ -113,6 +128,28 @@ fl_check_images(const char *name,		// I - Filename
 }
 
 
+//
+// 'fl_check_sized_images()' - Check for an image format that can be
+//                             loaded at a reduced size.
+//
+
+Fl_Image *					// O - Image, if found
+fl_check_sized_images(const char *name,		// I - Filename
+                      uchar      *header,	// I - Header data from file
+                      int,			// I - Amount of data
+                      int        W,		// I - Smallest width
+                      int        H) {		// I - Smallest height
+#ifdef HAVE_LIBJPEG
+  if (memcmp(header, "\377\330\377", 3) == 0 &&
+					// Start-of-Image
+      header[3] >= 0xc0 && header[3] <= 0xef)
+	   				// APPn for JPEG file
+    return new Fl_JPEG_Image(name, W, H);
+#endif // HAVE_LIBJPEG
+  return 0;
+}
+
+
 //
 // End of "$Id$".
 //
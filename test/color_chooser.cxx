@@ -23,12 +23,13 @@
 #include <FL/fl_show_colormap.H>
 #include <FL/Fl_Color_Chooser.H>
 #include <FL/Fl_Image.H>
+#include <config.h>     // USE_HEADLESS
 #include <FL/platform.H>
 #include <FL/fl_draw.H>
 
 #include <stdlib.h>
 #include <stdio.h>
-#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__) && !defined(USE_HEADLESS)
 #include "list_visuals.cxx"
 #endif
 
@@ -114,7 +115,7 @@ int main(int argc, char ** argv) {
            " - : default visual\n"
            " r : call Fl::visual(FL_RGB)\n"
            " c : call Fl::own_colormap()\n",argv[0]);
-#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__) && !defined(USE_HEADLESS)
     printf(" # : use this visual with an empty colormap:\n");
     list_visuals();
 #endif
@@ -127,7 +128,7 @@ int main(int argc, char ** argv) {
     } else if (argv[i][0] == 'c') {
       Fl::own_colormap();
     } else if (argv[i][0] != '-') {
-#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__) && !defined(USE_HEADLESS)
       int visid = atoi(argv[i]);
       fl_open_display();
       XVisualInfo templt; int num;
@@ -72,8 +72,9 @@ void button_cb(Fl_Widget *,void *) {
   w->redraw();
 }
 
+#include <config.h>     // USE_HEADLESS
 #include <FL/platform.H>
-#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__) && !defined(USE_HEADLESS)
 #include "list_visuals.cxx"
 #endif
 
@@ -89,7 +90,7 @@ int arg(int argc, char **argv, int &i) {
 }
 
 int main(int argc, char **argv) {
-#if defined(USE_X11)
+#if defined(USE_X11) && !defined(USE_HEADLESS)
   int i = 1;
 
   Fl::args(argc,argv,i,arg);
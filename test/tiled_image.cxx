@@ -34,8 +34,9 @@ void button_cb(Fl_Widget *,void *) {
   w->hide();
 }
 
+#include <config.h>     // USE_HEADLESS
 #include <FL/platform.H>
-#if !defined(_WIN32) && !defined(__APPLE__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(USE_HEADLESS)
 #include "list_visuals.cxx"
 #endif
 
@@ -51,7 +52,7 @@ int arg(int argc, char **argv, int &i) {
 }
 
 int main(int argc, char **argv) {
-#if !defined(_WIN32) && !defined(__APPLE__)
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(USE_HEADLESS)
   int i = 1;
 
   Fl::args(argc,argv,i,arg);
@@ -0,0 +1,92 @@
+//
+// "$Id$"
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Widget.H>
+#include <FL/fl_draw.H>
+#include "../src/flstring.h"  // snprintf()
+
+//
+// --- Fl::set_font() on a font that is in use -------------------------------
+//
+// Renaming a font deletes the cached sizes of its old face. The font is used
+// at many sizes first, more than the fonts the X11 driver keeps open, so
+// that selecting it again after renaming also walks the font cache.
+//
+class FontRenameTest : public Fl_Widget
+{
+  enum { FONT = FL_FREE_FONT, SIZES = 80 };
+  int tested, renamed_ok, restored_ok;
+  char result[2][100];
+
+  // Selects the test font at all sizes, returns its width for "iiii" and "MMMM".
+  static void use_font(int &wi, int &wm) {
+    for (int s = 8; s < 8 + SIZES; s++) {
+      fl_font(FONT, s);
+      wi = (int)fl_width("iiii");
+    }
+    fl_font(FONT, 20);
+    wi = (int)fl_width("iiii");
+    wm = (int)fl_width("MMMM");
+  }
+  void run_test() {
+    int wi1, wm1, wi2, wm2, wi3, wm3;
+    Fl::set_font(FONT, FL_HELVETICA);
+    use_font(wi1, wm1);
+    Fl::set_font(FONT, FL_COURIER);     // deletes the Helvetica sizes
+    use_font(wi2, wm2);
+    Fl::set_font(FONT, FL_HELVETICA);   // deletes the Courier sizes, in use
+    use_font(wi3, wm3);
+    renamed_ok = (wi2 == wm2 && wi1 != wm1);
+    restored_ok = (wi3 == wi1 && wm3 == wm1);
+    snprintf(result[0], sizeof(result[0]), "Helvetica -> Courier: %s (iiii %d, MMMM %d)",
+             renamed_ok ? "OK" : "FAILED", wi2, wm2);
+    snprintf(result[1], sizeof(result[1]), "Courier -> Helvetica: %s (iiii %d, MMMM %d)",
+             restored_ok ? "OK" : "FAILED", wi3, wm3);
+    tested = 1;
+  }
+public:
+  static Fl_Widget *create() {
+    return new FontRenameTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H);
+  }
+  FontRenameTest(int x, int y, int w, int h) : Fl_Widget(x, y, w, h), tested(0) {}
+  void draw(void) {
+    if (!tested) run_test();
+    fl_push_clip(x(), y(), w(), h());
+    fl_color(FL_BACKGROUND_COLOR);
+    fl_rectf(x(), y(), w(), h());
+    fl_font(FONT, 20);
+    fl_color(FL_BLACK);
+    fl_draw("Fl::set_font() of a font in use, then fl_font() again:", x() + 10, y() + 30);
+    fl_font(FL_HELVETICA, 14);
+    fl_color(renamed_ok ? FL_DARK_GREEN : FL_RED);
+    fl_draw(result[0], x() + 10, y() + 60);
+    fl_color(restored_ok ? FL_DARK_GREEN : FL_RED);
+    fl_draw(result[1], x() + 10, y() + 85);
+    fl_color(FL_BLACK);
+    fl_draw("Courier has the same width for 'iiii' and 'MMMM', Helvetica does not.",
+            x() + 10, y() + 120);
+    fl_pop_clip();
+  }
+};
+
+UnitTest fontRename("renaming fonts", FontRenameTest::create);
+
+//
+// End of "$Id$"
+//
@@ -0,0 +1,182 @@
+//
+// "$Id$"
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <config.h>
+
+#if defined(USE_X11) || defined(USE_HEADLESS)
+
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Pixmap.H>
+#include <FL/fl_draw.H>
+#include <stdio.h>
+#include <string.h>
+#include "../src/flstring.h"  // snprintf()
+#include "../src/drivers/PicoHeadless/Fl_PicoHeadless_Graphics_Driver.H"
+#include "pixmaps/pico_polygons.xpm"
+#include "pixmaps/pico_ellipses.xpm"
+#include "pixmaps/pico_arcs.xpm"
+
+//
+//------- test the rasterizer of the Pico software graphics driver ----------
+//
+// The shapes are drawn in black on white, without antialiasing, by the
+// driver of the headless platform, which X11 also uses for the tiled mode of
+// Fl_Image_Surface. Each pixel is compared with a reference image in
+// test/pixmaps, so that changes of the rasterizer that move pixels show up;
+// pixels that differ are shown in red.
+//
+class PicoRasterTest : public Fl_Box {
+  enum { W = 160, H = 40, ZOOM = 3 };
+  typedef void (*Scene)(Fl_Graphics_Driver *d);
+  Fl_RGB_Image *drawn;
+  Fl_Image *reference;
+  int errors;
+  char result[100];
+
+  // Returns the reference pixels, 1 for black, or 0 if the image is not W x H.
+  static uchar *read_reference(const char * const *xpm) {
+    int w, h, ncolors, cpp;
+    if (sscanf(xpm[0], "%d %d %d %d", &w, &h, &ncolors, &cpp) != 4 ||
+        w != W || h != H || cpp != 1) return 0;
+    char black[256];
+    memset(black, 0, sizeof(black));
+    for (int i = 1; i <= ncolors; i++)
+      if (strstr(xpm[i], "#000000")) black[(uchar)xpm[i][0]] = 1;
+    uchar *pixels = new uchar[W * H];
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+        pixels[y * W + x] = black[(uchar)xpm[1 + ncolors + y][x]];
+    return pixels;
+  }
+
+  void run_test(Scene scene, const char * const *xpm) {
+    Fl_PicoHeadless_Buffer buffer(W, H);
+    Fl_PicoHeadless_Graphics_Driver d;
+    d.antialias(0);
+    d.buffer(&buffer);
+    d.color(FL_WHITE);
+    d.rectf(0, 0, W, H);
+    d.color(FL_BLACK);
+    scene(&d);
+    uchar *ref = read_reference(xpm);
+    uchar *rgb = new uchar[W * H * 3];
+    errors = 0;
+    for (int i = 0; i < W * H; i++) {
+      const uchar *p = buffer.pixels + 4 * i;
+      int is_black = (p[0] == 0 && p[1] == 0 && p[2] == 0);
+      int ok = ref && ref[i] == is_black;
+      if (!ok) errors++;
+      rgb[3 * i] = ok ? p[0] : 255;
+      rgb[3 * i + 1] = ok ? p[1] : 0;
+      rgb[3 * i + 2] = ok ? p[2] : 0;
+    }
+    delete[] ref;
+    Fl_RGB_Image *img = new Fl_RGB_Image(rgb, W, H, 3);
+    img->alloc_array = 1;
+    drawn = (Fl_RGB_Image*)img->copy(W * ZOOM, H * ZOOM);
+    delete img;
+    Fl_Pixmap pixmap(xpm);
+    reference = pixmap.copy(W * ZOOM, H * ZOOM);
+    if (errors)
+      snprintf(result, sizeof(result), "FAILED: %d pixels differ from the reference", errors);
+    else
+      snprintf(result, sizeof(result), "OK: all pixels are those of the reference");
+  }
+
+  // filled polygons: triangle, quadrilateral, concave polygon, and a
+  // self-intersecting star with a hole, as a complex polygon
+  static void polygons(Fl_Graphics_Driver *d) {
+    d->polygon(4, 35, 20, 4, 36, 30);
+    d->polygon(44, 10, 70, 4, 76, 36, 50, 28);
+    d->begin_polygon();
+    d->vertex(84, 20); d->vertex(100, 4); d->vertex(100, 13); d->vertex(116, 13);
+    d->vertex(116, 27); d->vertex(100, 27); d->vertex(100, 36);
+    d->end_polygon();
+    d->begin_complex_polygon();
+    d->vertex(140, 2); d->vertex(151, 36); d->vertex(122, 15); d->vertex(158, 15);
+    d->vertex(129, 36);
+    d->gap();
+    d->vertex(137, 24); d->vertex(143, 24); d->vertex(143, 30); d->vertex(137, 30);
+    d->end_complex_polygon();
+  }
+
+  // filled ellipses: circle, wide and tall ovals, and fl_circle() in a polygon
+  static void ellipses(Fl_Graphics_Driver *d) {
+    d->pie(4, 4, 31, 31, 0, 360);
+    d->pie(41, 10, 37, 21, 0, 360);
+    d->pie(92, 3, 15, 33, 0, 360);
+    d->begin_polygon();
+    d->circle(140, 20, 14.5);
+    d->end_polygon();
+  }
+
+  // outlines and sectors: circle, arc, pie, and an arc of an oval
+  static void arcs(Fl_Graphics_Driver *d) {
+    d->arc(4, 4, 31, 31, 0, 360);
+    d->arc(45, 5, 31, 31, -35, 125);
+    d->pie(85, 5, 31, 31, -30, 120);
+    d->arc(121, 8, 37, 25, 45, 315);
+  }
+
+public:
+  static Fl_Widget *create_polygons() {
+    return new PicoRasterTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H,
+                              polygons, pico_polygons_xpm);
+  }
+  static Fl_Widget *create_ellipses() {
+    return new PicoRasterTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H,
+                              ellipses, pico_ellipses_xpm);
+  }
+  static Fl_Widget *create_arcs() {
+    return new PicoRasterTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H,
+                              arcs, pico_arcs_xpm);
+  }
+  PicoRasterTest(int x, int y, int w, int h, Scene scene, const char * const *xpm)
+  : Fl_Box(x, y, w, h) {
+    label("testing the Pico software driver against reference images\n"
+          "The top image is drawn by the driver, the bottom one is the reference. "
+          "Red pixels differ from the reference.");
+    align(FL_ALIGN_INSIDE|FL_ALIGN_BOTTOM|FL_ALIGN_LEFT|FL_ALIGN_WRAP);
+    box(FL_BORDER_BOX);
+    run_test(scene, xpm);
+  }
+  ~PicoRasterTest() {
+    delete drawn;
+    delete reference;
+  }
+  void draw() {
+    Fl_Box::draw();
+    int a = x() + 10, b = y() + 10;
+    drawn->draw(a, b);
+    reference->draw(a, b + H * ZOOM + 10);
+    fl_font(FL_HELVETICA, 14);
+    fl_color(errors ? FL_RED : FL_DARK_GREEN);
+    fl_draw(result, a, b + 2 * (H * ZOOM + 10) + 14);
+  }
+};
+
+UnitTest picoPolygons("Pico polygons", PicoRasterTest::create_polygons);
+UnitTest picoEllipses("Pico ellipses", PicoRasterTest::create_ellipses);
+UnitTest picoArcs("Pico arcs", PicoRasterTest::create_arcs);
+
+#endif // USE_X11 || USE_HEADLESS
+
+//
+// End of "$Id$"
+//
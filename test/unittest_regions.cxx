@@ -0,0 +1,255 @@
+//
+// "$Id$"
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/flstring.h"  // snprintf()
+#include "../src/Fl_Banded_Region.H"
+
+//
+//------- test the regions of the software drivers ----------
+//
+// Random regions are built from rectangles, combined, and compared pixel by
+// pixel with bitmaps that receive the same rectangles. Each result is also
+// checked for the unique form of banded regions, walked with an Iterator,
+// and asked rect_in() for random rectangles. Coordinates go below 0.
+//
+class RegionTest : public Fl_Group {
+  Fl_Simple_Terminal *tty;
+  enum { X0 = -16, Y0 = -12, BW = 72, BH = 56, ROUNDS = 400 };
+  enum { UNITE, INTERSECT, SUBTRACT, OPS };
+  typedef uchar Bitmap[BH][BW];
+  int errors;
+
+  // A random rectangle in the bitmap or partly out of it, maybe empty.
+  static void random_rect(int &x, int &y, int &w, int &h) {
+    x = X0 - 4 + rand() % (BW + 4);
+    y = Y0 - 4 + rand() % (BH + 4);
+    w = rand() % 24;
+    h = rand() % 24;
+  }
+  static void fill(Bitmap b, int x, int y, int w, int h, uchar v) {
+    for (int j = y; j < y + h; j++)
+      for (int i = x; i < x + w; i++)
+        if (i >= X0 && i < X0 + BW && j >= Y0 && j < Y0 + BH) b[j - Y0][i - X0] = v;
+  }
+  // Fills a region and its bitmap with random rectangles, some subtracted.
+  static void random_region(Fl_Banded_Region &r, Bitmap b) {
+    r.set_empty();
+    memset(b, 0, sizeof(Bitmap));
+    int n = rand() % 8, x, y, w, h;
+    for (int k = 0; k < n; k++) {
+      random_rect(x, y, w, h);
+      // keep the region inside the bitmap, so that all of it is compared
+      if (x < X0) { w += x - X0; x = X0; }
+      if (y < Y0) { h += y - Y0; y = Y0; }
+      if (x + w > X0 + BW) w = X0 + BW - x;
+      if (y + h > Y0 + BH) h = Y0 + BH - y;
+      if (w < 0 || h < 0) continue;
+      int sub = (k > 0 && rand() % 4 == 0);
+      if (sub) r.subtract(x, y, w, h);
+      else r.unite(x, y, w, h);
+      fill(b, x, y, w, h, !sub);
+    }
+  }
+
+  void error(const char *what, int round) {
+    if (errors < 10) tty->printf("\033[31mround %d: %s\033[0m\n", round, what);
+    errors++;
+  }
+
+  // Checks that the bands are sorted and never empty, that the rectangles
+  // of a band are sorted and don't touch, and that touching bands differ.
+  static int check_form(const Fl_Banded_Region &r) {
+    int rects = 0;
+    for (int i = 0; i < r.bands(); i++) {
+      int n = r.band_size(i);
+      const int *e = r.band_edges(i);
+      if (n <= 0 || r.band_top(i) >= r.band_bottom(i)) return 0;
+      if (i > 0 && r.band_top(i) < r.band_bottom(i - 1)) return 0;
+      for (int k = 0; k < 2 * n; k++)
+        if (k > 0 && e[k] <= e[k - 1]) return 0;
+      if (i > 0 && r.band_top(i) == r.band_bottom(i - 1) && n == r.band_size(i - 1) &&
+          !memcmp(e, r.band_edges(i - 1), 2 * n * sizeof(int))) return 0;
+      rects += n;
+    }
+    return rects == r.rectangles();
+  }
+
+  // Compares the region with the bitmap in all the ways it can be read.
+  void check(const Fl_Banded_Region &r, Bitmap b, const char *op, int round) {
+    char what[80];
+    if (!check_form(r)) {
+      snprintf(what, sizeof(what), "%s: bands not in their unique form", op);
+      error(what, round);
+    }
+    int i, j, left = X0 + BW, top = Y0 + BH, right = X0, bottom = Y0, count = 0;
+    for (j = 0; j < BH; j++)
+      for (i = 0; i < BW; i++) {
+        if (b[j][i]) {
+          count++;
+          if (i + X0 < left) left = i + X0;
+          if (i + X0 >= right) right = i + X0 + 1;
+          if (j + Y0 < top) top = j + Y0;
+          if (j + Y0 >= bottom) bottom = j + Y0 + 1;
+        }
+        if ((r.contains(i + X0, j + Y0) != 0) != b[j][i]) {
+          snprintf(what, sizeof(what), "%s: contains(%d, %d) is wrong", op, i + X0, j + Y0);
+          error(what, round);
+          return;
+        }
+      }
+    if ((count == 0) != (r.is_empty() != 0)) {
+      snprintf(what, sizeof(what), "%s: is_empty() is wrong", op);
+      error(what, round);
+    }
+    if (count) {
+      int x, y, w, h;
+      r.extents(x, y, w, h);
+      if (x != left || y != top || x + w != right || y + h != bottom) {
+        snprintf(what, sizeof(what), "%s: extents() is wrong", op);
+        error(what, round);
+      }
+    }
+    // the rectangles the iterator gives in a box must cover its pixels once
+    int bx, by, bw, bh;
+    random_rect(bx, by, bw, bh);
+    Bitmap seen;
+    memset(seen, 0, sizeof(Bitmap));
+    Fl_Banded_Region::Iterator it(r, bx, by, bw, bh);
+    int X, Y, W, H, last_y = Y0 - 100, last_r = X0 - 100;
+    while (it.next(X, Y, W, H)) {
+      if (W <= 0 || H <= 0 || X < bx || Y < by || X + W > bx + bw || Y + H > by + bh ||
+          Y < last_y || (Y == last_y && X < last_r)) {
+        snprintf(what, sizeof(what), "%s: Iterator gives %d,%d %dx%d", op, X, Y, W, H);
+        error(what, round);
+        return;
+      }
+      last_y = Y;
+      last_r = X + W;
+      for (j = Y; j < Y + H; j++)
+        for (i = X; i < X + W; i++)
+          if (i >= X0 && i < X0 + BW && j >= Y0 && j < Y0 + BH) seen[j - Y0][i - X0]++;
+    }
+    for (j = 0; j < BH; j++)
+      for (i = 0; i < BW; i++) {
+        int in_box = i + X0 >= bx && i + X0 < bx + bw && j + Y0 >= by && j + Y0 < by + bh;
+        if (seen[j][i] != (in_box && b[j][i])) {
+          snprintf(what, sizeof(what), "%s: Iterator misses or repeats %d, %d", op, i + X0, j + Y0);
+          error(what, round);
+          return;
+        }
+      }
+    // rect_in() of random rectangles
+    for (int k = 0; k < 20; k++) {
+      random_rect(bx, by, bw, bh);
+      int in = 0, out = 0;
+      for (j = by; j < by + bh; j++)
+        for (i = bx; i < bx + bw; i++) {
+          if (i >= X0 && i < X0 + BW && j >= Y0 && j < Y0 + BH && b[j - Y0][i - X0]) in++;
+          else out++;
+        }
+      int expected = in == 0 ? 0 : (out == 0 ? 1 : 2);
+      if (r.rect_in(bx, by, bw, bh) != expected) {
+        snprintf(what, sizeof(what), "%s: rect_in(%d, %d, %d, %d) is %d, not %d", op,
+                 bx, by, bw, bh, r.rect_in(bx, by, bw, bh), expected);
+        error(what, round);
+        return;
+      }
+    }
+  }
+
+  void run_tests() {
+    static const char *names[OPS] = { "unite", "intersect", "subtract" };
+    Bitmap a, b, c;
+    Fl_Banded_Region ra, rb;
+    tty->clear();
+    errors = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+      random_region(ra, a);
+      random_region(rb, b);
+      check(ra, a, "building", round);
+      for (int op = 0; op < OPS; op++) {
+        // with a region, then with a rectangle
+        for (int with_rect = 0; with_rect < 2; with_rect++) {
+          Fl_Banded_Region r(ra);
+          Bitmap &other = with_rect ? c : b;
+          int x, y, w, h;
+          if (with_rect) {
+            random_rect(x, y, w, h);
+            memset(c, 0, sizeof(Bitmap));
+            fill(c, x, y, w, h, 1);
+          }
+          switch (op) {
+            case UNITE:
+              if (with_rect) r.unite(x, y, w, h); else r.unite(rb);
+              break;
+            case INTERSECT:
+              if (with_rect) r.intersect(x, y, w, h); else r.intersect(rb);
+              break;
+            case SUBTRACT:
+              if (with_rect) r.subtract(x, y, w, h); else r.subtract(rb);
+              break;
+          }
+          Bitmap expected;
+          for (int j = 0; j < BH; j++)
+            for (int i = 0; i < BW; i++) {
+              uchar p = a[j][i], q = other[j][i];
+              expected[j][i] = op == UNITE ? (p || q) : op == INTERSECT ? (p && q) : (p && !q);
+            }
+          // unite() with a rectangle may go out of the bitmap
+          if (op == UNITE && with_rect) r.intersect(X0, Y0, BW, BH);
+          check(r, expected, names[op], round);
+        }
+      }
+      // translate() and back, and assignment
+      Fl_Banded_Region r;
+      r = ra;
+      r.translate(5, -3);
+      r.translate(-5, 3);
+      check(r, a, "translate", round);
+    }
+    tty->printf("%d random regions, %d operations: %s\n", ROUNDS, ROUNDS * 2 * OPS,
+                errors ? "\033[31mFAILED\033[0m" : "\033[32mall match their bitmaps\033[0m");
+  }
+  static void test_cb(Fl_Widget*, void *d) { ((RegionTest*)d)->run_tests(); }
+
+public:
+  static Fl_Widget *create() {
+    return new RegionTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H);
+  }
+  RegionTest(int x, int y, int w, int h) : Fl_Group(x, y, w, h) {
+    tty = new Fl_Simple_Terminal(x, y, w, h - 35);
+    tty->ansi(true);
+    tty->textsize(12);
+    Fl_Button *b = new Fl_Button(x, y + h - 25, 120, 25, "Test again");
+    b->callback(test_cb, this);
+    end();
+    resizable(tty);
+    run_tests();
+  }
+};
+
+UnitTest regions("banded regions", RegionTest::create);
+
+//
+// End of "$Id$"
+//
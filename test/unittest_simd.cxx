@@ -0,0 +1,226 @@
+//
+// "$Id$"
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2018 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <config.h>
+
+#if defined(USE_X11)
+
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_Stats.H>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/drivers/Xlib/Fl_Xlib_Simd.H"
+
+//
+//------- test the SIMD pixel converters of the X11 graphics driver ----------
+//
+// Each instruction set is compared, byte for byte, with scalar reference
+// converters that compute the same values as those of
+// Fl_Xlib_Graphics_Driver_image.cxx, for all widths from 0 to 300 pixels.
+// Buffers have the exact size of the pixels, so that running the test with
+// a memory checker also finds reads and writes out of the lines.
+//
+class SimdTest : public Fl_Group {
+  Fl_Simple_Terminal *tty;
+  enum { MAX_W = 300, LEVELS = 5, GUARD = 16, SHUFFLES = 9 };
+  struct Shuffle {
+    const char *name;
+    int out_bpp;
+    uchar pattern[4];
+  };
+  static const Shuffle shuffles[SHUFFLES];
+
+  static void ref_shuffle(const uchar *from, uchar *to, int w, int delta,
+                          int out_bpp, const uchar *pattern) {
+    for (int i = 0; i < w; i++, from += delta, to += out_bpp)
+      for (int k = 0; k < out_bpp; k++)
+        to[k] = pattern[k] == Fl_Xlib_Simd::ZERO ? 0 : from[pattern[k]];
+  }
+  static void ref_premul(const uchar *from, uchar *to, int w) {
+    for (int i = 0; i < w; i++, from += 4, to += 4) {
+      unsigned a = from[3];
+      unsigned v = (a << 24) + (((from[0] * a) / 255) << 16) +
+                   (((from[1] * a) / 255) << 8) + ((from[2] * a) / 255);
+      memcpy(to, &v, 4);
+    }
+  }
+  static void fill_random(uchar *p, int n) {
+    for (int i = 0; i < n; i++) p[i] = uchar(rand() >> 4);
+  }
+
+  // Converts a line as the driver does, with SIMD then scalar code, and
+  // compares it with the reference. Returns 1 if they are identical.
+  static int check(int shuffle, int w, int delta) {
+    int out_bpp = shuffle < 0 ? 4 : shuffles[shuffle].out_bpp;
+    uchar *from = (uchar*)malloc(w * delta + 1);
+    uchar *to = (uchar*)malloc(w * out_bpp + GUARD);
+    uchar *ref = (uchar*)malloc(w * out_bpp + GUARD);
+    fill_random(from, w * delta);
+    if (shuffle < 0) {
+      // also check the extreme values of alpha
+      for (int i = 0; i < w && i < 8; i++) from[4 * i + 3] = (i & 1) ? 255 : 0;
+    }
+    memset(to, 0xcd, w * out_bpp + GUARD);
+    memset(ref, 0xcd, w * out_bpp + GUARD);
+    int n;
+    if (shuffle < 0) {
+      n = Fl_Xlib_Simd::premul(from, to, w, delta);
+      if (n >= 0 && n <= w) ref_premul(from + n * delta, to + n * out_bpp, w - n);
+      ref_premul(from, ref, w);
+    } else {
+      const uchar *pattern = shuffles[shuffle].pattern;
+      n = Fl_Xlib_Simd::shuffle(from, to, w, delta, out_bpp, pattern);
+      if (n >= 0 && n <= w)
+        ref_shuffle(from + n * delta, to + n * out_bpp, w - n, delta, out_bpp, pattern);
+      ref_shuffle(from, ref, w, delta, out_bpp, pattern);
+    }
+    int ok = n >= 0 && n <= w && memcmp(to, ref, w * out_bpp + GUARD) == 0;
+    free(from);
+    free(to);
+    free(ref);
+    return ok;
+  }
+
+  // Runs the bit-exact test for each instruction set the processor has.
+  void run_tests() {
+    tty->clear();
+    const char *done[LEVELS];
+    int ndone = 0, failures = 0;
+    for (int l = 0; l < LEVELS; l++) {
+      Fl_Xlib_Simd::level(l);
+      const char *name = Fl_Xlib_Simd::name();
+      int i, seen = 0;
+      for (i = 0; i < ndone; i++) if (done[i] == name) seen = 1;
+      if (seen) continue; // not supported, lowered to a tested level
+      done[ndone++] = name;
+      int errors = 0, cases = 0;
+      for (int s = -1; s < SHUFFLES; s++) {
+        for (int delta = 1; delta <= 4; delta++) {
+          if (s < 0 && delta != 4) continue;
+          if (s >= 0) { // the pattern must stay inside the input pixel
+            int max = 0;
+            for (int k = 0; k < 4; k++)
+              if (shuffles[s].pattern[k] != Fl_Xlib_Simd::ZERO && shuffles[s].pattern[k] > max)
+                max = shuffles[s].pattern[k];
+            if (max >= delta) continue;
+          }
+          for (int w = 0; w <= MAX_W; w++) {
+            cases++;
+            if (!check(s, w, delta)) {
+              if (errors < 5)
+                tty->printf("\033[31m%s: %s, delta %d, width %d differs\033[0m\n",
+                            name, s < 0 ? "premul" : shuffles[s].name, delta, w);
+              errors++;
+            }
+          }
+        }
+      }
+      tty->printf("%-6s %5d lines, %s\n", name, cases,
+                  errors ? "\033[31mFAILED\033[0m" : "\033[32mbit-exact\033[0m");
+      failures += errors;
+    }
+    Fl_Xlib_Simd::level(-1);
+    tty->printf("%s, %s selected\n", failures ? "Errors found" : "All converters match",
+                Fl_Xlib_Simd::name());
+  }
+
+  // Measures the converted pixels per second of each instruction set.
+  void run_benchmark() {
+    const int W = 1920, LINES = 2000;
+    uchar *from = (uchar*)malloc(W * 4), *to = (uchar*)malloc(W * 4);
+    fill_random(from, W * 4);
+    tty->printf("\n%-6s %14s %14s %14s  (Mpixel/s, %d pixel lines)\n",
+                "", "RGB->XRGB", "RGBA->premul", "gray->XRRR", W);
+    const char *done[LEVELS];
+    int ndone = 0;
+    for (int l = 0; l < LEVELS; l++) {
+      Fl_Xlib_Simd::level(l);
+      const char *name = Fl_Xlib_Simd::name();
+      int i, seen = 0;
+      for (i = 0; i < ndone; i++) if (done[i] == name) seen = 1;
+      if (seen) continue;
+      done[ndone++] = name;
+      double rate[3];
+      for (int b = 0; b < 3; b++) {
+        double t = Fl_Stats::now();
+        for (int y = 0; y < LINES; y++) {
+          int n;
+          if (b == 1) {
+            n = Fl_Xlib_Simd::premul(from, to, W, 4);
+            ref_premul(from + 4 * n, to + 4 * n, W - n);
+          } else {
+            const Shuffle &s = shuffles[b == 0 ? 5 : 8]; // xrgb, xrrr
+            int delta = b == 0 ? 3 : 1;
+            n = Fl_Xlib_Simd::shuffle(from, to, W, delta, 4, s.pattern);
+            ref_shuffle(from + n * delta, to + 4 * n, W - n, delta, 4, s.pattern);
+          }
+        }
+        t = Fl_Stats::now() - t;
+        rate[b] = t > 0 ? W * (double)LINES / t / 1e6 : 0;
+      }
+      tty->printf("%-6s %14.0f %14.0f %14.0f\n", name, rate[0], rate[1], rate[2]);
+    }
+    Fl_Xlib_Simd::level(-1);
+    free(from);
+    free(to);
+  }
+  static void test_cb(Fl_Widget*, void *d) { ((SimdTest*)d)->run_tests(); }
+  static void benchmark_cb(Fl_Widget*, void *d) { ((SimdTest*)d)->run_benchmark(); }
+
+public:
+  static Fl_Widget *create() {
+    return new SimdTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H);
+  }
+  SimdTest(int x, int y, int w, int h) : Fl_Group(x, y, w, h) {
+    tty = new Fl_Simple_Terminal(x, y, w, h - 35);
+    tty->ansi(true);
+    tty->textsize(12);
+    Fl_Button *b = new Fl_Button(x, y + h - 25, 120, 25, "Test again");
+    b->callback(test_cb, this);
+    b = new Fl_Button(x + 130, y + h - 25, 120, 25, "Benchmark");
+    b->callback(benchmark_cb, this);
+    end();
+    resizable(tty);
+    run_tests();
+  }
+};
+
+// the converters of the X11 graphics driver
+const SimdTest::Shuffle SimdTest::shuffles[SimdTest::SHUFFLES] = {
+#define Z Fl_Xlib_Simd::ZERO
+  { "rgb",  3, { 0, 1, 2, Z } },
+  { "bgr",  3, { 2, 1, 0, Z } },
+  { "rrr",  3, { 0, 0, 0, Z } },
+  { "rgbx", 4, { Z, 2, 1, 0 } },
+  { "xbgr", 4, { 0, 1, 2, Z } },
+  { "xrgb", 4, { 2, 1, 0, Z } },
+  { "bgrx", 4, { Z, 0, 1, 2 } },
+  { "rrrx", 4, { Z, 0, 0, 0 } },
+  { "xrrr", 4, { 0, 0, 0, Z } }
+#undef Z
+};
+
+UnitTest simd("SIMD converters", SimdTest::create);
+
+#endif // USE_X11
+
+//
+// End of "$Id$"
+//
@@ -147,13 +147,17 @@ public:
 #include "unittest_lines.cxx"
 #include "unittest_rects.cxx"
 #include "unittest_circles.cxx"
+#include "unittest_pico.cxx"
 #include "unittest_text.cxx"
+#include "unittest_fonts.cxx"
 #include "unittest_symbol.cxx"
 #include "unittest_images.cxx"
 #include "unittest_viewport.cxx"
 #include "unittest_scrollbarsize.cxx"
 #include "unittest_schemes.cxx"
 #include "unittest_simple_terminal.cxx"
+#include "unittest_simd.cxx"
+#include "unittest_regions.cxx"
 
 // callback whenever the browser value changes
 void Browser_CB(Fl_Widget*, void*) {